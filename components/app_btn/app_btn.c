@@ -9,7 +9,7 @@
 
 static const char *TAG = "app_button";
 
-static void timed_events_cb(TimerHandle_t xTimer);
+static void timed_events_cb(void *arg, uint32_t gen);
 
 //------------------------------------------------------//
 //  FSM declarations                                    //
@@ -23,6 +23,7 @@ static void enter_press     (fsm_t *self, void* data);
 static void enter_unpress   (fsm_t *self, void* data);
 static void enter_long_press(fsm_t *self, void* data);
 static void exit_press      (fsm_t *self, void* data);
+static void exit_timed      (fsm_t *self, void* data);
 
 // Define FSM states
 FSM_STATES_INIT(btn_fsm)
@@ -31,8 +32,8 @@ FSM_CREATE_STATE(btn_fsm, ROOT_ST,          FSM_ST_NONE,   INIT_ST,      NULL,
 FSM_CREATE_STATE(btn_fsm, INIT_ST,          ROOT_ST,       FSM_ST_NONE,  enter_init,       NULL,   NULL)
 FSM_CREATE_STATE(btn_fsm, IDLE_ST,          ROOT_ST,       FSM_ST_NONE,  enter_idle,       NULL,   NULL)
 FSM_CREATE_STATE(btn_fsm, PRESS_ST,         ROOT_ST,       WAIT_ST,      NULL,             NULL,   exit_press)
-FSM_CREATE_STATE(btn_fsm, WAIT_ST,          PRESS_ST,      FSM_ST_NONE,  enter_wait,       NULL,   NULL)
-FSM_CREATE_STATE(btn_fsm, S_PRESS_ST,       ROOT_ST,       FSM_ST_NONE,  enter_press,      NULL,   NULL)
+FSM_CREATE_STATE(btn_fsm, WAIT_ST,          PRESS_ST,      FSM_ST_NONE,  enter_wait,       NULL,   exit_timed)
+FSM_CREATE_STATE(btn_fsm, S_PRESS_ST,       ROOT_ST,       FSM_ST_NONE,  enter_press,      NULL,   exit_timed)
 FSM_CREATE_STATE(btn_fsm, S_UNPRESS_ST,     ROOT_ST,       FSM_ST_NONE,  enter_unpress,    NULL,   exit_press)
 FSM_CREATE_STATE(btn_fsm, L_PRESS_ST,       PRESS_ST,      FSM_ST_NONE,  enter_long_press, NULL,   NULL)
 FSM_STATES_END()
@@ -64,8 +65,13 @@ FSM_TRANSITIONS_END()
 static void gpio_isr_handler(void* arg)
 {
     btn_ins_t * btn = (btn_ins_t *) arg;
+    BaseType_t task_woken = pdFALSE;
 
     fsm_dispatch(&btn->fsm, (gpio_get_level(btn->gpio) == 0) ? PRESS_EV : UNPRESS_EV, btn);
+
+    // The task may not be created yet, it runs the fsm once it is anyway
+    if(btn->task != NULL) vTaskNotifyGiveFromISR(btn->task, &task_woken);
+    if(task_woken) portYIELD_FROM_ISR();
 }
 
 static void enter_idle(fsm_t *self, void* data)
@@ -77,7 +83,7 @@ static void enter_idle(fsm_t *self, void* data)
 }
 
 /**
- * @brief Internal task for running fsm every 10ms
+ * @brief Internal task running the fsm when an edge or a timeout wakes it up
  * 
  * @param arg 
  */
@@ -92,27 +98,31 @@ static void internal_task(void* arg)
 
     for(;;)
     {
-        vTaskDelay(BTN_TASK_PERIOD_MS / portTICK_PERIOD_MS);
-
         btn_run(btn);
+
+        // One run per wakeup, the notification counts them
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
     }
 }
 
 /**
  * @brief Internal timer callback
  * 
- * @param xTimer 
+ * @param arg 
  */
-static void timed_events_cb(TimerHandle_t xTimer)
+static void timed_events_cb(void *arg, uint32_t gen)
 {
-    fsm_t *fsm =  (fsm_t*)pvTimerGetTimerID(xTimer);
+    btn_ins_t *btn = (btn_ins_t*)arg;
 
-    if (fsm == NULL) {
-        ESP_LOGE(TAG, "FSM instance is NULL in timer callback");
+    if (btn == NULL) {
+        ESP_LOGE(TAG, "Button instance is NULL in timer callback");
         return;
     }
 
-    fsm_ticks_hook(fsm);
+    // A press edge may leave or re-arm the timed state before the fsm runs, btn_run checks the generation then
+    atomic_store(&btn->timeout_gen, gen);
+
+    if(btn->task != NULL) xTaskNotifyGive(btn->task);
 }
 
 //------------------------------------------------------//
@@ -166,30 +176,8 @@ static void enter_init(fsm_t *self, void* data)
     
     ESP_LOGI(TAG, "Button queue init %d", (int)btn->evt_q);
     
-    // Timer for timed events
-    btn->timer = xTimerCreate(
-        "Timer_btn",                                    // Timer name
-        BTN_TIMER_PERIOD_MS / portTICK_PERIOD_MS,       // Period in ticks
-        pdTRUE,                                         // Auto-reload (periodic)
-        (void*)self,                                    // Timer ID (not used here)
-        timed_events_cb                                   // Callback function
-    );
-
-    ESP_LOGI(TAG, "Timer init %d %d %d %d", (int)data, (int)self->current_data, (int)self->current_state, (int)self->transitions);
-    
-    if (!btn->timer)
-    {
-        ESP_LOGE(TAG, "Failed to create timer");
-        return;
-    } 
-
-    if (xTimerStart(btn->timer, 0) != pdPASS) {
-        ESP_LOGE(TAG, "Failed to start timer");
-        return;
-    }
-
     // Task init
-    result = xTaskCreate(internal_task, "btn_task", 2048*6, (void*const)btn, tskIDLE_PRIORITY+5, NULL);
+    result = xTaskCreate(internal_task, "btn_task", 2048*6, (void*const)btn, tskIDLE_PRIORITY+5, &btn->task);
     if(result != pdPASS) {
         ESP_LOGE(TAG, "Failed to create task: %d", result);
         return;
@@ -215,6 +203,7 @@ static void enter_wait(fsm_t *self, void* data)
     btn->evt = BOUNCE_EV;
     // Sets timer target to antibounce time
     btn->max_count = BTN_ANTIBOUNCE_T;
+    app_timer_arm(&btn->timer, BTN_ANTI_BOUNCE_MS);
 }
 
 /**
@@ -234,6 +223,7 @@ static void enter_press(fsm_t *self, void* data)
 
     // Sets timer target to long press time
     btn->max_count = BTN_LONG_PRESS_T;
+    app_timer_arm(&btn->timer, BTN_LONG_PRESS_MS);
 }
 
 /**
@@ -244,7 +234,12 @@ static void enter_press(fsm_t *self, void* data)
  */
 static void enter_unpress(fsm_t *self, void* data)
 {
+    btn_ins_t * btn = (btn_ins_t *) data;
+
     fsm_dispatch(self, READY_EV, data);
+
+    // The task runs the fsm again for it, nothing else would wake it up
+    xTaskNotifyGive(btn->task);
 }
 
 /**
@@ -283,6 +278,21 @@ static void exit_press(fsm_t *self, void* data)
     if(btn->evt != LONG_PRESS_EV) xQueueSend(btn->evt_q, &btn->evt, 0);
 }
 
+/**
+ * @brief Stops the timer, the state may be left before it expires
+ * 
+ * A timeout already fired is dropped by btn_run, the cancel makes its generation stale.
+ * 
+ * @param self 
+ * @param data 
+ */
+static void exit_timed(fsm_t *self, void* data)
+{
+    btn_ins_t * btn = (btn_ins_t *) data;
+
+    app_timer_cancel(&btn->timer);
+}
+
 //------------------------------------------------------//
 //  APP functions                                       //
 //------------------------------------------------------//
@@ -298,6 +308,7 @@ int btn_configure(btn_ins_t *device, uint32_t gpio)
     if(device == NULL) return -1;
     
     device->gpio = gpio;
+    device->task = NULL;
 
     fsm_init(&device->fsm, 
                 FSM_TRANSITIONS_GET(btn_fsm), 
@@ -307,8 +318,13 @@ int btn_configure(btn_ins_t *device, uint32_t gpio)
                 &FSM_STATE_GET(btn_fsm, ROOT_ST), 
                 device);
 
-    fsm_timed_event_set(&FSM_STATE_GET(btn_fsm, WAIT_ST), BTN_ANTI_BOUNCE_MS);
-    fsm_timed_event_set(&FSM_STATE_GET(btn_fsm, S_PRESS_ST), BTN_LONG_PRESS_MS);
+    // Timed events run on the shared timer wheel, not on fsm_ticks_hook
+    if(app_timer_init(&device->timer, timed_events_cb, device) != 0)
+    {
+        ESP_LOGE(TAG, "Failed to register the timed events");
+        return -2;
+    }
+    atomic_init(&device->timeout_gen, 0);
 
     return 0;
 }
@@ -328,6 +344,9 @@ int btn_actor_link(btn_ins_t *device, struct fsm_actor_t* actor, int actor_len)
 /**
  * @brief Runs button FSM
  * 
+ * A timeout is dispatched once the queued edges are run, and only if they didn't leave
+ * or re-arm the timed state it was armed for.
+ * 
  * @param device 
  * @return int 
  */
@@ -335,7 +354,14 @@ int btn_run(btn_ins_t *device)
 {
     if(device == NULL) return -1;
 
-    return fsm_run(&device->fsm); 
+    int ret = fsm_run(&device->fsm);
+
+    uint32_t gen = atomic_exchange(&device->timeout_gen, 0);
+    if(gen == 0 || !app_timer_is_current(&device->timer, gen)) return ret;
+
+    fsm_dispatch(&device->fsm, FSM_TIMEOUT_EV, device);
+
+    return fsm_run(&device->fsm);
 }
 
 /**
@@ -3,18 +3,17 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/timers.h"
 #include "esp_log.h"
 #include "freertos/queue.h"
 #include "driver/gpio.h"
 #include "fsm.h"
+#include "app_timer.h"
 
 //------------------------------------------------------//
 //  MACRO definitions                                    //
 //------------------------------------------------------//
 #define BTN_TASK_PRIOR 3
 
-#define BTN_TASK_PERIOD_MS  10
 #define BTN_ANTIBOUNCE_T    10  // 50 ms
 #define BTN_LONG_PRESS_T    500 // 500 ms
 #define BTN_MAX_EVENTS      10
@@ -50,8 +49,12 @@ typedef struct
     fsm_t fsm;
     // queu
     QueueHandle_t evt_q;
-    // Timer
-    TimerHandle_t timer;
+    // Runs the fsm, woken up by the edges and the timeouts
+    TaskHandle_t task;
+    // Timed events, on the shared timer wheel
+    app_timer_t timer;
+    // Generation of the last timeout, 0 if none waits for btn_run
+    atomic_uint_least32_t timeout_gen;
     uint32_t internal_count;
     uint32_t max_count;
     // Button gpio
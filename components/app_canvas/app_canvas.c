@@ -0,0 +1,226 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "led_strip.h"
+#include "esp_log.h"
+
+#include "app_canvas.h"
+
+static const char *TAG = "app_canvas";
+
+//------------------------------------------------------//
+//  LOCAL functions                                     //
+//------------------------------------------------------//
+
+/**
+ * @brief Appends a segment to the run table, merging it with the previous run when both are contiguous on the canvas and on the strip
+ * 
+ * @param canvas 
+ * @param seg 
+ * @param canvas_start first canvas pixel of the segment
+ */
+static void canvas_add_run(canvas_t *canvas, const canvas_segment_t *seg, uint32_t canvas_start)
+{
+    if(canvas->run_num > 0)
+    {
+        canvas_run_t *prev = &canvas->runs[canvas->run_num - 1];
+
+        if(prev->handle == seg->handle && prev->reversed == seg->reversed && prev->canvas_start + prev->len == canvas_start)
+        {
+            // forward: the segment goes on after the run, reversed: the segment comes before it on the strip
+            if(!seg->reversed && prev->strip_start + prev->len == seg->strip_start)
+            {
+                prev->len += seg->len;
+                return;
+            }
+            if(seg->reversed && seg->strip_start + seg->len == prev->strip_start)
+            {
+                prev->strip_start = seg->strip_start;
+                prev->len += seg->len;
+                return;
+            }
+        }
+    }
+
+    canvas_run_t *run = &canvas->runs[canvas->run_num++];
+    run->handle = seg->handle;
+    run->strip_start = seg->strip_start;
+    run->canvas_start = canvas_start;
+    run->len = seg->len;
+    run->reversed = seg->reversed;
+}
+
+static void canvas_add_handle(canvas_t *canvas, led_strip_handle_t handle)
+{
+    for (uint32_t i = 0; i < canvas->handle_num; i++)
+    {
+        if(canvas->handles[i] == handle) return;
+    }
+
+    canvas->handles[canvas->handle_num++] = handle;
+}
+
+//------------------------------------------------------//
+//  APP functions                                       //
+//------------------------------------------------------//
+
+/**
+ * @brief Builds a canvas over the segments, the run table is computed once here
+ * 
+ * @note The canvas starts black, its runs are cleared on the strips without a refresh, which checks them against their strips once
+ * 
+ * @param canvas 
+ * @param segments 
+ * @param segment_num 
+ * @return int 0 on success, -3 if a segment doesn't fit in its strip
+ */
+int app_canvas_init(canvas_t *canvas, const canvas_segment_t *segments, uint32_t segment_num)
+{
+    uint32_t scratch_len = 0;
+
+    if(canvas == NULL || segments == NULL || segment_num == 0) return -1;
+
+    memset(canvas, 0, sizeof(canvas_t));
+
+    canvas->runs = calloc(segment_num, sizeof(canvas_run_t));
+    canvas->handles = calloc(segment_num, sizeof(led_strip_handle_t));
+    if(canvas->runs == NULL || canvas->handles == NULL) goto no_mem;
+
+    for (uint32_t i = 0; i < segment_num; i++)
+    {
+        const canvas_segment_t *seg = &segments[i];
+
+        if(seg->handle != NULL && seg->len > 0)
+        {
+            canvas_add_run(canvas, seg, canvas->len);
+            canvas_add_handle(canvas, seg->handle);
+        }
+        canvas->len += seg->len;
+    }
+
+    // only the reversed runs need to be flipped before they're sent
+    for (uint32_t i = 0; i < canvas->run_num; i++)
+    {
+        if(canvas->runs[i].reversed && canvas->runs[i].len > scratch_len) scratch_len = canvas->runs[i].len;
+    }
+
+    if(canvas->len == 0) goto err;
+
+    canvas->pixels = calloc(canvas->len, CANVAS_BYTES_PER_PIXEL);
+    if(canvas->pixels == NULL) goto no_mem;
+
+    if(scratch_len > 0)
+    {
+        canvas->scratch = malloc(scratch_len * CANVAS_BYTES_PER_PIXEL);
+        if(canvas->scratch == NULL) goto no_mem;
+    }
+
+    for (uint32_t i = 0; i < canvas->run_num; i++)
+    {
+        const canvas_run_t *run = &canvas->runs[i];
+
+        if(led_strip_set_pixels(run->handle, run->strip_start, run->len, canvas->pixels, LED_PIXEL_FORMAT_GRB) != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Run %d doesn't fit in its strip", (int)i);
+            app_canvas_deinit(canvas);
+            return -3;
+        }
+    }
+
+    ESP_LOGI(TAG, "Canvas of %d pixels, %d runs over %d strips", (int)canvas->len, (int)canvas->run_num, (int)canvas->handle_num);
+
+    return 0;
+
+no_mem:
+    ESP_LOGE(TAG, "No mem for canvas");
+err:
+    app_canvas_deinit(canvas);
+    return -2;
+}
+
+/**
+ * @brief Frees the canvas buffers, the strips are left untouched
+ * 
+ * @param canvas 
+ */
+void app_canvas_deinit(canvas_t *canvas)
+{
+    if(canvas == NULL) return;
+
+    free(canvas->pixels);
+    free(canvas->runs);
+    free(canvas->handles);
+    free(canvas->scratch);
+    memset(canvas, 0, sizeof(canvas_t));
+}
+
+/**
+ * @brief Sets a canvas pixel, shown on the next app_canvas_show
+ * 
+ * @param canvas 
+ * @param index canvas pixel
+ * @param red 
+ * @param green 
+ * @param blue 
+ * @return int 0 on success
+ */
+int app_canvas_set_pixel(canvas_t *canvas, uint32_t index, uint8_t red, uint8_t green, uint8_t blue)
+{
+    if(canvas == NULL) return -1;
+    if(index >= canvas->len) return -2;
+
+    uint8_t *pixel = &canvas->pixels[index * CANVAS_BYTES_PER_PIXEL];
+    pixel[0] = green;
+    pixel[1] = red;
+    pixel[2] = blue;
+
+    return 0;
+}
+
+/**
+ * @brief Scatters the canvas to the strips and refreshes them
+ * 
+ * Forward runs are handed to led_strip_set_pixels straight from the canvas, reversed ones are flipped first.
+ * The strips are refreshed asynchronously where the backend allows it, so strips on different buses are sent together.
+ * 
+ * @param canvas 
+ * @return int 0 on success
+ */
+int app_canvas_show(canvas_t *canvas)
+{
+    if(canvas == NULL || canvas->pixels == NULL) return -1;
+
+    for (uint32_t i = 0; i < canvas->run_num; i++)
+    {
+        const canvas_run_t *run = &canvas->runs[i];
+        const uint8_t *src = &canvas->pixels[run->canvas_start * CANVAS_BYTES_PER_PIXEL];
+
+        if(run->reversed)
+        {
+            const uint8_t *from = src + (run->len - 1) * CANVAS_BYTES_PER_PIXEL;
+            uint8_t *to = canvas->scratch;
+
+            for (uint32_t j = 0; j < run->len; j++)
+            {
+                to[0] = from[0];
+                to[1] = from[1];
+                to[2] = from[2];
+                to += CANVAS_BYTES_PER_PIXEL;
+                from -= CANVAS_BYTES_PER_PIXEL;
+            }
+            src = canvas->scratch;
+        }
+
+        if(led_strip_set_pixels(run->handle, run->strip_start, run->len, src, LED_PIXEL_FORMAT_GRB) != ESP_OK) return -2;
+    }
+
+    for (uint32_t i = 0; i < canvas->handle_num; i++)
+    {
+        esp_err_t ret = led_strip_refresh_async(canvas->handles[i]);
+
+        if(ret == ESP_ERR_NOT_SUPPORTED) ret = led_strip_refresh(canvas->handles[i]);
+        if(ret != ESP_OK) return -3;
+    }
+
+    return 0;
+}
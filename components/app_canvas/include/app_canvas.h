@@ -0,0 +1,70 @@
+#ifndef _APP_CANVAS_H_
+#define _APP_CANVAS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "led_strip.h"
+
+//------------------------------------------------------//
+//  MACRO definitions                                    //
+//------------------------------------------------------//
+/* Bytes per canvas pixel, kept in the strip wire order (G,R,B) */
+#define CANVAS_BYTES_PER_PIXEL 3
+
+//------------------------------------------------------//
+//  TYPES DEFINITIONS                                    //
+//------------------------------------------------------//
+
+/**
+ * @brief Piece of the canvas wired to a physical strip
+ * 
+ * The segments are laid out on the canvas one after the other, in the order they're given.
+ * A segment without handle is a gap, its canvas pixels are rendered but not sent anywhere.
+ */
+typedef struct
+{
+    led_strip_handle_t handle;  // physical strip, NULL for a gap
+    uint32_t strip_start;       // first strip pixel of the segment
+    uint32_t len;               // pixels in the segment
+    bool reversed;              // the canvas runs from the end of the segment to its start
+} canvas_segment_t;
+
+/**
+ * @brief Span of canvas pixels sent to a strip with a single set_pixels call, built once from the segments
+ * 
+ */
+typedef struct
+{
+    led_strip_handle_t handle;
+    uint32_t strip_start;
+    uint32_t canvas_start;
+    uint32_t len;
+    bool reversed;
+} canvas_run_t;
+
+/**
+ * @brief Virtual canvas over one or more strips
+ * 
+ */
+typedef struct
+{
+    uint32_t len;                   // canvas pixels
+    uint8_t *pixels;                // canvas pixels, CANVAS_BYTES_PER_PIXEL each, rendered by the effects
+    canvas_run_t *runs;             // how the canvas is scattered to the strips
+    uint32_t run_num;
+    led_strip_handle_t *handles;    // strips to refresh, each one once
+    uint32_t handle_num;
+    uint8_t *scratch;               // reversed runs are flipped here, sized for the longest one
+}canvas_t;
+
+//------------------------------------------------------//
+//  FUNCTIONS                                           //
+//------------------------------------------------------//
+
+int app_canvas_init(canvas_t *canvas, const canvas_segment_t *segments, uint32_t segment_num);
+void app_canvas_deinit(canvas_t *canvas);
+int app_canvas_set_pixel(canvas_t *canvas, uint32_t index, uint8_t red, uint8_t green, uint8_t blue);
+int app_canvas_show(canvas_t *canvas);
+
+#endif // _APP_CANVAS_H_
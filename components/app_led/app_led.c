@@ -2,10 +2,12 @@
 #include <string.h>
 
 #include "freertos/FreeRTOS.h"
-#include "freertos/timers.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 
 #include "led_strip.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "sdkconfig.h"
 
 #include "app_led.h"
@@ -17,7 +19,8 @@ static const char *TAG = "app_led";
 //  FSM declarations                                    //
 //------------------------------------------------------//
 static void internal_led_task(void* arg);
-static void timed_events_timer(TimerHandle_t xTimer);
+static void timed_events_timer(void *arg, uint32_t gen);
+static void anim_timer_cb(void *arg);
 
 /**
  * @brief MEF states
@@ -32,6 +35,7 @@ enum {
     BLINKING_ST,
     BLINK_ON_ST,
     BLINK_OFF_ST,
+    ANIMATING_ST,
     UPDATE_ST,
     LAST_ST,
 };
@@ -47,6 +51,7 @@ enum {
     TOGGLE_EV,
     READY_EV,
     BLINK_EV,
+    ANIMATE_EV,
     LAST_EV,
 };
 
@@ -54,7 +59,12 @@ enum {
 static void enter_init(fsm_t *self, void* data);
 static void enter_on(fsm_t *self, void* data);
 static void enter_off(fsm_t *self, void* data);
+static void enter_blink_on(fsm_t *self, void* data);
+static void enter_blink_off(fsm_t *self, void* data);
+static void exit_blink(fsm_t *self, void* data);
 static void led_update(fsm_t *self, void* data);
+static void enter_animating(fsm_t *self, void* data);
+static void exit_animating(fsm_t *self, void* data);
 
 // Define FSM states
 FSM_STATES_INIT(led_fsm)
@@ -65,8 +75,9 @@ FSM_CREATE_STATE(led_fsm, OFF_ST,       ROOT_ST,        FSM_ST_NONE,    enter_of
 FSM_CREATE_STATE(led_fsm, ON_ST,        ROOT_ST,        ON_FIX_ST,      enter_on,       NULL, NULL)
 FSM_CREATE_STATE(led_fsm, ON_FIX_ST,    ON_ST,          FSM_ST_NONE,    enter_on,       NULL, NULL)
 FSM_CREATE_STATE(led_fsm, BLINKING_ST,  ON_ST,          BLINK_OFF_ST,   NULL,           NULL, NULL)
-FSM_CREATE_STATE(led_fsm, BLINK_ON_ST,  BLINKING_ST,    FSM_ST_NONE,    enter_on,       NULL, NULL)
-FSM_CREATE_STATE(led_fsm, BLINK_OFF_ST, BLINKING_ST,    FSM_ST_NONE,    enter_off,      NULL, NULL)
+FSM_CREATE_STATE(led_fsm, BLINK_ON_ST,  BLINKING_ST,    FSM_ST_NONE,    enter_blink_on,  NULL, exit_blink)
+FSM_CREATE_STATE(led_fsm, BLINK_OFF_ST, BLINKING_ST,    FSM_ST_NONE,    enter_blink_off, NULL, exit_blink)
+FSM_CREATE_STATE(led_fsm, ANIMATING_ST, ON_ST,          FSM_ST_NONE,    enter_animating, NULL, exit_animating)
 FSM_STATES_END()
 
 // Define FSM transitions
@@ -83,22 +94,237 @@ FSM_TRANSITION_CREATE(led_fsm,      BLINK_ON_ST,    FSM_TIMEOUT_EV,  BLINK_OFF_S
 FSM_TRANSITION_CREATE(led_fsm,      BLINK_OFF_ST,   FSM_TIMEOUT_EV,  BLINK_ON_ST)
 FSM_TRANSITION_CREATE(led_fsm,      BLINKING_ST,    ON_EV,           ON_FIX_ST)
 FSM_TRANSITION_CREATE(led_fsm,      BLINKING_ST,    BLINK_EV,        OFF_ST)
+FSM_TRANSITION_CREATE(led_fsm,      ON_FIX_ST,      ANIMATE_EV,      ANIMATING_ST)
+FSM_TRANSITION_CREATE(led_fsm,      ANIMATING_ST,   ANIMATE_EV,      ANIMATING_ST)
+FSM_TRANSITION_CREATE(led_fsm,      ANIMATING_ST,   ON_EV,           ON_FIX_ST)
 FSM_TRANSITIONS_END()
 
 //------------------------------------------------------//
 //  APP declarations                                    //
 //------------------------------------------------------//
+// Pixel buffers handed out by configure_led, never given back
+static led_pixel_t pixel_pool[APP_LED_POOL_LEN];
+static uint32_t pixel_pool_used = 0;
 
+/*
+ * Update mailbox, "latest frame wins"
+ * 
+ * Three frames: the front one is shown by the led task, the ready one is the latest published,
+ * the back one is written by an update. Writers take turns on mailbox_lock: one brings the back
+ * frame up to the latest, applies its pixels and publishes it as the ready frame, so every write
+ * lands in the next frame published. The led task swaps front and ready when FRESH is set and
+ * never waits for the writers, a frame published over a fresh one replaces it.
+ * 
+ * Each frame keeps the span of pixels written since it was last published, only that span is
+ * copied from the latest frame when it becomes the back frame again.
+ */
+#define MAILBOX_FRONT(m)    ((m) & 0x3)
+#define MAILBOX_READY(m)    (((m) >> 2) & 0x3)
+#define MAILBOX_BACK(m)     (3 - MAILBOX_FRONT(m) - MAILBOX_READY(m))
+#define MAILBOX_FRESH       (1 << 4)
+#define MAILBOX_INIT        ((0 << 0) | (1 << 2))
 
 //------------------------------------------------------//
 //  LOCAL functions                                     //
 //------------------------------------------------------//
+/**
+ * @brief Starts measuring a dispatch to refresh latency
+ * 
+ */
+static void latency_start(led_ins_t *led_data)
+{
+    // the latency is measured from the oldest event not processed yet, only the first one stamps it
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    uint32_t idle = 0;
+
+    atomic_compare_exchange_strong(&led_data->dispatch_us, &idle, now != 0 ? now : 1);
+}
+
+/**
+ * @brief Dispatches an event and wakes the led task up to process it
+ * 
+ */
+static void led_dispatch(led_ins_t *led_data, int ev)
+{
+    latency_start(led_data);
+
+    fsm_dispatch(&led_data->fsm, ev, led_data);
+
+    if(led_data->task != NULL) xTaskNotifyGive(led_data->task);
+}
+
+static inline led_pixel_t *pixel_frame(led_ins_t *led_data, uint32_t frame)
+{
+    return &led_data->pixels[frame * led_data->strip_config.max_leds];
+}
+
+/**
+ * @brief Marks a frame as matching the latest one
+ * 
+ */
+static inline void mailbox_fresh_span(led_ins_t *led_data, uint32_t frame)
+{
+    led_data->mailbox_stale_from[frame] = led_data->strip_config.max_leds;
+    led_data->mailbox_stale_to[frame] = 0;
+}
+
+/**
+ * @brief Claims the back frame, brought up to the latest frame
+ * 
+ * @note Waits for the writer holding it, the lock is given back by mailbox_publish
+ * 
+ * @return led_pixel_t* 
+ */
+static led_pixel_t *mailbox_claim(led_ins_t *led_data)
+{
+    xSemaphoreTake(led_data->mailbox_lock, portMAX_DELAY);
+
+    // Front and ready may be swapped by the led task meanwhile, the back frame stays the same
+    // and the latest frame isn't written by anybody else while the lock is held
+    uint32_t m = atomic_load(&led_data->mailbox);
+    uint32_t frame = MAILBOX_BACK(m);
+    led_pixel_t *back = pixel_frame(led_data, frame);
+    const led_pixel_t *latest = pixel_frame(led_data, (m & MAILBOX_FRESH) ? MAILBOX_READY(m) : MAILBOX_FRONT(m));
+    uint32_t from = led_data->mailbox_stale_from[frame];
+    uint32_t to = led_data->mailbox_stale_to[frame];
+
+    if(from < to) memcpy(&back[from], &latest[from], sizeof(led_pixel_t) * (to - from));
+    mailbox_fresh_span(led_data, frame);
+
+    return back;
+}
+
+/**
+ * @brief Publishes the back frame as the ready one, gives the lock back and wakes the led task up
+ * 
+ * @param index first led written
+ * @param len number of leds written
+ */
+static void mailbox_publish(led_ins_t *led_data, uint32_t index, uint32_t len)
+{
+    uint32_t m = atomic_load(&led_data->mailbox);
+    uint32_t next;
+
+    // The other two frames now miss the pixels written
+    for (uint32_t frame = 0; frame < LED_MAILBOX_FRAMES; frame++)
+    {
+        if(frame == MAILBOX_BACK(m)) continue;
+        if(index < led_data->mailbox_stale_from[frame]) led_data->mailbox_stale_from[frame] = index;
+        if(index + len > led_data->mailbox_stale_to[frame]) led_data->mailbox_stale_to[frame] = index + len;
+    }
+
+    do
+    {
+        next = MAILBOX_FRONT(m) | (MAILBOX_BACK(m) << 2) | MAILBOX_FRESH;
+    } while(!atomic_compare_exchange_weak(&led_data->mailbox, &m, next));
+
+    xSemaphoreGive(led_data->mailbox_lock);
+
+    atomic_fetch_add(&led_data->mailbox_published, 1);
+    if(m & MAILBOX_FRESH) atomic_fetch_add(&led_data->mailbox_overwritten, 1);
+
+    latency_start(led_data);
+
+    if(led_data->task != NULL) xTaskNotifyGive(led_data->task);
+}
+
+/**
+ * @brief Makes the latest published frame the front one
+ * 
+ * @return true if there was a new frame
+ */
+static bool mailbox_take(led_ins_t *led_data)
+{
+    uint32_t m = atomic_load(&led_data->mailbox);
+    uint32_t next;
+
+    do
+    {
+        if(!(m & MAILBOX_FRESH)) return false;
+        next = MAILBOX_READY(m) | (MAILBOX_FRONT(m) << 2);
+    } while(!atomic_compare_exchange_weak(&led_data->mailbox, &m, next));
+
+    return true;
+}
+
+/**
+ * @brief Records the latency of a refresh triggered by an event
+ * 
+ */
+static void latency_record(led_ins_t *led_data)
+{
+    uint32_t dispatch_us = atomic_exchange(&led_data->dispatch_us, 0);
+    if(dispatch_us == 0) return;
+
+    uint32_t latency_us = (uint32_t)esp_timer_get_time() - dispatch_us;
+
+    led_data->latency.count++;
+    led_data->latency.last_us = latency_us;
+    if(latency_us > led_data->latency.max_us) led_data->latency.max_us = latency_us;
+}
+
+/**
+ * @brief Drops the latency of an event whose refresh failed, so the next one isn't charged for it
+ * 
+ */
+static void latency_drop(led_ins_t *led_data)
+{
+    atomic_store(&led_data->dispatch_us, 0);
+}
+
 static void strip_update(led_ins_t *led_data)
 {
-    for (uint8_t i = 0; i < led_data->strip_config.max_leds; i++)
+    const led_pixel_t *front = pixel_frame(led_data, MAILBOX_FRONT(atomic_load(&led_data->mailbox)));
+
+    // The pixels are already kept in the strip wire order, send them in one call
+    led_strip_set_pixels(led_data->handle, 0, led_data->strip_config.max_leds,
+                         (const uint8_t *)front, LED_PIXEL_FORMAT_GRB);
+}
+
+/**
+ * @brief Starts sending the strip buffer, blocking only on backends without an async refresh
+ * 
+ */
+static esp_err_t strip_refresh(led_ins_t *led_data)
+{
+    esp_err_t ret = led_strip_refresh_async(led_data->handle);
+
+    if(ret == ESP_ERR_NOT_SUPPORTED) ret = led_strip_refresh(led_data->handle);
+
+    return ret;
+}
+
+static void strip_show(led_ins_t *led_data)
+{
+    /* Updates published while off or blinking are shown from the next on-phase */
+    if(mailbox_take(led_data)) led_data->frame_cached = false;
+
+    /* The colours only change with an update, blink and toggle just send the cached frame again */
+    if(led_data->frame_cached)
+    {
+        if(led_strip_refresh_frame(led_data->handle, LED_ON_FRAME_SLOT) == ESP_OK)
+        {
+            latency_record(led_data);
+            return;
+        }
+
+        /* The cached frame can't be sent, build it again */
+        led_data->frame_cached = false;
+    }
+
+    /* Set the LED pixel using RGB from 0 (0%) to 255 (100%) for each color */
+    strip_update(led_data);
+    led_data->frame_cached = (led_strip_capture_frame(led_data->handle, LED_ON_FRAME_SLOT) == ESP_OK);
+
+    /* Start sending the data, the DMA clocks it out while the FSM goes on */
+    if(strip_refresh(led_data) != ESP_OK)
     {
-        led_strip_set_pixel(led_data->handle, i, led_data->colour[i].rgb.red, led_data->colour[i].rgb.green, led_data->colour[i].rgb.blue);
+        ESP_LOGE(TAG, "Failed to refresh %d", led_data->strip_config.strip_gpio_num);
+        latency_drop(led_data);
+        return;
     }
+
+    latency_record(led_data);
 }
 
 //------------------------------------------------------//
@@ -117,28 +343,36 @@ static void enter_init(fsm_t *self, void* data)
 
     ESP_LOGI(TAG, "LED init %d", led_data->strip_config.strip_gpio_num);
     
-    ESP_ERROR_CHECK(led_strip_new_spi_device(&led_data->strip_config, &led_data->spi_config, &led_data->handle));
-
-    // Timer for timed events
-    led_data->timer = xTimerCreate(
-        "TimedEvents",                              // Timer name
-        LED_TIMER_PERIOD_MS / portTICK_PERIOD_MS,   // Period in ticks
-        pdTRUE,                                     // Auto-reload (periodic)
-        (void*)self,                               // Timer ID (not used here)
-        timed_events_timer                          // Callback function
-    );
-
-    if (led_data->timer != NULL) xTimerStart(led_data->timer, 0);
+    // a strip created beforehand (e.g. a capture strip on the host) is kept
+    if(led_data->handle == NULL)
+    {
+#if CONFIG_IDF_TARGET_LINUX
+        ESP_LOGE(TAG, "No LED strip given");
+        return;
+#else
+        ESP_ERROR_CHECK(led_strip_new_spi_device(&led_data->strip_config, &led_data->spi_config, &led_data->handle));
+#endif
+    }
+
+    // Precise timer for the animation frames
+    const esp_timer_create_args_t anim_timer_args = {
+        .callback = anim_timer_cb,
+        .arg = led_data,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "led_anim",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&anim_timer_args, &led_data->anim_timer));
     
     // Task init
-    result = xTaskCreate(internal_led_task, "led_task", 2048*2, (void*const)led_data, tskIDLE_PRIORITY+LED_TASK_PRIOR, NULL);
+    result = xTaskCreate(internal_led_task, "led_task", 2048*2, (void*const)led_data, tskIDLE_PRIORITY+LED_TASK_PRIOR, &led_data->task);
     if(result != pdPASS)
     {
         ESP_LOGE(TAG, "Task error");
         return;
     }
 
-    fsm_dispatch(self, READY_EV, data);
+    led_dispatch(led_data, READY_EV);
 }
 
 /**
@@ -153,10 +387,7 @@ static void enter_on(fsm_t *self, void* data)
 
     ESP_LOGI(TAG, "Turning on %d", led_data->strip_config.strip_gpio_num);
 
-    /* Set the LED pixel using RGB from 0 (0%) to 255 (100%) for each color */
-    strip_update(led_data);
-    /* Refresh the strip to send data */
-    led_strip_refresh(led_data->handle);
+    strip_show(led_data);
 }
 
 /**
@@ -171,8 +402,58 @@ static void enter_off(fsm_t *self, void* data)
 
     ESP_LOGI(TAG, "Turning off %d", led_data->strip_config.strip_gpio_num);
 
-    /* Set all LED off to clear all pixels */
-    led_strip_clear(led_data->handle);
+    /* Set all LED off to clear all pixels, the frame is sent while the FSM goes on */
+    if(led_strip_clear_buffer_only(led_data->handle) != ESP_OK || strip_refresh(led_data) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to turn off %d", led_data->strip_config.strip_gpio_num);
+        latency_drop(led_data);
+        return;
+    }
+
+    latency_record(led_data);
+}
+
+/**
+ * @brief Turns the led on and arms the blink timeout
+ * 
+ * @param self 
+ * @param data 
+ */
+static void enter_blink_on(fsm_t *self, void* data)
+{
+    led_ins_t *led_data = data;
+
+    enter_on(self, data);
+    app_timer_arm(&led_data->timer, LED_BLINK_PERIOD_MS);
+}
+
+/**
+ * @brief Turns the led off and arms the blink timeout
+ * 
+ * @param self 
+ * @param data 
+ */
+static void enter_blink_off(fsm_t *self, void* data)
+{
+    led_ins_t *led_data = data;
+
+    enter_off(self, data);
+    app_timer_arm(&led_data->timer, LED_BLINK_PERIOD_MS);
+}
+
+/**
+ * @brief Disarms the blink timeout, the state may be left before it expires
+ * 
+ * A timeout already fired is dropped by the task, the cancel makes its generation stale.
+ * 
+ * @param self 
+ * @param data 
+ */
+static void exit_blink(fsm_t *self, void* data)
+{
+    led_ins_t *led_data = data;
+
+    app_timer_cancel(&led_data->timer);
 }
 
 static void led_update(fsm_t *self, void* data)
@@ -181,15 +462,103 @@ static void led_update(fsm_t *self, void* data)
 
     ESP_LOGI(TAG, "Updating colour %d", led_data->strip_config.strip_gpio_num);
 
-    /* Set the LED pixel using RGB from 0 (0%) to 255 (100%) for each color */
-    strip_update(led_data);
-    
-    /* Refresh the strip to send data */
-    led_strip_refresh(led_data->handle);
+    /* New colours, encode them and cache the new frame */
+    led_data->frame_cached = false;
+    strip_show(led_data);
 }
 
 /**
- * @brief Internal task for running fsm every 10ms
+ * @brief Starts the effect given to app_led_animate
+ * 
+ * @param self 
+ * @param data 
+ */
+static void enter_animating(fsm_t *self, void* data)
+{
+    led_ins_t *led_data = data;
+
+    ESP_LOGI(TAG, "Animating %d", led_data->strip_config.strip_gpio_num);
+
+    led_data->effect = led_data->next_effect;
+    led_data->anim_frame = 0;
+    atomic_store(&led_data->anim_due, 1);
+
+    // Frames faster than the strip can send them would only queue up behind each other
+    uint32_t fps = led_data->effect->fps;
+    uint32_t max_fps;
+    if(led_strip_get_max_fps(led_data->handle, &max_fps) == ESP_OK && max_fps != 0 && fps > max_fps) fps = max_fps;
+
+    if(esp_timer_start_periodic(led_data->anim_timer, 1000000 / fps) != ESP_OK)
+    {
+        // No frames would ever come, go back to the fixed colours
+        ESP_LOGE(TAG, "Failed to start the animation timer %d", led_data->strip_config.strip_gpio_num);
+        atomic_store(&led_data->anim_due, 0);
+        led_dispatch(led_data, ON_EV);
+        return;
+    }
+    xTaskNotifyGive(led_data->task);
+}
+
+/**
+ * @brief Stops the animation
+ * 
+ * @param self 
+ * @param data 
+ */
+static void exit_animating(fsm_t *self, void* data)
+{
+    led_ins_t *led_data = data;
+
+    esp_timer_stop(led_data->anim_timer);
+    atomic_store(&led_data->anim_due, 0);
+
+    // The strip no longer shows the "on" frame, the next show sends it again
+    led_data->frame_cached = false;
+}
+
+/**
+ * @brief Renders and sends the animation frame due
+ * 
+ * @param led_data 
+ * @param due frames due since the last one sent, more than one if it was late
+ */
+static void animate_frame(led_ins_t *led_data, uint32_t due)
+{
+    led_anim_stats_t *stats = &led_data->anim_stats;
+    uint32_t len = led_data->strip_config.max_leds;
+    led_pixel_t *pixels = pixel_frame(led_data, LED_ANIM_FRAME);
+
+    // Late frames are skipped, the effect is given the frame number of the time reached
+    stats->misses += due - 1;
+    led_data->anim_frame += due - 1;
+
+    uint32_t start_us = (uint32_t)esp_timer_get_time();
+    led_data->effect->render(led_data->effect->state, pixels, len, led_data->anim_frame++);
+    uint32_t render_us = (uint32_t)esp_timer_get_time() - start_us;
+
+    // The copy into the driver counts as transmit time, with the start of the refresh
+    esp_err_t ret = led_strip_set_pixels(led_data->handle, 0, len, (const uint8_t *)pixels, LED_PIXEL_FORMAT_GRB);
+    if(ret == ESP_OK) ret = strip_refresh(led_data);
+    uint32_t transmit_us = (uint32_t)esp_timer_get_time() - start_us - render_us;
+
+    if(ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to send animation frame %d", led_data->strip_config.strip_gpio_num);
+        stats->errors++;
+        return;
+    }
+
+    stats->frames++;
+    stats->render_us_last = render_us;
+    if(render_us > stats->render_us_max) stats->render_us_max = render_us;
+    stats->transmit_us_last = transmit_us;
+    if(transmit_us > stats->transmit_us_max) stats->transmit_us_max = transmit_us;
+}
+
+/**
+ * @brief Internal task running the fsm when an event is dispatched
+ * 
+ * @note With a frame period set, it also runs at least once per period
  * 
  * @param arg 
  */
@@ -204,18 +573,40 @@ static void internal_led_task(void* arg)
 
     for(;;)
     {
-        vTaskDelay(LED_TASK_PERIOD_MS / portTICK_PERIOD_MS);
+        /* A frame published while on is shown right away, otherwise it waits in the mailbox */
+        if((atomic_load(&led->mailbox) & MAILBOX_FRESH) && fsm_state_get(&led->fsm) == ON_FIX_ST)
+        {
+            fsm_dispatch(&led->fsm, UPDATE_EV, led);
+        }
 
         app_led_run(led);
+
+        uint32_t due = atomic_exchange(&led->anim_due, 0);
+        if(due != 0 && fsm_state_get(&led->fsm) == ANIMATING_ST) animate_frame(led, due);
+
+        // One run per dispatch, the notification counts them
+        ulTaskNotifyTake(pdFALSE, (led->frame_period_ms == 0) ? portMAX_DELAY : pdMS_TO_TICKS(led->frame_period_ms));
     }
 }
 
 // Timer callback function
-static void timed_events_timer(TimerHandle_t xTimer)
+static void timed_events_timer(void *arg, uint32_t gen)
 {
-    fsm_t *fsm =  (fsm_t*)pvTimerGetTimerID(xTimer);
+    led_ins_t *led_data = arg;
+
+    // The blink phase may be left or armed again before the task runs, it checks the generation then
+    atomic_store(&led_data->timeout_gen, gen);
 
-    fsm_ticks_hook(fsm);
+    if(led_data->task != NULL) xTaskNotifyGive(led_data->task);
+}
+
+// Animation timer callback, a frame is due
+static void anim_timer_cb(void *arg)
+{
+    led_ins_t *led_data = arg;
+
+    atomic_fetch_add(&led_data->anim_due, 1);
+    xTaskNotifyGive(led_data->task);
 }
 
 //------------------------------------------------------//
@@ -231,7 +622,7 @@ void blink_led(led_ins_t *device)
 {
     if(device == NULL) return;
 
-    fsm_dispatch(&device->fsm, BLINK_EV, device);
+    led_dispatch(device, BLINK_EV);
 }
 
 /**
@@ -243,7 +634,7 @@ void toggle_led(led_ins_t *device)
 {
     if(device == NULL) return;
 
-    fsm_dispatch(&device->fsm, TOGGLE_EV, device);
+    led_dispatch(device, TOGGLE_EV);
 }
 
 
@@ -251,23 +642,65 @@ void led_on(led_ins_t *device)
 {
     if(device == NULL) return;
 
-    fsm_dispatch(&device->fsm, ON_EV, device);
+    led_dispatch(device, ON_EV);
 }
 
 void led_off(led_ins_t *device)
 {
     if(device == NULL) return;
 
-    fsm_dispatch(&device->fsm, OFF_EV, device);
+    led_dispatch(device, OFF_EV);
 }
 
 /**
  * @brief Configures the led strip
  * 
+ * @note device->pixels may point to a caller buffer of device->pixels_len pixels, at least
+ *       LED_PIXEL_FRAMES * strip_config.max_leds, otherwise it is taken from the static pool
+ * 
+ * @return int -2 if the pool has no room left, -4 if the caller buffer is too short, -5 if the update lock can't be created
  */
-void configure_led(led_ins_t *device)
+int configure_led(led_ins_t *device)
 {
-    if(device == NULL) return;
+    if(device == NULL) return -1;
+
+    uint32_t len = device->strip_config.max_leds;
+
+    if(device->pixels == NULL)
+    {
+        if((len * LED_PIXEL_FRAMES) > (APP_LED_POOL_LEN - pixel_pool_used))
+        {
+            ESP_LOGE(TAG, "No room for %d LEDs in the pixel pool", (int)len);
+            return -2;
+        }
+
+        device->pixels = &pixel_pool[pixel_pool_used];
+        device->pixels_len = len * LED_PIXEL_FRAMES;
+        pixel_pool_used += len * LED_PIXEL_FRAMES;
+    }
+    else if(device->pixels_len < (len * LED_PIXEL_FRAMES))
+    {
+        ESP_LOGE(TAG, "Pixel buffer of %d pixels too short for %d LEDs", (int)device->pixels_len, (int)len);
+        return -4;
+    }
+
+    // Every frame of the mailbox starts from the pixels given in the first one
+    for (uint32_t i = 0; i < LED_MAILBOX_FRAMES; i++)
+    {
+        if(i > 0) memcpy(&device->pixels[i * len], device->pixels, sizeof(led_pixel_t) * len);
+        mailbox_fresh_span(device, i);
+    }
+
+    if(device->mailbox_lock == NULL) device->mailbox_lock = xSemaphoreCreateMutex();
+    if(device->mailbox_lock == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to create the update lock %d", device->strip_config.strip_gpio_num);
+        return -5;
+    }
+    atomic_init(&device->mailbox, MAILBOX_INIT);
+    atomic_init(&device->mailbox_published, 0);
+    atomic_init(&device->mailbox_overwritten, 0);
+    atomic_init(&device->dispatch_us, 0);
 
     ESP_LOGI(TAG, "Inits the FSM %d", device->strip_config.strip_gpio_num);
     
@@ -279,25 +712,60 @@ void configure_led(led_ins_t *device)
                 &FSM_STATE_GET(led_fsm, ROOT_ST), 
                 device);
 
-    fsm_timed_event_set(&FSM_STATE_GET(led_fsm, BLINK_ON_ST), LED_BLINK_PERIOD);
-    fsm_timed_event_set(&FSM_STATE_GET(led_fsm, BLINK_OFF_ST), LED_BLINK_PERIOD);
+    // Timed events run on the shared timer wheel, not on fsm_ticks_hook
+    if(app_timer_init(&device->timer, timed_events_timer, device) != 0)
+    {
+        ESP_LOGE(TAG, "Failed to register the timed events %d", device->strip_config.strip_gpio_num);
+        return -3;
+    }
+    atomic_init(&device->timeout_gen, 0);
+
+    return 0;
 }
 
 /**
  * @brief Runs led FSM
  * 
+ * A timeout is dispatched once the queued events are run, and only if they didn't leave
+ * or re-arm the blink phase it was armed for.
+ * 
  * @return int 
  */
 int app_led_run(led_ins_t *device)
 {
     if(device == NULL) return -1;
 
-    return fsm_run(&device->fsm); 
+    int ret = fsm_run(&device->fsm);
+
+    uint32_t gen = atomic_exchange(&device->timeout_gen, 0);
+    if(gen == 0 || !app_timer_is_current(&device->timer, gen)) return ret;
+
+    latency_start(device);
+    fsm_dispatch(&device->fsm, FSM_TIMEOUT_EV, device);
+
+    return fsm_run(&device->fsm);
+}
+
+/**
+ * @brief Checks an update of len leds from index
+ * 
+ * @return int 0 if the update can be done
+ */
+static int update_check(led_ins_t *device, uint32_t index, const void *src, uint32_t len)
+{
+    if(device == NULL || src == NULL) return -11;
+    if(index >= device->strip_config.max_leds) return -12;
+    if(len == 0 || len > device->strip_config.max_leds) return -13;
+    if((index+len) > device->strip_config.max_leds) return -14;
+
+    return 0;
 }
 
 /**
  * @brief  Changes led colour
  * 
+ * @note Compatibility wrapper, the colours are packed into pixels
+ * 
  * @param device 
  * @param index 
  * @param colour 
@@ -306,18 +774,152 @@ int app_led_run(led_ins_t *device)
  */
 int app_led_update(led_ins_t *device, uint32_t index, led_colour_t *colour, uint32_t len)
 {
-    if(device == NULL || colour == NULL) return -11;
-    if(index >= device->strip_config.max_leds) return -12;
-    if(len == 0 || len > device->strip_config.max_leds) return -13;
-    if((index+len) > device->strip_config.max_leds) return -14;
+    int ret = update_check(device, index, colour, len);
+
+    if(ret != 0) return ret;
     
-    int ret = fsm_state_get(&device->fsm);
+    led_pixel_t *pixels = mailbox_claim(device) + index;
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        pixels[i].green = colour[i].rgb.green;
+        pixels[i].red = colour[i].rgb.red;
+        pixels[i].blue = colour[i].rgb.blue;
+    }
+
+    mailbox_publish(device, index, len);
+
+    return 0;
+}
+
+/**
+ * @brief  Changes led pixels
+ * 
+ * @note Only waits for another update being written, the frame is shown by the led task on the next on-phase
+ * 
+ * @param device 
+ * @param index 
+ * @param pixels 
+ * @param len number of led to update
+ * @return int 
+ */
+int app_led_update_pixels(led_ins_t *device, uint32_t index, const led_pixel_t *pixels, uint32_t len)
+{
+    int ret = update_check(device, index, pixels, len);
+
+    if(ret != 0) return ret;
     
-    if(ret != ON_FIX_ST) return -ret;
+    led_pixel_t *back = mailbox_claim(device);
+
+    memcpy(&back[index], pixels, sizeof(led_pixel_t)*len);
+
+    mailbox_publish(device, index, len);
+
+    return 0;
+}
+
+/**
+ * @brief  Changes led channels, one plane at a time
+ * 
+ * @param device 
+ * @param index 
+ * @param planes channels to update, a NULL plane is left unchanged
+ * @param len number of led to update
+ * @return int 
+ */
+int app_led_update_planes(led_ins_t *device, uint32_t index, const led_planes_t *planes, uint32_t len)
+{
+    int ret = update_check(device, index, planes, len);
+
+    if(ret != 0) return ret;
     
-    memcpy(&device->colour[index], colour, sizeof(led_colour_t)*len);
+    led_pixel_t *pixels = mailbox_claim(device) + index;
+
+    if(planes->red != NULL)
+    {
+        for (uint32_t i = 0; i < len; i++) pixels[i].red = planes->red[i];
+    }
+    if(planes->green != NULL)
+    {
+        for (uint32_t i = 0; i < len; i++) pixels[i].green = planes->green[i];
+    }
+    if(planes->blue != NULL)
+    {
+        for (uint32_t i = 0; i < len; i++) pixels[i].blue = planes->blue[i];
+    }
+
+    mailbox_publish(device, index, len);
+
+    return 0;
+}
+
+/**
+ * @brief Gets the dispatch to refresh latency
+ * 
+ * @param device 
+ * @param latency 
+ * @return int 
+ */
+int app_led_latency_get(led_ins_t *device, led_latency_t *latency)
+{
+    if(device == NULL || latency == NULL) return -1;
+
+    *latency = device->latency;
+
+    return 0;
+}
+
+/**
+ * @brief Gets the update mailbox counters
+ * 
+ * @param device 
+ * @param stats 
+ * @return int 
+ */
+int app_led_mailbox_stats_get(led_ins_t *device, led_mailbox_stats_t *stats)
+{
+    if(device == NULL || stats == NULL) return -1;
+
+    stats->published = atomic_load(&device->mailbox_published);
+    stats->overwritten = atomic_load(&device->mailbox_overwritten);
+
+    return 0;
+}
+
+/**
+ * @brief Starts an animation, from the led on
+ * 
+ * @note The effect must stay valid while it runs, led_on goes back to the fixed colours
+ * 
+ * @param device 
+ * @param effect 
+ * @return int -2 if the frame rate is 0 or over LED_ANIM_MAX_FPS, -3 if the led isn't on with its fixed colours
+ */
+int app_led_animate(led_ins_t *device, const led_effect_t *effect)
+{
+    if(device == NULL || effect == NULL || effect->render == NULL) return -1;
+    if(effect->fps == 0 || effect->fps > LED_ANIM_MAX_FPS) return -2;
+    if(fsm_state_get(&device->fsm) != ON_FIX_ST) return -3;
+
+    device->next_effect = effect;
+
+    led_dispatch(device, ANIMATE_EV);
+
+    return 0;
+}
+
+/**
+ * @brief Gets the animation counters
+ * 
+ * @param device 
+ * @param stats 
+ * @return int 
+ */
+int app_led_anim_stats_get(led_ins_t *device, led_anim_stats_t *stats)
+{
+    if(device == NULL || stats == NULL) return -1;
 
-    fsm_dispatch(&device->fsm, UPDATE_EV, device);
+    *stats = device->anim_stats;
 
     return 0;
 }
\ No newline at end of file
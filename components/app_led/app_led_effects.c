@@ -0,0 +1,99 @@
+#include <string.h>
+
+#include "app_led.h"
+
+//------------------------------------------------------//
+//  LOCAL functions                                     //
+//------------------------------------------------------//
+/**
+ * @brief Scales a colour channel by level (0 - 255)
+ * 
+ */
+static inline uint8_t scale(uint8_t channel, uint32_t level)
+{
+    return (channel * level + 127) / 255;
+}
+
+/**
+ * @brief Fully saturated colour of a hue, in 1/256 of the wheel
+ * 
+ */
+static inline void hue_wheel(uint32_t hue, led_pixel_t *pixel)
+{
+    uint32_t sector = (hue & 0xFF) * 6;
+    uint8_t rise = (sector & 0xFF);
+    uint8_t fall = 255 - rise;
+
+    switch(sector >> 8)
+    {
+        case 0:  pixel->red = 255;  pixel->green = rise; pixel->blue = 0;    break;
+        case 1:  pixel->red = fall; pixel->green = 255;  pixel->blue = 0;    break;
+        case 2:  pixel->red = 0;    pixel->green = 255;  pixel->blue = rise; break;
+        case 3:  pixel->red = 0;    pixel->green = fall; pixel->blue = 255;  break;
+        case 4:  pixel->red = rise; pixel->green = 0;    pixel->blue = 255;  break;
+        default: pixel->red = 255;  pixel->green = 0;    pixel->blue = fall; break;
+    }
+}
+
+//------------------------------------------------------//
+//  APP functions                                       //
+//------------------------------------------------------//
+/**
+ * @brief Fades the colour in and out, over period frames
+ * 
+ * @param state led_fade_t
+ */
+void led_effect_fade(void *state, led_pixel_t *pixels, uint32_t len, uint32_t frame)
+{
+    const led_fade_t *fade = state;
+    uint32_t period = fade->period ? fade->period : 1;
+    uint32_t phase = (frame % period) * 510 / period;
+    uint32_t level = (phase > 255) ? (510 - phase) : phase;
+    led_pixel_t pixel = {
+        .green = scale(fade->colour.green, level),
+        .red = scale(fade->colour.red, level),
+        .blue = scale(fade->colour.blue, level),
+    };
+
+    for (uint32_t i = 0; i < len; i++) pixels[i] = pixel;
+}
+
+/**
+ * @brief Spreads a hue wheel over the strip, rotating once every period frames
+ * 
+ * @param state led_rainbow_t
+ */
+void led_effect_rainbow(void *state, led_pixel_t *pixels, uint32_t len, uint32_t frame)
+{
+    const led_rainbow_t *rainbow = state;
+    if(len == 0) return;
+
+    uint32_t period = rainbow->period ? rainbow->period : 1;
+    // hue in 1/65536 of the wheel, the step along the strip keeps the wheel spread evenly
+    uint32_t hue = (uint32_t)(((uint64_t)(frame % period) << 16) / period);
+    uint32_t step = 65536 / len;
+
+    for (uint32_t i = 0; i < len; i++, hue += step) hue_wheel(hue >> 8, &pixels[i]);
+}
+
+/**
+ * @brief Moves length leds of colour along the strip, one led every step frames
+ * 
+ * @param state led_chase_t
+ */
+void led_effect_chase(void *state, led_pixel_t *pixels, uint32_t len, uint32_t frame)
+{
+    const led_chase_t *chase = state;
+    if(len == 0) return;
+
+    uint32_t step = chase->step ? chase->step : 1;
+    uint32_t head = (frame / step) % len;
+    uint32_t length = (chase->length < len) ? chase->length : len;
+
+    memset(pixels, 0, sizeof(led_pixel_t) * len);
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        pixels[(head + len - i) % len] = chase->colour;
+    }
+}
\ No newline at end of file
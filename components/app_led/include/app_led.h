@@ -1,28 +1,80 @@
 #ifndef _APP_LED_H_
 #define _APP_LED_H_
 
+#include <stdatomic.h>
+
 #include "led_strip.h"
 #include "fsm.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "app_timer.h"
+#include "esp_timer.h"
 
 //------------------------------------------------------//
 //  MACRO definitions                                    //
 //------------------------------------------------------//
-/* Max number of leds in a strip */
-#define MAX_STRIP_LEN 7
-
-#define LED_TASK_PERIOD_MS 200
 #define LED_TASK_PRIOR 2
 
+/* FSM tick period, timed events run on the shared timer wheel instead of FSM ticks */
 #define LED_TIMER_PERIOD_MS 1
 
-#define LED_BLINK_PERIOD (250 / LED_TIMER_PERIOD_MS)
+#define LED_BLINK_PERIOD_MS 250
+
+/* Frame cache slot holding the encoded "on" frame */
+#define LED_ON_FRAME_SLOT 0
+
+/* Frames of the update mailbox: the one shown, the latest published and the one being written */
+#define LED_MAILBOX_FRAMES 3
+
+/* Frame the animations are rendered into, after the mailbox ones */
+#define LED_ANIM_FRAME LED_MAILBOX_FRAMES
+
+/* Shortest period esp_timer takes for a periodic timer, it caps the animation frame rate */
+#define LED_ANIM_MIN_PERIOD_US 50
+#define LED_ANIM_MAX_FPS (1000000 / LED_ANIM_MIN_PERIOD_US)
+
+/* Frames of an instance pixel buffer */
+#define LED_PIXEL_FRAMES (LED_MAILBOX_FRAMES + 1)
+
+/* Pixels of the static pixel pool, for the instances that don't bring their own buffers.
+   Each LED takes LED_PIXEL_FRAMES pixels (12 bytes), the default fits 64 LEDs */
+#ifndef APP_LED_POOL_LEN
+#define APP_LED_POOL_LEN (64 * LED_PIXEL_FRAMES)
+#endif
 //------------------------------------------------------//
 //  TYPES DEFINITIONS                                    //
 //------------------------------------------------------//
 
+/**
+ * @brief LED pixel, 3 bytes in the strip wire order (GRB)
+ * 
+ */
+typedef struct
+{
+    uint8_t green;
+    uint8_t red;
+    uint8_t blue;
+} led_pixel_t;
+
+_Static_assert(sizeof(led_pixel_t) == 3, "led_pixel_t must match the GRB wire format");
+
+/**
+ * @brief Colour planes, one array per channel
+ * 
+ * @note For effects touching one channel at a time, a NULL plane is left unchanged
+ */
+typedef struct
+{
+    const uint8_t *red;
+    const uint8_t *green;
+    const uint8_t *blue;
+} led_planes_t;
+
 /**
  * @brief LED colour struct
  * 
+ * @note Kept for compatibility, app_led_update packs it into led_pixel_t. Prefer app_led_update_pixels
  */
 typedef struct
 {
@@ -40,6 +92,93 @@ typedef struct
     } hsv;
 } led_colour_t;
 
+/**
+ * @brief Latency from an event dispatch to the strip refresh it triggers
+ * 
+ */
+typedef struct
+{
+    uint32_t count;     // refreshes measured
+    uint32_t last_us;   // latency of the last one
+    uint32_t max_us;    // worst latency seen
+} led_latency_t;
+
+/**
+ * @brief Update mailbox counters
+ * 
+ */
+typedef struct
+{
+    uint32_t published;     // frames published by the writers
+    uint32_t overwritten;   // frames replaced by a newer one before being shown
+} led_mailbox_stats_t;
+
+/**
+ * @brief Effect render callback, fills a whole frame
+ * 
+ * @param state effect parameters and state
+ * @param pixels frame to fill
+ * @param len number of leds of the strip
+ * @param frame frame number since the animation started, late frames are skipped so it follows the time
+ */
+typedef void (*led_effect_render_t)(void *state, led_pixel_t *pixels, uint32_t len, uint32_t frame);
+
+/**
+ * @brief LED effect
+ * 
+ */
+typedef struct
+{
+    led_effect_render_t render;
+    void *state;
+    uint32_t fps;
+} led_effect_t;
+
+/**
+ * @brief Animation counters
+ * 
+ */
+typedef struct
+{
+    uint32_t frames;            // frames sent
+    uint32_t misses;            // frames skipped because the previous one was late
+    uint32_t errors;            // frames the strip failed to take or to send
+    uint32_t render_us_last;    // effect render only
+    uint32_t render_us_max;
+    uint32_t transmit_us_last;  // copy into the driver and start of the refresh
+    uint32_t transmit_us_max;
+} led_anim_stats_t;
+
+/**
+ * @brief Fade effect state, colour fades in and out over period frames
+ * 
+ */
+typedef struct
+{
+    led_pixel_t colour;
+    uint32_t period;
+} led_fade_t;
+
+/**
+ * @brief Rainbow effect state, a hue wheel spread over the strip rotating once every period frames
+ * 
+ */
+typedef struct
+{
+    uint32_t period;
+} led_rainbow_t;
+
+/**
+ * @brief Chase effect state, length leds of colour moving one led every step frames
+ * 
+ */
+typedef struct
+{
+    led_pixel_t colour;
+    uint32_t length;
+    uint32_t step;
+} led_chase_t;
+
 /**
  * @brief LED instance struct
  * 
@@ -49,25 +188,66 @@ typedef struct
     // led params
     led_strip_handle_t handle;
     led_strip_config_t strip_config;
+#if !CONFIG_IDF_TARGET_LINUX
     led_strip_spi_config_t spi_config;
+#endif
     // fsm 
     fsm_t fsm;
-    //timer
-    TimerHandle_t timer;
-    // 
-    led_colour_t colour[MAX_STRIP_LEN]; 
+    // timed events, on the shared timer wheel
+    app_timer_t timer;
+    // generation of the last timeout, 0 if none waits for the task
+    atomic_uint_least32_t timeout_gen;
+    // task running the fsm, woken by the dispatches
+    TaskHandle_t task;
+    // 0: the task only runs on events, otherwise it also runs every frame_period_ms (animations)
+    uint32_t frame_period_ms;
+    // dispatch to refresh latency, time of the oldest event not shown yet, 0 if none
+    atomic_uint_least32_t dispatch_us;
+    led_latency_t latency;
+    // animation, effect given by app_led_animate and taken when ANIMATING_ST is entered
+    const led_effect_t *next_effect;
+    const led_effect_t *effect;
+    esp_timer_handle_t anim_timer;
+    atomic_uint_least32_t anim_due;
+    uint32_t anim_frame;
+    led_anim_stats_t anim_stats;
+    // LED_PIXEL_FRAMES frames of strip_config.max_leds pixels, given by the caller or taken from the pool by configure_led
+    led_pixel_t *pixels;
+    // pixels in the caller buffer, at least LED_PIXEL_FRAMES * strip_config.max_leds
+    uint32_t pixels_len;
+    // update mailbox, front/ready frame indexes and flags, see app_led.c
+    atomic_uint_least32_t mailbox;
+    atomic_uint_least32_t mailbox_published;
+    atomic_uint_least32_t mailbox_overwritten;
+    // taken by the writers only, and the span of each frame behind the latest one, [from, to)
+    SemaphoreHandle_t mailbox_lock;
+    uint32_t mailbox_stale_from[LED_MAILBOX_FRAMES];
+    uint32_t mailbox_stale_to[LED_MAILBOX_FRAMES];
+    // the "on" frame in the strip cache matches colour
+    bool frame_cached;
 }led_ins_t;
 
 //------------------------------------------------------//
 //  FUNCTIONS                                           //
 //------------------------------------------------------//
 
-void configure_led(led_ins_t *device);
+int  configure_led(led_ins_t *device);
 void led_on(led_ins_t *device);
 void led_off(led_ins_t *device);
 void blink_led(led_ins_t *device);
 void toggle_led(led_ins_t *device);
 int  app_led_run(led_ins_t *device);
 int app_led_update(led_ins_t *device, uint32_t index, led_colour_t *colour, uint32_t len);
+int app_led_update_pixels(led_ins_t *device, uint32_t index, const led_pixel_t *pixels, uint32_t len);
+int app_led_update_planes(led_ins_t *device, uint32_t index, const led_planes_t *planes, uint32_t len);
+int app_led_latency_get(led_ins_t *device, led_latency_t *latency);
+int app_led_mailbox_stats_get(led_ins_t *device, led_mailbox_stats_t *stats);
+int app_led_animate(led_ins_t *device, const led_effect_t *effect);
+int app_led_anim_stats_get(led_ins_t *device, led_anim_stats_t *stats);
+
+// Built-in effects, state is a led_fade_t, led_rainbow_t or led_chase_t
+void led_effect_fade(void *state, led_pixel_t *pixels, uint32_t len, uint32_t frame);
+void led_effect_rainbow(void *state, led_pixel_t *pixels, uint32_t len, uint32_t frame);
+void led_effect_chase(void *state, led_pixel_t *pixels, uint32_t len, uint32_t frame);
 
 #endif // _APP_LED_H_
\ No newline at end of file
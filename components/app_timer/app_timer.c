@@ -0,0 +1,480 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "app_timer.h"
+
+static const char *TAG = "app_timer";
+
+/* Alarm tick while no timer is armed */
+#define WHEEL_IDLE UINT64_MAX
+
+#define SLOT_MASK (APP_TIMER_SLOTS - 1)
+
+/**
+ * @brief Hierarchical timer wheel shared by every timed event
+ * 
+ * Level L holds the timers due within APP_TIMER_SLOTS^(L+1) ticks, in the slot given by bits
+ * [L * APP_TIMER_LEVEL_BITS, (L + 1) * APP_TIMER_LEVEL_BITS) of their expiry tick. When the level
+ * below wraps, the level's current slot is cascaded down. Arming and cancelling only link or
+ * unlink a timer, and a single esp_timer alarm is programmed for the first expiry, the slots to
+ * cascade before it are run by that alarm. Each upper slot keeps the earliest expiry linked into it,
+ * so finding the first expiry takes one look per level whatever the number of timers.
+ */
+typedef struct
+{
+    app_timer_t *slots[APP_TIMER_LEVELS][APP_TIMER_SLOTS];
+    uint64_t occupied[APP_TIMER_LEVELS];    // non empty slots of each level, one bit per slot
+    uint32_t first[APP_TIMER_LEVELS - 1][APP_TIMER_SLOTS];  // earliest expiry linked into each upper slot since it was empty, as an offset into the slot
+    uint64_t now;                           // next tick to run
+    uint64_t alarm;                         // tick the alarm is programmed for, WHEEL_IDLE if none
+    esp_timer_handle_t alarm_timer;
+    SemaphoreHandle_t lock;
+    app_timer_stats_t stats;
+}timer_wheel_t;
+
+static timer_wheel_t wheel;
+
+//------------------------------------------------------//
+//  LOCAL functions                                     //
+//------------------------------------------------------//
+
+static inline uint64_t wheel_clock(void)
+{
+    return (uint64_t)esp_timer_get_time() / APP_TIMER_TICK_US;
+}
+
+/**
+ * @brief Starts a new generation of the timer, so the timeouts of the previous ones are told apart
+ * 
+ * @param timer 
+ */
+static void timer_next_gen(app_timer_t *timer)
+{
+    uint32_t gen = atomic_load(&timer->gen) + 1;
+
+    // 0 is left for "no timeout", so owners can keep it in a single word
+    if(gen == 0) gen = 1;
+
+    atomic_store(&timer->gen, gen);
+}
+
+static inline uint32_t level_shift(uint32_t level)
+{
+    return level * APP_TIMER_LEVEL_BITS;
+}
+
+/**
+ * @brief Links a timer into the slot of its expiry, relative to the wheel position
+ * 
+ * @param w 
+ * @param timer 
+ */
+static void wheel_link(timer_wheel_t *w, app_timer_t *timer)
+{
+    if(timer->expiry < w->now) timer->expiry = w->now;
+
+    uint64_t delta = timer->expiry - w->now;
+    uint32_t level = 0;
+
+    while(level < APP_TIMER_LEVELS - 1 && delta >= (1ULL << level_shift(level + 1))) level++;
+
+    uint32_t slot = (timer->expiry >> level_shift(level)) & SLOT_MASK;
+    app_timer_t **head = &w->slots[level][slot];
+
+    if(level > 0)
+    {
+        // Left as it is on unlink, it's then a bound the timers left are due after
+        uint32_t offset = timer->expiry & ((1ULL << level_shift(level)) - 1);
+        uint32_t *first = &w->first[level - 1][slot];
+
+        if(!(w->occupied[level] & (1ULL << slot)) || offset < *first) *first = offset;
+    }
+
+    timer->level = level;
+    timer->slot = slot;
+    timer->next = *head;
+    if(*head != NULL) (*head)->pprev = &timer->next;
+    timer->pprev = head;
+    *head = timer;
+
+    w->occupied[level] |= 1ULL << slot;
+}
+
+static void wheel_unlink(timer_wheel_t *w, app_timer_t *timer)
+{
+    *timer->pprev = timer->next;
+    if(timer->next != NULL) timer->next->pprev = timer->pprev;
+    timer->pprev = NULL;
+
+    if(w->slots[timer->level][timer->slot] == NULL) w->occupied[timer->level] &= ~(1ULL << timer->slot);
+}
+
+/**
+ * @brief First slot of a level, from the wheel position on, to run or to cascade
+ * 
+ * @param w 
+ * @param level 
+ * @param slot the slot
+ * @return uint64_t tick it's reached, WHEEL_IDLE if the level is empty
+ */
+static uint64_t level_next(timer_wheel_t *w, uint32_t level, uint32_t *slot)
+{
+    uint64_t occupied = w->occupied[level];
+    if(occupied == 0) return WHEEL_IDLE;
+
+    uint32_t shift = level_shift(level);
+    uint64_t base = w->now & ~((1ULL << (shift + APP_TIMER_LEVEL_BITS)) - 1);
+    uint32_t cur = (w->now >> shift) & SLOT_MASK;
+
+    // The current slot was already cascaded unless the level below is wrapping right now
+    if(w->now & ((1ULL << shift) - 1)) cur++;
+
+    uint64_t ahead = cur < APP_TIMER_SLOTS ? occupied & (~0ULL << cur) : 0;
+
+    if(ahead)
+    {
+        *slot = __builtin_ctzll(ahead);
+        return base + ((uint64_t)*slot << shift);
+    }
+
+    *slot = __builtin_ctzll(occupied);
+    return base + (1ULL << (shift + APP_TIMER_LEVEL_BITS)) + ((uint64_t)*slot << shift);
+}
+
+/**
+ * @brief First tick, from the wheel position on, with a slot to run or to cascade
+ * 
+ * @param w 
+ * @return uint64_t WHEEL_IDLE if no timer is armed
+ */
+static uint64_t wheel_next(timer_wheel_t *w)
+{
+    uint64_t next = WHEEL_IDLE;
+    uint32_t slot;
+
+    for (uint32_t level = 0; level < APP_TIMER_LEVELS; level++)
+    {
+        uint64_t due = level_next(w, level, &slot);
+
+        if(due < next) next = due;
+    }
+
+    return next;
+}
+
+/**
+ * @brief First expiry of the armed timers
+ * 
+ * The first slot of each level holds the first timers of that level, they are due from the earliest
+ * expiry kept for the slot on. The slots cascaded on the way run with the alarm of that expiry, they
+ * take no wakeup of their own. Once the earliest timer of an upper slot is unlinked, the alarm may go
+ * off before the timers left are due, it then cascades the slot and the expiries are exact again.
+ * 
+ * @param w 
+ * @return uint64_t WHEEL_IDLE if no timer is armed
+ */
+static uint64_t wheel_due(timer_wheel_t *w)
+{
+    uint64_t due = WHEEL_IDLE;
+    uint32_t slot;
+
+    for (uint32_t level = 0; level < APP_TIMER_LEVELS; level++)
+    {
+        uint64_t next = level_next(w, level, &slot);
+
+        if(next == WHEEL_IDLE) continue;
+
+        if(level > 0) next += w->first[level - 1][slot];
+
+        if(next < due) due = next;
+    }
+
+    return due;
+}
+
+/**
+ * @brief Moves the timers of the slots wrapping at the current tick down a level
+ * 
+ * @param w 
+ */
+static void wheel_cascade(timer_wheel_t *w)
+{
+    for (uint32_t level = 1; level < APP_TIMER_LEVELS; level++)
+    {
+        if(w->now & ((1ULL << level_shift(level)) - 1)) break;
+
+        uint32_t slot = (w->now >> level_shift(level)) & SLOT_MASK;
+        app_timer_t *timer = w->slots[level][slot];
+
+        w->slots[level][slot] = NULL;
+        w->occupied[level] &= ~(1ULL << slot);
+
+        while(timer != NULL)
+        {
+            app_timer_t *next = timer->next;
+
+            wheel_link(w, timer);
+            w->stats.cascaded++;
+            timer = next;
+        }
+    }
+}
+
+/**
+ * @brief Runs every tick with work up to the target tick, the lock must be held
+ * 
+ * The callbacks run without the lock, so they can arm and cancel timers.
+ * 
+ * @param w 
+ * @param target 
+ */
+static void wheel_run(timer_wheel_t *w, uint64_t target)
+{
+    for(;;)
+    {
+        uint64_t next = wheel_next(w);
+
+        if(next > target)
+        {
+            // Nothing to do on the ticks up to the target, skip them
+            if(target + 1 > w->now) w->now = target + 1;
+            return;
+        }
+
+        w->now = next;
+        wheel_cascade(w);
+
+        app_timer_t **head = &w->slots[0][w->now & SLOT_MASK];
+
+        while(*head != NULL)
+        {
+            app_timer_t *timer = *head;
+            uint32_t gen = atomic_load(&timer->gen);
+
+            wheel_unlink(w, timer);
+            w->stats.armed--;
+            w->stats.fired++;
+
+            xSemaphoreGive(w->lock);
+            timer->cb(timer->arg, gen);
+            xSemaphoreTake(w->lock, portMAX_DELAY);
+        }
+
+        w->now++;
+    }
+}
+
+/**
+ * @brief Programs the alarm for the first expiry, the lock must be held
+ * 
+ * @param w 
+ */
+static void wheel_schedule(timer_wheel_t *w)
+{
+    uint64_t next = wheel_due(w);
+
+    if(next == w->alarm) return;
+
+    esp_timer_stop(w->alarm_timer);
+    w->alarm = next;
+
+    if(next == WHEEL_IDLE) return;
+
+    int64_t delay_us = (int64_t)(next * APP_TIMER_TICK_US) - esp_timer_get_time();
+
+    esp_timer_start_once(w->alarm_timer, delay_us > 0 ? delay_us : 0);
+}
+
+static void wheel_alarm_cb(void *arg)
+{
+    timer_wheel_t *w = arg;
+
+    xSemaphoreTake(w->lock, portMAX_DELAY);
+
+    w->stats.alarms++;
+    w->alarm = WHEEL_IDLE;
+
+    wheel_run(w, wheel_clock());
+    wheel_schedule(w);
+
+    xSemaphoreGive(w->lock);
+}
+
+/**
+ * @brief Creates the wheel lock and alarm on first use
+ * 
+ * @return int
+ */
+static int wheel_start(timer_wheel_t *w)
+{
+    if(w->lock != NULL) return 0;
+
+    w->lock = xSemaphoreCreateMutex();
+    if(w->lock == NULL) return -2;
+
+    const esp_timer_create_args_t alarm_args = {
+        .callback = wheel_alarm_cb,
+        .arg = w,
+        .name = "app_timer",
+    };
+
+    if(esp_timer_create(&alarm_args, &w->alarm_timer) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to create the wheel alarm");
+        vSemaphoreDelete(w->lock);
+        w->lock = NULL;
+        return -2;
+    }
+
+    w->now = wheel_clock();
+    w->alarm = WHEEL_IDLE;
+
+    ESP_LOGI(TAG, "Timer wheel started, %d levels of %d slots, %d us ticks", APP_TIMER_LEVELS, APP_TIMER_SLOTS, APP_TIMER_TICK_US);
+
+    return 0;
+}
+
+//------------------------------------------------------//
+//  APP functions                                       //
+//------------------------------------------------------//
+
+/**
+ * @brief Registers a timed event with the shared timer wheel, starting the wheel on first use
+ * 
+ * Call it while configuring the instance, before its tasks run.
+ * 
+ * @param timer 
+ * @param cb 
+ * @param arg 
+ * @return int
+ */
+int app_timer_init(app_timer_t *timer, app_timer_cb_t cb, void *arg)
+{
+    if(timer == NULL || cb == NULL) return -1;
+
+    if(wheel_start(&wheel) != 0) return -2;
+
+    memset(timer, 0, sizeof(app_timer_t));
+    atomic_init(&timer->gen, 1);
+    timer->cb = cb;
+    timer->arg = arg;
+
+    return 0;
+}
+
+/**
+ * @brief Arms the timer, or re-arms it if it was already armed
+ * 
+ * Starts a new generation, a timeout of a previous arm already being run is no longer current.
+ * 
+ * @param timer 
+ * @param timeout_ms 
+ * @return int
+ */
+int app_timer_arm(app_timer_t *timer, uint32_t timeout_ms)
+{
+    if(timer == NULL || timer->cb == NULL || wheel.lock == NULL) return -1;
+
+    uint64_t ticks = ((uint64_t)timeout_ms * 1000 + APP_TIMER_TICK_US - 1) / APP_TIMER_TICK_US;
+
+    if(ticks == 0) ticks = 1;
+    if(ticks > APP_TIMER_MAX_TICKS) ticks = APP_TIMER_MAX_TICKS;
+
+    xSemaphoreTake(wheel.lock, portMAX_DELAY);
+
+    uint64_t clock = wheel_clock();
+
+    // Idle wheel: move it to the present so the timer lands on the lowest level that fits
+    if(clock > wheel.now && wheel_next(&wheel) > clock) wheel.now = clock;
+
+    if(timer->pprev != NULL) wheel_unlink(&wheel, timer);
+    else wheel.stats.armed++;
+
+    timer_next_gen(timer);
+    // The clock is already part way through its tick, one more keeps the timeout from firing early
+    timer->expiry = clock + ticks + 1;
+    wheel_link(&wheel, timer);
+
+    if(timer->expiry < wheel.alarm) wheel_schedule(&wheel);
+
+    xSemaphoreGive(wheel.lock);
+
+    return 0;
+}
+
+/**
+ * @brief Disarms the timer
+ * 
+ * The alarm is left as it is, it finds nothing to run if this timer was the next one, unless no timer is left.
+ * A timeout already being run when the timer is cancelled still completes, but it is no longer current.
+ * 
+ * @param timer 
+ * @return int
+ */
+int app_timer_cancel(app_timer_t *timer)
+{
+    if(timer == NULL || wheel.lock == NULL) return -1;
+
+    xSemaphoreTake(wheel.lock, portMAX_DELAY);
+
+    if(timer->pprev != NULL)
+    {
+        wheel_unlink(&wheel, timer);
+        wheel.stats.armed--;
+
+        // An idle wheel takes no wakeups
+        if(wheel.stats.armed == 0 && wheel.alarm != WHEEL_IDLE)
+        {
+            esp_timer_stop(wheel.alarm_timer);
+            wheel.alarm = WHEEL_IDLE;
+        }
+    }
+
+    // Even when not linked, its timeout may be running right now
+    timer_next_gen(timer);
+
+    xSemaphoreGive(wheel.lock);
+
+    return 0;
+}
+
+bool app_timer_is_armed(const app_timer_t *timer)
+{
+    return timer != NULL && timer->pprev != NULL;
+}
+
+/**
+ * @brief Checks that a timeout belongs to the last arm, with no arm or cancel since
+ * 
+ * @param timer 
+ * @param gen generation passed to the callback
+ * @return true if the timeout should be handled, false if it's stale
+ */
+bool app_timer_is_current(app_timer_t *timer, uint32_t gen)
+{
+    return timer != NULL && gen != 0 && atomic_load(&timer->gen) == gen;
+}
+
+/**
+ * @brief Gets the timer wheel statistics
+ * 
+ * @param stats 
+ */
+void app_timer_stats_get(app_timer_stats_t *stats)
+{
+    if(stats == NULL) return;
+
+    if(wheel.lock == NULL)
+    {
+        memset(stats, 0, sizeof(app_timer_stats_t));
+        return;
+    }
+
+    xSemaphoreTake(wheel.lock, portMAX_DELAY);
+    *stats = wheel.stats;
+    xSemaphoreGive(wheel.lock);
+}
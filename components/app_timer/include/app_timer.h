@@ -0,0 +1,76 @@
+#ifndef _APP_TIMER_H_
+#define _APP_TIMER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+//------------------------------------------------------//
+//  MACRO definitions                                    //
+//------------------------------------------------------//
+/* Wheel resolution, timeouts fire within one tick after they are due, never before */
+#define APP_TIMER_TICK_US 1000
+
+/* Slots of a wheel level, as a power of two */
+#define APP_TIMER_LEVEL_BITS 6
+#define APP_TIMER_SLOTS (1 << APP_TIMER_LEVEL_BITS)
+
+/* Wheel levels, each one APP_TIMER_SLOTS times coarser than the one below */
+#define APP_TIMER_LEVELS 4
+
+/* Longest timeout, longer ones are clamped to it (~4.6 h with 1 ms ticks) */
+#define APP_TIMER_MAX_TICKS ((1ULL << (APP_TIMER_LEVEL_BITS * APP_TIMER_LEVELS)) - 1)
+
+//------------------------------------------------------//
+//  TYPES DEFINITIONS                                    //
+//------------------------------------------------------//
+
+/**
+ * @brief Timeout callback, runs from the esp_timer task
+ * 
+ * gen is the generation of the arm that timed out. The timer may be armed again or cancelled
+ * before the owner gets to handle the timeout, check it with app_timer_is_current() first.
+ */
+typedef void (*app_timer_cb_t)(void *arg, uint32_t gen);
+
+/**
+ * @brief Timed event registered with the shared timer wheel
+ * 
+ * Embedded in the instance that owns it, the wheel links it into its slots so it takes no extra memory.
+ */
+typedef struct app_timer_t
+{
+    struct app_timer_t *next;   // next timer in the slot
+    struct app_timer_t **pprev; // link pointing to this timer, NULL when not armed
+    uint64_t expiry;            // wheel tick it's due
+    uint8_t level;              // wheel slot holding it
+    uint8_t slot;
+    atomic_uint_least32_t gen;  // bumped by every arm and cancel, never 0
+    app_timer_cb_t cb;
+    void *arg;
+}app_timer_t;
+
+/**
+ * @brief Shared timer wheel statistics
+ * 
+ */
+typedef struct
+{
+    uint32_t armed;     // timers armed right now
+    uint32_t fired;     // timeouts run
+    uint32_t alarms;    // wakeups of the underlying esp_timer
+    uint32_t cascaded;  // timers moved down a level
+}app_timer_stats_t;
+
+//------------------------------------------------------//
+//  FUNCTIONS                                           //
+//------------------------------------------------------//
+
+int app_timer_init(app_timer_t *timer, app_timer_cb_t cb, void *arg);
+int app_timer_arm(app_timer_t *timer, uint32_t timeout_ms);
+int app_timer_cancel(app_timer_t *timer);
+bool app_timer_is_armed(const app_timer_t *timer);
+bool app_timer_is_current(app_timer_t *timer, uint32_t gen);
+void app_timer_stats_get(app_timer_stats_t *stats);
+
+#endif // _APP_TIMER_H_
@@ -0,0 +1,143 @@
+/*
+ * Button task wakeups over fixed windows of a virtual clock: none while the button is left alone, and only
+ * the edges and the timeouts of a short press, a long press and a bounce, against the 10 ms poll it used to run
+ */
+#include <stdio.h>
+
+#include "app_btn.c"
+#include "esp_timer.h"
+#include "virtual_timer.h"
+
+#define WINDOW_US 10000000
+#define OLD_POLL_MS 10
+
+// The button FSM, run by the harness in place of the fsm library
+static int state = IDLE_ST;
+
+int fsm_dispatch(fsm_t *fsm, int ev, void *data)
+{
+    bool pressed = state == WAIT_ST || state == L_PRESS_ST;
+    if (ev == PRESS_EV && state == IDLE_ST) {
+        state = WAIT_ST;
+        enter_wait(fsm, data);
+    } else if (ev == FSM_TIMEOUT_EV && state == WAIT_ST) {
+        exit_timed(fsm, data);
+        state = S_PRESS_ST;
+        enter_press(fsm, data);
+    } else if (ev == FSM_TIMEOUT_EV && state == S_PRESS_ST) {
+        exit_timed(fsm, data);
+        state = L_PRESS_ST;
+        enter_long_press(fsm, data);
+    } else if (ev == UNPRESS_EV && pressed) {
+        if (state == WAIT_ST) {
+            exit_timed(fsm, data);
+        }
+        exit_press(fsm, data);
+        state = IDLE_ST;
+    } else if (ev == UNPRESS_EV && state == S_PRESS_ST) {
+        exit_timed(fsm, data);
+        state = S_UNPRESS_ST;
+        enter_unpress(fsm, data);
+    } else if (ev == READY_EV && state == S_UNPRESS_ST) {
+        exit_press(fsm, data);
+        state = IDLE_ST;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// The task and the GPIO, the task runs the fsm once per notification
+static uint32_t notified, wakeups;
+static int level = 1;
+static btn_evt_t events[8];
+static int event_num;
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    notified++;
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken)
+{
+    notified++;
+    *woken = pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    if (event_num < 8) {
+        events[event_num++] = *(const btn_evt_t *)item;
+    }
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    return pdFALSE;
+}
+
+int gpio_get_level(int gpio)
+{
+    return level;
+}
+
+int fsm_actor_link(fsm_t *fsm, struct fsm_actor_t *actor, int actor_len)
+{
+    return 0;
+}
+
+/**
+ * @brief Task wakeups over a window, each press given as {time it starts, time it is held} in ms
+ */
+static uint32_t window_wakeups(btn_ins_t *btn, const uint32_t (*presses)[2], int press_num)
+{
+    uint32_t before = wakeups;
+    int64_t start = esp_timer_get_time();
+    for (uint32_t ms = 0; ms < WINDOW_US / 1000; ms++) {
+        virtual_timer_run_until(start + (ms + 1) * 1000LL);
+        for (int p = 0; p < press_num; p++) {
+            if (ms == presses[p][0] || ms == presses[p][0] + presses[p][1]) {
+                level = ms == presses[p][0] ? 0 : 1;
+                gpio_isr_handler(btn);
+            }
+        }
+        while (notified > 0) {
+            notified--;
+            wakeups++;
+            btn_run(btn);
+        }
+    }
+    return wakeups - before;
+}
+
+int main(void)
+{
+    static btn_ins_t btn;
+    if (btn_configure(&btn, 4) != 0) {
+        printf("FAIL: configure\n");
+        return 1;
+    }
+    // a handle for the notifications, the harness runs the task itself
+    btn.task = (TaskHandle_t)&btn;
+
+    uint32_t idle = window_wakeups(&btn, NULL, 0);
+    // a short press, a long press, and a bounce shorter than the anti-bounce time
+    const uint32_t presses[][2] = {{1000, 200}, {3000, 1000}, {6000, 5}};
+    uint32_t pressed = window_wakeups(&btn, presses, 3);
+    uint32_t idle_again = window_wakeups(&btn, NULL, 0);
+
+    double seconds = WINDOW_US / 1e6;
+    printf("button task wakeups over %.0f s windows:\n", seconds);
+    printf("  idle:           %u (%.1f/s)\n", idle, idle / seconds);
+    printf("  3 presses:      %u (%.1f/s), events %d %d %d\n", pressed, pressed / seconds, events[0], events[1], events[2]);
+    printf("  idle again:     %u (%.1f/s)\n", idle_again, idle_again / seconds);
+    printf("before, the %d ms poll: %.0f/s in every state\n", OLD_POLL_MS, 1000.0 / OLD_POLL_MS);
+    // short press: 2 edges, the anti-bounce timeout and the READY_EV run; long press: 2 edges and 2 timeouts;
+    // bounce: 2 edges, the anti-bounce timer is cancelled
+    bool events_ok = event_num == 3 && events[0] == PRESSED_EV && events[1] == LONG_PRESS_EV && events[2] == BOUNCE_EV;
+    int failed = idle != 0 || idle_again != 0 || pressed != 10 || !events_ok || state != IDLE_ST;
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed;
+}
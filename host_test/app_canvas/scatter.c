@@ -0,0 +1,136 @@
+/*
+ * Canvas over capture strips: the run table merges the segments that follow each other on a strip, a gap
+ * takes canvas pixels that go nowhere, a reversed segment runs backwards on its strip, a canvas split over
+ * two strips sends each its part, and a segment that doesn't fit in its strip is refused by app_canvas_init
+ */
+#include <stdio.h>
+
+#include "app_canvas.c"
+#include "led_strip_capture.h"
+
+#define STRIP_A_LEDS 10
+#define STRIP_B_LEDS 6
+
+static led_strip_handle_t new_strip(uint32_t leds)
+{
+    led_strip_config_t config = { .max_leds = leds, .led_pixel_format = LED_PIXEL_FORMAT_GRB };
+    led_strip_capture_config_t capture_config = { .frame_num = 1 };
+    led_strip_handle_t strip = NULL;
+    led_strip_new_capture_device(&config, &capture_config, &strip);
+    return strip;
+}
+
+// every canvas pixel gets its own colour, red is its index
+static void paint(canvas_t *canvas)
+{
+    for (uint32_t i = 0; i < canvas->len; i++) {
+        app_canvas_set_pixel(canvas, i, i, 100 + i, 200);
+    }
+}
+
+/**
+ * @brief Checks that a strip pixel shows a canvas pixel, in the wire order
+ */
+static bool shows(led_strip_handle_t strip, uint32_t strip_index, uint32_t canvas_index)
+{
+    led_strip_capture_frame_t frame;
+    if (led_strip_capture_get_frame(strip, 0, &frame) != ESP_OK || strip_index >= frame.len) {
+        return false;
+    }
+    const uint8_t *pixel = &frame.pixels[strip_index * 3];
+    return pixel[0] == 100 + canvas_index && pixel[1] == canvas_index && pixel[2] == 200;
+}
+
+static bool is_black(led_strip_handle_t strip, uint32_t strip_index)
+{
+    led_strip_capture_frame_t frame;
+    if (led_strip_capture_get_frame(strip, 0, &frame) != ESP_OK || strip_index >= frame.len) {
+        return false;
+    }
+    const uint8_t *pixel = &frame.pixels[strip_index * 3];
+    return pixel[0] == 0 && pixel[1] == 0 && pixel[2] == 0;
+}
+
+int main(void)
+{
+    int failed = 0;
+    led_strip_handle_t a = new_strip(STRIP_A_LEDS);
+    led_strip_handle_t b = new_strip(STRIP_B_LEDS);
+    canvas_t canvas;
+
+    // two forward segments end to end on a, then two reversed ones, the second one before the first on a
+    const canvas_segment_t merged[] = {
+        { .handle = a, .strip_start = 0, .len = 3 },
+        { .handle = a, .strip_start = 3, .len = 2 },
+        { .handle = a, .strip_start = 7, .len = 3, .reversed = true },
+        { .handle = a, .strip_start = 5, .len = 2, .reversed = true },
+    };
+    app_canvas_init(&canvas, merged, 4);
+    paint(&canvas);
+    app_canvas_show(&canvas);
+    bool merged_ok = canvas.run_num == 2 && canvas.handle_num == 1 && canvas.len == 10;
+    for (uint32_t i = 0; i < 5; i++) {
+        merged_ok &= shows(a, i, i);
+    }
+    // canvas 5..9 runs from the end of a backwards
+    for (uint32_t i = 5; i < 10; i++) {
+        merged_ok &= shows(a, 14 - i, i);
+    }
+    printf("4 segments: %u runs, strip a %s\n", canvas.run_num, merged_ok ? "correct" : "WRONG");
+    failed |= !merged_ok;
+    app_canvas_deinit(&canvas);
+    led_strip_clear(a);
+
+    // a gap of 3 canvas pixels between two segments that aren't contiguous on the canvas any more
+    const canvas_segment_t gap[] = {
+        { .handle = a, .strip_start = 0, .len = 2 },
+        { .handle = NULL, .len = 3 },
+        { .handle = a, .strip_start = 2, .len = 2 },
+    };
+    app_canvas_init(&canvas, gap, 3);
+    paint(&canvas);
+    app_canvas_show(&canvas);
+    bool gap_ok = canvas.run_num == 2 && canvas.len == 7 && shows(a, 0, 0) && shows(a, 1, 1) && shows(a, 2, 5) &&
+                  shows(a, 3, 6) && is_black(a, 4);
+    printf("gap: %u runs over a %u pixel canvas, strip a %s\n", canvas.run_num, canvas.len, gap_ok ? "correct" : "WRONG");
+    failed |= !gap_ok;
+    app_canvas_deinit(&canvas);
+    led_strip_clear(a);
+
+    // one canvas over both strips, b reversed and placed part way along its strip
+    const canvas_segment_t split[] = {
+        { .handle = a, .strip_start = 4, .len = 6 },
+        { .handle = b, .strip_start = 1, .len = 4, .reversed = true },
+    };
+    app_canvas_init(&canvas, split, 2);
+    paint(&canvas);
+    app_canvas_show(&canvas);
+    bool split_ok = canvas.run_num == 2 && canvas.handle_num == 2 && is_black(a, 3) && is_black(b, 0) && is_black(b, 5);
+    for (uint32_t i = 0; i < 6; i++) {
+        split_ok &= shows(a, 4 + i, i);
+    }
+    for (uint32_t i = 6; i < 10; i++) {
+        split_ok &= shows(b, 4 - (i - 6), i);
+    }
+    printf("split over 2 strips: %u runs, %s\n", canvas.run_num, split_ok ? "correct" : "WRONG");
+    failed |= !split_ok;
+    app_canvas_deinit(&canvas);
+
+    // segments running past the end of their strip, or starting after it
+    const canvas_segment_t too_long[] = {
+        { .handle = a, .strip_start = 0, .len = 4 },
+        { .handle = b, .strip_start = 3, .len = 4 },
+    };
+    const canvas_segment_t past_end[] = {
+        { .handle = b, .strip_start = STRIP_B_LEDS + 1, .len = 1 },
+    };
+    int too_long_ret = app_canvas_init(&canvas, too_long, 2);
+    int past_end_ret = app_canvas_init(&canvas, past_end, 1);
+    printf("segment out of its strip: init returns %d and %d\n", too_long_ret, past_end_ret);
+    failed |= too_long_ret != -3 || past_end_ret != -3;
+
+    led_strip_del(a);
+    led_strip_del(b);
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed;
+}
@@ -0,0 +1,178 @@
+/*
+ * Animation effects: the time each built-in effect takes to render a 1024 pixel frame, what they render,
+ * that they leave an empty strip alone, that a late animation frame skips the frames it missed, and that
+ * the animation keeps to the strip's frame rate, counts the frames it fails to send and only starts from on
+ */
+#include <stdio.h>
+#include <time.h>
+
+#define APP_LED_POOL_LEN (1024 * LED_PIXEL_FRAMES)
+#include "app_led.c"
+#include "led_strip_capture.h"
+
+#define LEDS 1024
+#define ROUNDS 10000
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static bool pixel_is(led_pixel_t pixel, uint8_t red, uint8_t green, uint8_t blue)
+{
+    return pixel.red == red && pixel.green == green && pixel.blue == blue;
+}
+
+// a third of the hue wheel falls between two of its 256 steps, and one step moves a channel by 6
+static bool pixel_near(led_pixel_t pixel, uint8_t red, uint8_t green, uint8_t blue)
+{
+    return abs(pixel.red - red) <= 6 && abs(pixel.green - green) <= 6 && abs(pixel.blue - blue) <= 6;
+}
+
+// The led FSM state seen by app_led_animate, and the period the animation timer is started with
+static int state = OFF_ST;
+static uint64_t timer_period_us;
+
+int fsm_state_get(fsm_t *fsm)
+{
+    return state;
+}
+
+// No led task runs here, its wakeups go nowhere
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    return pdPASS;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t us)
+{
+    timer_period_us = us;
+    return ESP_OK;
+}
+
+// Effect recording the frame numbers it is given, it writes the number into the first pixel
+static uint32_t frames_given[4];
+static uint32_t renders;
+
+static void record_effect(void *state, led_pixel_t *pixels, uint32_t len, uint32_t frame)
+{
+    frames_given[renders++ % 4] = frame;
+    memset(pixels, 0, sizeof(led_pixel_t) * len);
+    pixels[0].red = frame;
+}
+
+int main(void)
+{
+    int failed = 0;
+    static led_pixel_t pixels[LEDS];
+    led_fade_t fade = { .colour = { .red = 200, .green = 100, .blue = 50 }, .period = 120 };
+    led_rainbow_t rainbow = { .period = 300 };
+    led_chase_t chase = { .colour = { .red = 255 }, .length = 5, .step = 2 };
+    const struct {
+        const char *name;
+        led_effect_render_t render;
+        void *state;
+    } effects[] = {
+        { "fade", led_effect_fade, &fade },
+        { "rainbow", led_effect_rainbow, &rainbow },
+        { "chase", led_effect_chase, &chase },
+    };
+
+    printf("%d LEDs, render time per frame:\n", LEDS);
+    for (size_t e = 0; e < sizeof(effects) / sizeof(effects[0]); e++) {
+        double t = now_ns();
+        for (uint32_t frame = 0; frame < ROUNDS; frame++) {
+            effects[e].render(effects[e].state, pixels, LEDS, frame);
+            __asm__ volatile("" ::: "memory");
+        }
+        printf("  %-8s %.2f us\n", effects[e].name, (now_ns() - t) / ROUNDS / 1000);
+    }
+
+    // fade: dark at the start of the period, full colour half way
+    led_effect_fade(&fade, pixels, 4, 0);
+    bool fade_ok = pixel_is(pixels[3], 0, 0, 0);
+    led_effect_fade(&fade, pixels, 4, 60);
+    fade_ok &= pixel_is(pixels[0], 200, 100, 50) && pixel_is(pixels[3], 200, 100, 50);
+
+    // rainbow: red, green and blue a third of the strip apart, rotated by a third of the period
+    led_effect_rainbow(&rainbow, pixels, 6, 0);
+    bool rainbow_ok = pixel_is(pixels[0], 255, 0, 0) && pixel_near(pixels[2], 0, 255, 0) && pixel_near(pixels[4], 0, 0, 255);
+    led_effect_rainbow(&rainbow, pixels, 6, 100);
+    rainbow_ok &= pixel_near(pixels[0], 0, 255, 0);
+
+    // chase: at frame 6 the head is on led 3 and the tail wraps around the end
+    led_effect_chase(&chase, pixels, 8, 6);
+    bool chase_ok = true;
+    for (int i = 0; i < 8; i++) {
+        bool lit = i <= 3 || i == 7;
+        chase_ok &= pixels[i].red == (lit ? 255 : 0);
+    }
+    printf("frames rendered: fade %s, rainbow %s, chase %s\n", fade_ok ? "correct" : "WRONG",
+           rainbow_ok ? "correct" : "WRONG", chase_ok ? "correct" : "WRONG");
+    failed |= !fade_ok || !rainbow_ok || !chase_ok;
+
+    // an empty strip is left alone, it used to divide by zero
+    for (size_t e = 0; e < sizeof(effects) / sizeof(effects[0]); e++) {
+        effects[e].render(effects[e].state, NULL, 0, 7);
+    }
+    printf("empty strip: no frame touched\n");
+
+    // a frame sent two periods late skips the two it missed
+    led_ins_t led = { .strip_config = { .max_leds = LEDS } };
+    if (configure_led(&led) != 0) {
+        printf("FAIL: configure\n");
+        return 1;
+    }
+    led_strip_capture_config_t capture_config = { .frame_num = 1 };
+    led_strip_new_capture_device(&led.strip_config, &capture_config, &led.handle);
+    led_effect_t effect = { .render = record_effect, .fps = 100 };
+    led.effect = &effect;
+    animate_frame(&led, 1);
+    animate_frame(&led, 3);
+    animate_frame(&led, 1);
+    led_anim_stats_t stats;
+    app_led_anim_stats_get(&led, &stats);
+    led_strip_capture_frame_t frame;
+    led_strip_capture_get_frame(led.handle, 0, &frame);
+    bool late_ok = frames_given[0] == 0 && frames_given[1] == 3 && frames_given[2] == 4 && stats.frames == 3 &&
+                   stats.misses == 2 && frame.len == LEDS && frame.pixels[1] == 4;
+    printf("late frame: frames given %u %u %u, %u sent, %u missed, %s\n", frames_given[0], frames_given[1],
+           frames_given[2], stats.frames, stats.misses, late_ok ? "correct" : "WRONG");
+    failed |= !late_ok;
+    led_strip_del(led.handle);
+
+    // a strip shorter than the frame refuses it, the frame is counted as an error and not as sent
+    led_strip_config_t short_config = { .max_leds = LEDS / 2 };
+    led_strip_new_capture_device(&short_config, &capture_config, &led.handle);
+    animate_frame(&led, 1);
+    app_led_anim_stats_get(&led, &stats);
+    bool errors_ok = stats.errors == 1 && stats.frames == 3;
+    printf("frame refused by the strip: %u errors, %u sent, %s\n", stats.errors, stats.frames, errors_ok ? "correct" : "WRONG");
+    failed |= !errors_ok;
+    led_strip_del(led.handle);
+
+    // 1024 LEDs at 1.25 us a bit and a 280 us reset take 31 ms a frame, 100 fps are brought down to the strip's 32
+    capture_config = (led_strip_capture_config_t) { .frame_num = 1, .bit_period_ns = 1250, .reset_us = 280 };
+    led_strip_new_capture_device(&led.strip_config, &capture_config, &led.handle);
+    uint32_t max_fps = 0;
+    led_strip_get_max_fps(led.handle, &max_fps);
+    led.next_effect = &effect;
+    enter_animating(&led.fsm, &led);
+    bool clamp_ok = max_fps != 0 && timer_period_us == 1000000 / max_fps;
+    printf("%u fps effect on a %u fps strip: a frame every %llu us, %s\n", effect.fps, max_fps,
+           (unsigned long long)timer_period_us, clamp_ok ? "correct" : "WRONG");
+    failed |= !clamp_ok;
+    led_strip_del(led.handle);
+
+    // an animation only starts from the fixed colours
+    int off_ret = app_led_animate(&led, &effect);
+    state = ON_FIX_ST;
+    int on_ret = app_led_animate(&led, &effect);
+    printf("animate from off: %d, from on: %d\n", off_ret, on_ret);
+    failed |= off_ret == 0 || on_ret != 0;
+
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed;
+}
@@ -0,0 +1,96 @@
+/*
+ * Timed events on the shared timer wheel: the wakeups of its alarm over fixed windows of a virtual clock,
+ * with the led off, blinking and off again, against the 1 ms auto-reload tick every instance used to run
+ */
+#include <stdio.h>
+
+#include "app_led.c"
+#include "led_strip_capture.h"
+#include "virtual_timer.h"
+
+#define LEDS 8
+#define WINDOW_US 10000000
+
+// The blink part of the led FSM, run by the harness in place of the fsm library
+static int state = OFF_ST;
+static uint32_t phases;
+
+int fsm_state_get(fsm_t *fsm)
+{
+    return state;
+}
+
+int fsm_dispatch(fsm_t *fsm, int ev, void *data)
+{
+    bool blinking = state == BLINK_ON_ST || state == BLINK_OFF_ST;
+    if (ev == BLINK_EV && state == OFF_ST) {
+        state = BLINK_ON_ST;
+        enter_blink_on(fsm, data);
+    } else if (ev == FSM_TIMEOUT_EV && blinking) {
+        exit_blink(fsm, data);
+        state = state == BLINK_ON_ST ? BLINK_OFF_ST : BLINK_ON_ST;
+        state == BLINK_ON_ST ? enter_blink_on(fsm, data) : enter_blink_off(fsm, data);
+    } else if (ev == OFF_EV && blinking) {
+        exit_blink(fsm, data);
+        state = OFF_ST;
+        enter_off(fsm, data);
+    } else {
+        return -1;
+    }
+    phases++;
+    return 0;
+}
+
+/**
+ * @brief Alarms of the wheel over a window, the led task running every millisecond
+ */
+static uint32_t window_alarms(led_ins_t *led)
+{
+    app_timer_stats_t before, after;
+    app_timer_stats_get(&before);
+    int64_t end = esp_timer_get_time() + WINDOW_US;
+    while (esp_timer_get_time() < end) {
+        virtual_timer_run_until(esp_timer_get_time() + 1000);
+        app_led_run(led);
+    }
+    app_timer_stats_get(&after);
+    return after.alarms - before.alarms;
+}
+
+int main(void)
+{
+    int failed = 0;
+    led_ins_t led = { .strip_config = { .max_leds = LEDS } };
+    if (configure_led(&led) != 0) {
+        printf("FAIL: configure\n");
+        return 1;
+    }
+    led_strip_capture_config_t capture_config = { .frame_num = 1 };
+    led_strip_new_capture_device(&led.strip_config, &capture_config, &led.handle);
+
+    uint32_t off_alarms = window_alarms(&led);
+
+    blink_led(&led);
+    phases = 0;
+    uint32_t blink_alarms = window_alarms(&led);
+    uint32_t blink_phases = phases;
+
+    led_off(&led);
+    uint32_t off_again_alarms = window_alarms(&led);
+
+    double seconds = WINDOW_US / 1e6;
+    printf("wheel alarms over %.0f s windows, one led:\n", seconds);
+    printf("  off:            %u (%.1f/s)\n", off_alarms, off_alarms / seconds);
+    printf("  blinking:       %u (%.1f/s), %u phases of %d ms\n", blink_alarms, blink_alarms / seconds, blink_phases,
+           LED_BLINK_PERIOD_MS);
+    printf("  off again:      %u (%.1f/s)\n", off_again_alarms, off_again_alarms / seconds);
+    printf("before, the %d ms auto-reload tick: %.0f/s in every state\n", LED_TIMER_PERIOD_MS, 1000.0 / LED_TIMER_PERIOD_MS);
+    // one wakeup per blink phase, a phase lasts up to a tick longer than its period, none without a timed state
+    uint32_t min_phases = WINDOW_US / 1000 / (LED_BLINK_PERIOD_MS + 1);
+    failed |= off_alarms != 0 || off_again_alarms != 0 || blink_alarms != blink_phases || blink_phases < min_phases ||
+              state != OFF_ST;
+
+    led_strip_del(led.handle);
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed;
+}
@@ -0,0 +1,122 @@
+/*
+ * Update mailbox under contention: producer threads each update their own span of the strip as fast as they
+ * can while a reader takes a frame every millisecond, as the led task does. No frame taken may mix pixels of
+ * two updates of a span or show a span going back in time, and the last frame holds every producer's last
+ * update, no write is ever dropped.
+ *
+ * Run it under ThreadSanitizer with
+ *   make run HARNESSES=app_led/mailbox_stress CFLAGS_app_led/mailbox_stress=-fsanitize=thread
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define APP_LED_POOL_LEN (1024 * LED_PIXEL_FRAMES)
+#include "app_led.c"
+
+#define LEDS 1024
+#define PRODUCERS 4
+#define SPAN (LEDS / PRODUCERS)
+#define RUN_US 2000000
+
+static led_ins_t led = { .strip_config = { .max_leds = LEDS } };
+static atomic_bool stop;
+static uint32_t last_seq[PRODUCERS];
+
+static void *producer(void *arg)
+{
+    uintptr_t id = (uintptr_t)arg;
+    led_pixel_t pixels[SPAN];
+    uint32_t seq = 0;
+    uintptr_t failed = 0;
+    while (!atomic_load(&stop)) {
+        seq++;
+        // every pixel of an update is the same, its sequence number, which doesn't wrap within the run
+        for (int i = 0; i < SPAN; i++) {
+            pixels[i] = (led_pixel_t) { .red = seq >> 16, .green = seq >> 8, .blue = seq };
+        }
+        failed += app_led_update_pixels(&led, id * SPAN, pixels, SPAN) != 0;
+    }
+    last_seq[id] = seq;
+    return (void *)failed;
+}
+
+static uint32_t span_seq(const led_pixel_t *span)
+{
+    return (span->red << 16) | (span->green << 8) | span->blue;
+}
+
+/**
+ * @brief Checks the spans of a frame, against the sequence numbers seen last
+ */
+static bool frame_ok(const led_pixel_t *frame, uint32_t *seen)
+{
+    for (int p = 0; p < PRODUCERS; p++) {
+        const led_pixel_t *span = &frame[p * SPAN];
+        for (int i = 1; i < SPAN; i++) {
+            if (memcmp(&span[i], &span[0], sizeof(led_pixel_t)) != 0) {
+                return false;
+            }
+        }
+        // a span not written yet is still black, 0
+        if (span_seq(span) < seen[p]) {
+            return false;
+        }
+        seen[p] = span_seq(span);
+    }
+    return true;
+}
+
+int main(void)
+{
+    if (configure_led(&led) != 0) {
+        printf("FAIL: configure\n");
+        return 1;
+    }
+    pthread_t threads[PRODUCERS];
+    for (uintptr_t i = 0; i < PRODUCERS; i++) {
+        pthread_create(&threads[i], NULL, producer, (void *)i);
+    }
+
+    unsigned long taken = 0, bad = 0;
+    uint32_t seen[PRODUCERS] = {0};
+    int64_t start = esp_timer_get_time();
+    while (esp_timer_get_time() - start < RUN_US) {
+        usleep(1000);
+        if (!mailbox_take(&led)) {
+            continue;
+        }
+        taken++;
+        bad += !frame_ok(pixel_frame(&led, MAILBOX_FRONT(atomic_load(&led.mailbox))), seen);
+    }
+    atomic_store(&stop, true);
+    unsigned long failed_updates = 0;
+    for (int i = 0; i < PRODUCERS; i++) {
+        void *ret;
+        pthread_join(threads[i], &ret);
+        failed_updates += (uintptr_t)ret;
+    }
+    double seconds = (esp_timer_get_time() - start) / 1e6;
+
+    // every span of the last frame published is its producer's last update
+    bool waiting = atomic_load(&led.mailbox) & MAILBOX_FRESH;
+    mailbox_take(&led);
+    const led_pixel_t *last = pixel_frame(&led, MAILBOX_FRONT(atomic_load(&led.mailbox)));
+    int lost = 0;
+    for (int p = 0; p < PRODUCERS; p++) {
+        lost += span_seq(&last[p * SPAN]) != last_seq[p] || span_seq(&last[p * SPAN + SPAN - 1]) != last_seq[p];
+    }
+
+    led_mailbox_stats_t stats;
+    app_led_mailbox_stats_get(&led, &stats);
+    printf("%d producers of %d LEDs each, %.1f s: %.1fM updates/s published, %.1fM overwritten, %lu failed\n",
+           PRODUCERS, SPAN, seconds, stats.published / seconds / 1e6, stats.overwritten / 1e6, failed_updates);
+    // every frame published is either taken, replaced by a newer one or was still waiting
+    bool counted = stats.published == taken + stats.overwritten + waiting;
+    printf("frames taken by the reader: %lu, torn or out of order: %lu, frames accounted for: %s\n", taken, bad,
+           counted ? "all" : "NOT ALL");
+    printf("last updates missing from the last frame: %d of %d\n", lost, PRODUCERS);
+    int failed = bad != 0 || taken == 0 || !counted || failed_updates != 0 || lost != 0;
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed;
+}
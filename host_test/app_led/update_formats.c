@@ -0,0 +1,108 @@
+/*
+ * Packed GRB pixels: the time an update of a 4096 pixel strip takes with each update call, through to the
+ * strip's pixel buffer, against the 16 byte colours packed on every show it replaced
+ */
+#include <stdio.h>
+#include <time.h>
+
+#define APP_LED_POOL_LEN (4096 * LED_PIXEL_FRAMES)
+#include "app_led.c"
+#include "led_strip_capture.h"
+
+#define LEDS 4096
+#define ROUNDS 20000
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static bool frame_is(led_strip_handle_t strip, const led_pixel_t *pixels)
+{
+    led_strip_capture_frame_t frame;
+    led_strip_capture_get_frame(strip, 0, &frame);
+    return frame.len == LEDS && !memcmp(frame.pixels, pixels, LEDS * 3);
+}
+
+int main(void)
+{
+    int failed = 0;
+    static led_colour_t colours[LEDS];
+    static led_pixel_t pixels[LEDS];
+    static uint8_t red[LEDS];
+    for (int i = 0; i < LEDS; i++) {
+        colours[i].rgb.red = pixels[i].red = i & 0xFF;
+        colours[i].rgb.green = pixels[i].green = (i >> 4) & 0xFF;
+        colours[i].rgb.blue = pixels[i].blue = 7;
+        red[i] = 255 - (i & 0xFF);
+    }
+
+    led_ins_t led = { .strip_config = { .max_leds = LEDS } };
+    if (configure_led(&led) != 0) {
+        printf("FAIL: configure\n");
+        return 1;
+    }
+    led_strip_capture_config_t capture_config = { .frame_num = 1 };
+    led_strip_new_capture_device(&led.strip_config, &capture_config, &led.handle);
+
+    // before: the colours were copied in as led_colour_t and packed into wire order by the show
+    static led_colour_t colour_buf[LEDS];
+    static uint8_t grb[LEDS * 3];
+    double t = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        memcpy(colour_buf, colours, sizeof(colours));
+        for (int i = 0; i < LEDS; i++) {
+            grb[i * 3] = colour_buf[i].rgb.green;
+            grb[i * 3 + 1] = colour_buf[i].rgb.red;
+            grb[i * 3 + 2] = colour_buf[i].rgb.blue;
+        }
+        led_strip_set_pixels(led.handle, 0, LEDS, grb, LED_PIXEL_FORMAT_GRB);
+        led_strip_refresh(led.handle);
+    }
+    double before_ns = (now_ns() - t) / ROUNDS;
+
+    // each update is shown and sent as on UPDATE_EV in the led task
+    t = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        app_led_update(&led, 0, colours, LEDS);
+        led_update(&led.fsm, &led);
+    }
+    double shim_ns = (now_ns() - t) / ROUNDS;
+    bool shim_ok = frame_is(led.handle, pixels);
+
+    t = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        app_led_update_pixels(&led, 0, pixels, LEDS);
+        led_update(&led.fsm, &led);
+    }
+    double pixels_ns = (now_ns() - t) / ROUNDS;
+    bool pixels_ok = frame_is(led.handle, pixels);
+
+    led_planes_t planes = { .red = red };
+    t = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        app_led_update_planes(&led, 0, &planes, LEDS);
+        led_update(&led.fsm, &led);
+    }
+    double planes_ns = (now_ns() - t) / ROUNDS;
+    static led_pixel_t red_pixels[LEDS];
+    for (int i = 0; i < LEDS; i++) {
+        red_pixels[i] = pixels[i];
+        red_pixels[i].red = red[i];
+    }
+    bool planes_ok = frame_is(led.handle, red_pixels);
+
+    printf("%d LEDs, time per update and show:\n", LEDS);
+    printf("  before, led_colour_t copy and pack:    %.1f us\n", before_ns / 1000);
+    printf("  app_led_update, led_colour_t shim:     %.1f us, frame %s\n", shim_ns / 1000, shim_ok ? "correct" : "WRONG");
+    printf("  app_led_update_pixels:                 %.1f us, frame %s\n", pixels_ns / 1000, pixels_ok ? "correct" : "WRONG");
+    printf("  app_led_update_planes, red plane only: %.1f us, frame %s\n", planes_ns / 1000, planes_ok ? "correct" : "WRONG");
+    printf("bytes per pixel: %zu, was %zu\n", sizeof(led_pixel_t), sizeof(led_colour_t));
+    failed |= !shim_ok || !pixels_ok || !planes_ok || sizeof(led_pixel_t) != 3;
+
+    led_strip_del(led.handle);
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed;
+}
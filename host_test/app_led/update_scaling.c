@@ -0,0 +1,75 @@
+/*
+ * LED buffer sized from the strip length: an update of the whole strip, through to the strip's pixel buffer,
+ * grows linearly from 64 to 4096 pixels, and the frame shown is the one given
+ */
+#include <stdio.h>
+#include <time.h>
+
+// room for every strip length below, the pool isn't given back
+#define APP_LED_POOL_LEN (8192 * LED_PIXEL_FRAMES)
+#include "app_led.c"
+#include "led_strip_capture.h"
+
+#define MAX_LEDS 4096
+#define BENCH_PIXELS (1 << 22)
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void)
+{
+    int failed = 0;
+    static led_colour_t colours[MAX_LEDS];
+    for (int i = 0; i < MAX_LEDS; i++) {
+        colours[i].rgb.red = i & 0xFF;
+        colours[i].rgb.green = (i >> 4) & 0xFF;
+        colours[i].rgb.blue = 7;
+    }
+
+    double prev_ns = 0;
+    for (uint32_t len = 64; len <= MAX_LEDS; len *= 2) {
+        led_ins_t led = { .strip_config = { .max_leds = len } };
+        if (configure_led(&led) != 0) {
+            printf("FAIL: configure %u LEDs\n", len);
+            return 1;
+        }
+        led_strip_capture_config_t capture_config = { .frame_num = 1 };
+        led_strip_new_capture_device(&led.strip_config, &capture_config, &led.handle);
+
+        // the update is published, then shown by the led task as on UPDATE_EV
+        int rounds = BENCH_PIXELS / len;
+        double t = now_ns();
+        for (int r = 0; r < rounds; r++) {
+            app_led_update(&led, 0, colours, len);
+            led_update(&led.fsm, &led);
+        }
+        double ns = (now_ns() - t) / rounds;
+
+        led_strip_capture_frame_t frame;
+        led_strip_capture_get_frame(led.handle, 0, &frame);
+        bool ok = frame.len == len;
+        for (uint32_t i = 0; ok && i < len; i++) {
+            ok = frame.pixels[i * 3] == colours[i].rgb.green && frame.pixels[i * 3 + 1] == colours[i].rgb.red &&
+                 frame.pixels[i * 3 + 2] == colours[i].rgb.blue;
+        }
+        // the pixels added since the previous length, the fixed cost of an update cancels out
+        printf("%4u LEDs: %7.0f ns per update, %.2f ns per added pixel, frame %s\n", len, ns,
+               prev_ns ? (ns - prev_ns) / (len / 2) : ns / len, ok ? "correct" : "WRONG");
+        failed |= !ok;
+        prev_ns = ns;
+        led_strip_del(led.handle);
+    }
+
+    // the pool refuses a strip it has no room for
+    led_ins_t led = { .strip_config = { .max_leds = APP_LED_POOL_LEN } };
+    int ret = configure_led(&led);
+    printf("strip past the pool: %s\n", ret == -2 ? "refused" : "ACCEPTED");
+    failed |= ret != -2;
+
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed;
+}
@@ -0,0 +1,177 @@
+/*
+ * Shared timer wheel under the load of 1000 FSM instances, on a virtual clock: 700 leds blinking every
+ * 250 ms and 300 buttons pressed at random, with the anti-bounce, long press and early releases. Every
+ * timeout must fire within one tick after it is due, and the wheel's CPU time and alarms are reported.
+ * Then a single led blinking on its own, which must take one alarm per timeout and none once cancelled, and
+ * what finding the first expiry costs with 1 and with 1000 timers sharing a slot of the second level.
+ */
+#include <stdio.h>
+#include <time.h>
+
+#include "app_timer.c"
+#include "virtual_timer.h"
+
+#define INSTANCES 1000
+#define LEDS 700
+#define SIM_SECONDS 60
+#define DUE_ROUNDS 1000000
+
+typedef struct
+{
+    app_timer_t timer;
+    int stage;              // buttons: 0 anti-bounce, 1 waiting for the long press, 2 released
+    int64_t due_us;
+    int64_t next_press_us;
+} instance_t;
+
+static instance_t instances[INSTANCES];
+static long timeouts, early, late, stale;
+static double wheel_ns;
+static int depth;
+
+static double cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// CPU time in the wheel, the callbacks arming again from inside the alarm are only counted once
+#define WHEEL_TIMED(x)                             \
+    do {                                           \
+        double start = depth++ ? 0 : cpu_ns();     \
+        x;                                         \
+        if (--depth == 0) {                        \
+            wheel_ns += cpu_ns() - start;          \
+        }                                          \
+    } while (0)
+
+/**
+ * @brief CPU time of wheel_due with `num` timers armed together, the earliest one first
+ */
+static double due_ns(int num, bool *exact)
+{
+    for (int i = 0; i < num; i++) {
+        app_timer_arm(&instances[i].timer, i == 0 ? 500 : 501);
+    }
+    uint64_t first = instances[0].timer.expiry;
+    double start = cpu_ns();
+    // called through a volatile pointer, so the calls aren't folded into one
+    uint64_t (*volatile find)(timer_wheel_t *) = wheel_due;
+    uint64_t due = 0;
+    for (int r = 0; r < DUE_ROUNDS; r++) {
+        due |= find(&wheel);
+    }
+    double ns = (cpu_ns() - start) / DUE_ROUNDS;
+    *exact = due == first && instances[0].timer.level == 1 && instances[num - 1].timer.slot == instances[0].timer.slot;
+    for (int i = 0; i < num; i++) {
+        app_timer_cancel(&instances[i].timer);
+    }
+    return ns;
+}
+
+static void arm(instance_t *ins, uint32_t ms)
+{
+    ins->due_us = esp_timer_get_time() + (int64_t)ms * 1000;
+    WHEEL_TIMED(app_timer_arm(&ins->timer, ms));
+}
+
+static void timeout(void *arg, uint32_t gen)
+{
+    instance_t *ins = arg;
+    if (!app_timer_is_current(&ins->timer, gen)) {
+        stale++;
+        return;
+    }
+    timeouts++;
+    int64_t after = esp_timer_get_time() - ins->due_us;
+    early += after < 0;
+    late += after > APP_TIMER_TICK_US;
+
+    if (ins < &instances[LEDS]) {
+        arm(ins, 250);
+    } else if (ins->stage == 0) {
+        ins->stage = 1;
+        arm(ins, 500);
+    } else {
+        ins->stage = 2;
+    }
+}
+
+int main(void)
+{
+    srand(1);
+    // an unaligned start, so the arms fall part way through the ticks
+    virtual_timer_run_until(123456789);
+    for (int i = 0; i < INSTANCES; i++) {
+        app_timer_init(&instances[i].timer, timeout, &instances[i]);
+        instances[i].stage = 2;
+        instances[i].next_press_us = esp_timer_get_time() + rand() % 2000000;
+    }
+    for (int i = 0; i < LEDS; i++) {
+        arm(&instances[i], 1 + rand() % 250);
+    }
+
+    long presses = 0, releases = 0;
+    int64_t end = esp_timer_get_time() + SIM_SECONDS * 1000000LL;
+    while (esp_timer_get_time() < end) {
+        // the alarm fires on its own, the buttons are polled every millisecond
+        WHEEL_TIMED(virtual_timer_run_until(esp_timer_get_time() + 1000));
+        for (int i = LEDS; i < INSTANCES; i++) {
+            instance_t *ins = &instances[i];
+            if (ins->stage == 2 && esp_timer_get_time() >= ins->next_press_us) {
+                ins->stage = 0;
+                arm(ins, 10);
+                ins->next_press_us = esp_timer_get_time() + 200000 + rand() % 3000000;
+                presses++;
+            } else if (ins->stage == 1 && rand() % 300 == 0) {
+                WHEEL_TIMED(app_timer_cancel(&ins->timer));
+                ins->stage = 2;
+                releases++;
+            }
+        }
+    }
+
+    app_timer_stats_t stats;
+    app_timer_stats_get(&stats);
+    printf("%d instances, %d simulated s, %ld presses, %ld early releases\n", INSTANCES, SIM_SECONDS, presses, releases);
+    printf("wheel CPU time: %.0f us per simulated s\n", wheel_ns / 1e3 / SIM_SECONDS);
+    printf("timeouts: %.0f/s, alarms: %.0f/s, cascaded: %.0f/s\n", (double)stats.fired / SIM_SECONDS,
+           (double)stats.alarms / SIM_SECONDS, (double)stats.cascaded / SIM_SECONDS);
+    printf("early: %ld, late: %ld, stale: %ld of %ld\n", early, late, stale, timeouts);
+    int failed = early != 0 || late != 0 || timeouts == 0;
+
+    // one led left blinking, its 250 ms timeouts go through a cascade from the second level
+    for (int i = 1; i < INSTANCES; i++) {
+        app_timer_cancel(&instances[i].timer);
+    }
+    // the alarm programmed for a timer cancelled, and the earliest expiries kept for the slots it shared with
+    // the led, may each still go off once, they are all due within the next second
+    app_timer_stats_t before;
+    app_timer_stats_get(&before);
+    virtual_timer_run_until(esp_timer_get_time() + 1000000);
+    app_timer_stats_get(&stats);
+    uint32_t settle_fired = stats.fired - before.fired, settle_alarms = stats.alarms - before.alarms;
+    app_timer_stats_get(&before);
+    virtual_timer_run_until(esp_timer_get_time() + 10000000);
+    app_timer_stats_get(&stats);
+    uint32_t fired = stats.fired - before.fired, alarms = stats.alarms - before.alarms;
+    app_timer_cancel(&instances[0].timer);
+    app_timer_stats_get(&before);
+    virtual_timer_run_until(esp_timer_get_time() + 10000000);
+    app_timer_stats_get(&stats);
+    uint32_t idle_alarms = stats.alarms - before.alarms;
+    printf("one led left blinking, first s: %u timeouts, %u alarms; next 10 s: %u timeouts, %u alarms; "
+           "%u alarms once cancelled\n", settle_fired, settle_alarms, fired, alarms, idle_alarms);
+    failed |= fired == 0 || alarms != fired || idle_alarms != 0 || early != 0 || late != 0;
+
+    // the earliest expiry of a slot is kept, the timers sharing it aren't looked at
+    bool one_exact, many_exact;
+    double one_ns = due_ns(1, &one_exact);
+    double many_ns = due_ns(INSTANCES, &many_exact);
+    printf("first expiry with 1 timer in a second level slot: %.1f ns, with %d: %.1f ns, %s\n", one_ns, INSTANCES, many_ns,
+           one_exact && many_exact ? "exact" : "WRONG");
+    failed |= !one_exact || !many_exact;
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed;
+}
@@ -0,0 +1,124 @@
+/*
+ * SPI brightness outside the streaming mode: pixels set before a new brightness go out scaled by it, as if they
+ * were set afterwards, the frames captured with the old one are dropped, and what encoding the buffer again costs
+ */
+#include <stdio.h>
+#include <time.h>
+
+#include "led_strip_spi_dev.c"
+#include "mock_spi.h"
+
+#define LEDS 1000
+#define ROUNDS 1000
+
+// the reset time is spent waiting, not encoding, leave it out of the timings
+void esp_rom_delay_us(uint32_t us)
+{
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static led_strip_config_t strip_config = {
+    .strip_gpio_num = 8,
+    .max_leds = LEDS,
+    .led_pixel_format = LED_PIXEL_FORMAT_GRB,
+    .led_model = LED_MODEL_WS2812,
+};
+
+/**
+ * @brief What a new strip sends for the pixels, the brightness set before them
+ */
+static size_t reference(const uint8_t *pixels, uint16_t brightness, uint8_t *out)
+{
+    led_strip_spi_config_t spi_config = { .spi_bus = SPI2_HOST, .flags.with_dma = true };
+    led_strip_handle_t strip;
+    if (led_strip_new_spi_device(&strip_config, &spi_config, &strip) != ESP_OK) {
+        return 0;
+    }
+    led_strip_set_brightness(strip, brightness, false);
+    led_strip_set_pixels(strip, 0, LEDS, pixels, LED_PIXEL_FORMAT_GRB);
+    host_spi_reset();
+    led_strip_refresh(strip);
+    size_t len;
+    const uint8_t *bus = host_spi_output(&len);
+    memcpy(out, bus, len);
+    led_strip_del(strip);
+    return len;
+}
+
+static bool sent_is(led_strip_handle_t strip, const uint8_t *ref, size_t ref_len)
+{
+    host_spi_reset();
+    led_strip_refresh(strip);
+    size_t len;
+    const uint8_t *bus = host_spi_output(&len);
+    return len == ref_len && !memcmp(bus, ref, len);
+}
+
+int main(void)
+{
+    int failed = 0;
+    static uint8_t pixels[LEDS * 3];
+    srand(1);
+    for (size_t i = 0; i < sizeof(pixels); i++) {
+        pixels[i] = rand();
+    }
+    uint8_t *ref = malloc(LEDS * 3 * SPI_MAX_SYMBOLS_PER_BIT);
+    uint8_t *ref_max = malloc(LEDS * 3 * SPI_MAX_SYMBOLS_PER_BIT);
+    uint8_t *ref_one = malloc(LEDS * 3 * SPI_MAX_SYMBOLS_PER_BIT);
+    // the reference strips are created first, the bus takes one strip at a time
+    size_t ref_len = reference(pixels, 100, ref);
+    size_t ref_max_len = reference(pixels, LED_STRIP_BRIGHTNESS_MAX, ref_max);
+    static uint8_t one_pixel[LEDS * 3];
+    one_pixel[7 * 3] = 100;
+    one_pixel[7 * 3 + 1] = 200;
+    one_pixel[7 * 3 + 2] = 50;
+    size_t ref_one_len = reference(one_pixel, 100, ref_one);
+
+    led_strip_spi_config_t spi_config = { .spi_bus = SPI2_HOST, .flags.with_dma = true, .flags.double_buffer = true };
+    led_strip_handle_t strip;
+    if (led_strip_new_spi_device(&strip_config, &spi_config, &strip) != ESP_OK) {
+        printf("FAIL: create strip\n");
+        return 1;
+    }
+    led_strip_set_pixels(strip, 0, LEDS, pixels, LED_PIXEL_FORMAT_GRB);
+    led_strip_refresh_async(strip);
+    led_strip_capture_frame(strip, 0);
+
+    // set before the brightness, the pixels are scaled all the same and the captured frame is gone
+    led_strip_set_brightness(strip, 100, false);
+    bool scaled = sent_is(strip, ref, ref_len);
+    bool dropped = led_strip_refresh_frame(strip, 0) == ESP_ERR_INVALID_STATE;
+    // back to full brightness, from the color bytes kept rather than from the scaled ones
+    led_strip_set_brightness(strip, LED_STRIP_BRIGHTNESS_MAX, false);
+    bool restored = sent_is(strip, ref_max, ref_max_len);
+    printf("pixels set before the brightness: %s, captured frame %s, full brightness again: %s\n",
+           scaled ? "scaled" : "NOT SCALED", dropped ? "dropped" : "KEPT", restored ? "exact" : "WRONG");
+    failed |= !scaled || !dropped || !restored;
+
+    // a cleared strip and a pixel set over it keep the color bytes in step too
+    led_strip_clear(strip);
+    led_strip_set_pixel(strip, 7, 200, 100, 50);
+    led_strip_set_brightness(strip, 100, false);
+    bool cleared = sent_is(strip, ref_one, ref_one_len);
+    printf("pixel set over a cleared strip: %s\n", cleared ? "scaled" : "WRONG");
+    failed |= !cleared;
+
+    double t = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        led_strip_set_brightness(strip, r & 1 ? 100 : 200, false);
+    }
+    printf("%d LEDs, encoding the pixel buffer again: %.1f us per brightness change\n", LEDS, (now_ns() - t) / ROUNDS / 1000);
+
+    led_strip_del(strip);
+    free(ref);
+    free(ref_max);
+    free(ref_one);
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed;
+}
@@ -0,0 +1,99 @@
+/*
+ * SPI frame cache: a blink cycle sends the captured frame and the black frame as they are, without encoding
+ * a single colour byte, and what it saves against setting the pixels again
+ */
+#include <stdio.h>
+#include <time.h>
+
+#include "led_strip_spi_dev.c"
+#include "mock_spi.h"
+
+#define LEDS 1000
+#define CYCLES 1000
+
+// the reset time is spent waiting, not encoding, leave it out of the timings
+void esp_rom_delay_us(uint32_t us)
+{
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void)
+{
+    int failed = 0;
+    static uint8_t pixels[LEDS * 3];
+    srand(1);
+    for (size_t i = 0; i < sizeof(pixels); i++) {
+        pixels[i] = rand();
+    }
+
+    led_strip_config_t strip_config = {
+        .strip_gpio_num = 8,
+        .max_leds = LEDS,
+        .led_pixel_format = LED_PIXEL_FORMAT_GRB,
+        .led_model = LED_MODEL_WS2812,
+    };
+    led_strip_spi_config_t spi_config = { .spi_bus = SPI2_HOST, .flags.with_dma = true };
+    led_strip_handle_t strip;
+    if (led_strip_new_spi_device(&strip_config, &spi_config, &strip) != ESP_OK) {
+        printf("FAIL: create strip\n");
+        return 1;
+    }
+    led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
+    size_t frame_size = spi_strip->frame_size;
+    uint8_t *on = malloc(frame_size);
+    uint8_t *pixel_buf = malloc(frame_size);
+
+    // the "on" frame is encoded once and captured
+    led_strip_set_pixels(strip, 0, LEDS, pixels, LED_PIXEL_FORMAT_GRB);
+    host_spi_reset();
+    led_strip_refresh(strip);
+    size_t len;
+    const uint8_t *bus = host_spi_output(&len);
+    memcpy(on, bus, frame_size);
+    led_strip_capture_frame(strip, 0);
+    memcpy(pixel_buf, spi_strip->pixel_buf, frame_size);
+
+    // blink: the on frame from the cache, the off frame from clear
+    int wrong_buffer = 0;
+    int wrong_frame = 0;
+    double t = now_ns();
+    for (int c = 0; c < CYCLES; c++) {
+        host_spi_reset();
+        led_strip_refresh_frame(strip, 0);
+        led_strip_wait_refresh_done(strip, -1);
+        wrong_buffer += spi_strip->trans.tx_buffer != spi_strip->frame_cache[0];
+        led_strip_clear(strip);
+        wrong_buffer += spi_strip->trans.tx_buffer != spi_strip->black_buf;
+        bus = host_spi_output(&len);
+        wrong_frame += len != 2 * frame_size || memcmp(bus, on, frame_size) || memcmp(bus + frame_size, spi_strip->black_buf, frame_size);
+    }
+    double cached_ns = (now_ns() - t) / CYCLES;
+    // the pixel buffer is only flagged black by clear, its bytes are never rewritten
+    bool untouched = !memcmp(pixel_buf, spi_strip->pixel_buf, frame_size);
+    printf("%d blink cycles: %d sent from another buffer, %d wrong frames, pixel buffer %s\n",
+           CYCLES, wrong_buffer, wrong_frame, untouched ? "untouched (0 bytes encoded)" : "REWRITTEN");
+    failed |= wrong_buffer || wrong_frame || !untouched;
+
+    // the same blink setting the pixels again for every on phase
+    t = now_ns();
+    for (int c = 0; c < CYCLES; c++) {
+        led_strip_set_pixels(strip, 0, LEDS, pixels, LED_PIXEL_FORMAT_GRB);
+        led_strip_refresh(strip);
+        led_strip_clear(strip);
+    }
+    double encoded_ns = (now_ns() - t) / CYCLES;
+    printf("%d LEDs, CPU time per blink cycle: %.1f us from the cache, %.1f us encoding the on frame\n",
+           LEDS, cached_ns / 1000, encoded_ns / 1000);
+
+    led_strip_del(strip);
+    free(on);
+    free(pixel_buf);
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed;
+}
@@ -0,0 +1,174 @@
+/*
+ * HSV conversion: the integer kernel gives the same colour as the float conversion it replaced for every
+ * input, how fast it is, and the batch setter writes the same frame as one set_pixel_hsv call per pixel
+ */
+#include <stdio.h>
+#include <time.h>
+
+#include "led_strip_api.c"
+#include "led_strip_spi.h"
+#include "mock_spi.h"
+
+#define LEDS 100
+#define BENCH_COLOURS 4096
+#define BENCH_ROUNDS 2000
+
+// The conversion before the kernel: a float division by 255 and integer divisions by 60
+static void float_hsv_to_grb(uint16_t hue, uint8_t saturation, uint8_t value, uint8_t *grb)
+{
+    uint32_t red = 0;
+    uint32_t green = 0;
+    uint32_t blue = 0;
+
+    uint32_t rgb_max = value;
+    uint32_t rgb_min = rgb_max * (255 - saturation) / 255.0f;
+
+    uint32_t i = hue / 60;
+    uint32_t diff = hue % 60;
+
+    // RGB adjustment amount by hue
+    uint32_t rgb_adj = (rgb_max - rgb_min) * diff / 60;
+
+    switch (i) {
+    case 0:
+        red = rgb_max;
+        green = rgb_min + rgb_adj;
+        blue = rgb_min;
+        break;
+    case 1:
+        red = rgb_max - rgb_adj;
+        green = rgb_max;
+        blue = rgb_min;
+        break;
+    case 2:
+        red = rgb_min;
+        green = rgb_max;
+        blue = rgb_min + rgb_adj;
+        break;
+    case 3:
+        red = rgb_min;
+        green = rgb_max - rgb_adj;
+        blue = rgb_max;
+        break;
+    case 4:
+        red = rgb_min + rgb_adj;
+        green = rgb_min;
+        blue = rgb_max;
+        break;
+    default:
+        red = rgb_max;
+        green = rgb_min;
+        blue = rgb_max - rgb_adj;
+        break;
+    }
+    grb[0] = green;
+    grb[1] = red;
+    grb[2] = blue;
+}
+
+static long check_hue(uint16_t hue)
+{
+    long mismatches = 0;
+    for (int saturation = 0; saturation < 256; saturation++) {
+        for (int value = 0; value < 256; value++) {
+            uint8_t ref[3], out[3];
+            float_hsv_to_grb(hue, saturation, value, ref);
+            led_strip_hsv_to_grb(hue, saturation, value, out);
+            mismatches += memcmp(ref, out, 3) != 0;
+        }
+    }
+    return mismatches;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench(const char *name, const led_strip_hsv_t *colours)
+{
+    static uint8_t grb[BENCH_COLOURS * 3];
+    double t = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (int i = 0; i < BENCH_COLOURS; i++) {
+            float_hsv_to_grb(colours[i].hue, colours[i].saturation, colours[i].value, &grb[i * 3]);
+        }
+        __asm__ volatile("" ::: "memory");
+    }
+    double float_s = (now_ns() - t) / 1e9;
+    t = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (int i = 0; i < BENCH_COLOURS; i++) {
+            led_strip_hsv_to_grb(colours[i].hue, colours[i].saturation, colours[i].value, &grb[i * 3]);
+        }
+        __asm__ volatile("" ::: "memory");
+    }
+    double int_s = (now_ns() - t) / 1e9;
+    double total = (double)BENCH_ROUNDS * BENCH_COLOURS;
+    printf("%s, conversions per second: float %.2fG, integer %.2fG (%.1fx)\n", name, total / float_s / 1e9, total / int_s / 1e9,
+           float_s / int_s);
+}
+
+int main(void)
+{
+    int failed = 0;
+
+    // every saturation and value, for every hue of the circle and a sample of the hues past it
+    long checked = 0;
+    long mismatches = 0;
+    for (uint32_t hue = 0; hue <= 65535; hue += hue < 360 ? 1 : 997) {
+        mismatches += check_hue(hue);
+        checked += 256 * 256;
+    }
+    printf("integer vs float conversion: %ld mismatches out of %.1fM\n", mismatches, checked / 1e6);
+    failed |= mismatches != 0;
+
+    // throughput over random colours, and over a rainbow where the hue sextant changes slowly
+    static led_strip_hsv_t colours[BENCH_COLOURS];
+    static led_strip_hsv_t rainbow[BENCH_COLOURS];
+    srand(1);
+    for (int i = 0; i < BENCH_COLOURS; i++) {
+        colours[i] = (led_strip_hsv_t) { .hue = rand() % 360, .saturation = rand(), .value = rand() };
+        rainbow[i] = (led_strip_hsv_t) { .hue = i * 360 / BENCH_COLOURS, .saturation = 255, .value = i };
+    }
+    bench("random colours", colours);
+    bench("rainbow", rainbow);
+
+    // the batch setter across several 32 pixel chunks, on the SPI backend
+    led_strip_config_t strip_config = {
+        .strip_gpio_num = 8,
+        .max_leds = LEDS,
+        .led_pixel_format = LED_PIXEL_FORMAT_GRB,
+        .led_model = LED_MODEL_WS2812,
+    };
+    led_strip_spi_config_t spi_config = { .spi_bus = SPI2_HOST, .flags.with_dma = true };
+    led_strip_handle_t strip;
+    if (led_strip_new_spi_device(&strip_config, &spi_config, &strip) != ESP_OK) {
+        printf("FAIL: create strip\n");
+        return 1;
+    }
+    static uint8_t ref[LEDS * 3 * 5], out[LEDS * 3 * 5];
+    size_t ref_len, out_len;
+    for (uint32_t i = 0; i < LEDS; i++) {
+        led_strip_set_pixel_hsv(strip, i, colours[i].hue, colours[i].saturation, colours[i].value);
+    }
+    host_spi_reset();
+    led_strip_refresh(strip);
+    const uint8_t *bus = host_spi_output(&ref_len);
+    memcpy(ref, bus, ref_len);
+    led_strip_clear_buffer_only(strip);
+    led_strip_set_pixels_hsv(strip, 0, LEDS, colours);
+    host_spi_reset();
+    led_strip_refresh(strip);
+    bus = host_spi_output(&out_len);
+    memcpy(out, bus, out_len);
+    bool same = ref_len == out_len && !memcmp(ref, out, ref_len);
+    printf("%d LEDs, set_pixels_hsv vs set_pixel_hsv: %s\n", LEDS, same ? "identical" : "DIFFERENT");
+    failed |= !same;
+    led_strip_del(strip);
+
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed;
+}
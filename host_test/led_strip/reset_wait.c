@@ -0,0 +1,126 @@
+/*
+ * Reset time between frames: a frame only waits for the part of the 280 us reset time that hasn't elapsed,
+ * measured on a virtual clock with the legacy RMT backend, against the fixed waits it replaced
+ */
+#include <stdio.h>
+
+#include "led_strip_rmt_dev_idf4.c"
+
+#define FRAMES 100
+#define HOST_RMT_COUNTER_HZ 40000000
+
+// Virtual clock, moved by the delays and by the frames on the wire
+static int64_t now_us;
+static double wire_ns;
+
+int64_t esp_timer_get_time(void)
+{
+    return now_us;
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    now_us += us;
+}
+
+// Mock of the legacy RMT driver: a blocking write keeps the wire busy for the duration of its items
+static sample_to_rmt_t translator;
+
+esp_err_t rmt_config(const rmt_config_t *config)
+{
+    return ESP_OK;
+}
+
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rx_buf_size, int intr_alloc_flags)
+{
+    return ESP_OK;
+}
+
+esp_err_t rmt_driver_uninstall(rmt_channel_t channel)
+{
+    return ESP_OK;
+}
+
+esp_err_t rmt_get_counter_clock(rmt_channel_t channel, uint32_t *clock_hz)
+{
+    *clock_hz = HOST_RMT_COUNTER_HZ;
+    return ESP_OK;
+}
+
+esp_err_t rmt_translator_init(rmt_channel_t channel, sample_to_rmt_t fn)
+{
+    translator = fn;
+    return ESP_OK;
+}
+
+esp_err_t rmt_write_sample(rmt_channel_t channel, const uint8_t *src, size_t src_size, bool wait_tx_done)
+{
+    rmt_item32_t items[64];
+    while (src_size) {
+        size_t translated = 0, num = 0;
+        translator(src, items, src_size, 64, &translated, &num);
+        for (size_t i = 0; i < num; i++) {
+            wire_ns += (items[i].duration0 + items[i].duration1) * 1e9 / HOST_RMT_COUNTER_HZ;
+        }
+        src += translated;
+        src_size -= translated;
+    }
+    now_us += (int64_t)wire_ns / 1000;
+    wire_ns -= (int64_t)wire_ns / 1000 * 1000;
+    return ESP_OK;
+}
+
+esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t wait_time)
+{
+    return ESP_OK;
+}
+
+/**
+ * @brief Frames per second sent back to back, with `work_us` of other work between them
+ */
+static double measure_fps(led_strip_handle_t strip, uint32_t work_us)
+{
+    led_strip_refresh(strip);
+    int64_t start = now_us;
+    for (int f = 0; f < FRAMES; f++) {
+        now_us += work_us;
+        led_strip_refresh(strip);
+    }
+    return FRAMES * 1e6 / (now_us - start);
+}
+
+int main(void)
+{
+    int failed = 0;
+    const uint32_t lengths[] = {1, 60, 1000};
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        led_strip_config_t strip_config = {
+            .strip_gpio_num = 8,
+            .max_leds = lengths[i],
+            .led_pixel_format = LED_PIXEL_FORMAT_GRB,
+            .led_model = LED_MODEL_WS2812,
+        };
+        led_strip_rmt_config_t dev_config = { .rmt_channel = 0 };
+        led_strip_handle_t strip;
+        if (led_strip_new_rmt_device(&strip_config, &dev_config, &strip) != ESP_OK) {
+            printf("FAIL: create strip\n");
+            return 1;
+        }
+        uint32_t max_fps;
+        led_strip_get_max_fps(strip, &max_fps);
+        double fps = measure_fps(strip, 0);
+        // other work shorter than the reset time overlaps it
+        double fps_work = measure_fps(strip, 200);
+        // before: the 280 us reset symbol at the end of every frame, then a 10 ms delay
+        double wire_us = lengths[i] * 24 * 1.2;
+        double before_fps = 1e6 / (wire_us + 280 + 10000);
+        printf("%4u LEDs: %4.0f fps back to back, %4.0f fps with 200 us of work between frames, get_max_fps %4u, "
+               "before %2.0f fps\n", lengths[i], fps, fps_work, max_fps, before_fps);
+        // the frame period is the wire time and the reset time, to the microsecond
+        failed |= fps < 1e6 / (wire_us + LED_STRIP_RESET_US + 1) || fps_work < fps * 0.999;
+        led_strip_del(strip);
+    }
+
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed;
+}
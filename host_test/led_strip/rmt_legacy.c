@@ -0,0 +1,196 @@
+/*
+ * Legacy RMT translator: the nibble item table sends the same items as the per bit adapter it replaced,
+ * never writes past the items it's asked for, and what it costs per byte
+ */
+#include <stdio.h>
+#include <time.h>
+
+#include "led_strip_rmt_dev_idf4.c"
+
+#define LEDS 100
+#define BENCH_ROUNDS 20000
+
+// Mock of the legacy RMT driver: the translator is called with `wanted_num` free items until the samples run out
+#define HOST_RMT_COUNTER_HZ 40000000
+
+static sample_to_rmt_t translator;
+static size_t wanted_num = 64;
+static rmt_item32_t sent[LEDS * 4 * 8];
+static size_t sent_num;
+
+esp_err_t rmt_config(const rmt_config_t *config)
+{
+    return ESP_OK;
+}
+
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rx_buf_size, int intr_alloc_flags)
+{
+    return ESP_OK;
+}
+
+esp_err_t rmt_driver_uninstall(rmt_channel_t channel)
+{
+    return ESP_OK;
+}
+
+esp_err_t rmt_get_counter_clock(rmt_channel_t channel, uint32_t *clock_hz)
+{
+    *clock_hz = HOST_RMT_COUNTER_HZ;
+    return ESP_OK;
+}
+
+esp_err_t rmt_translator_init(rmt_channel_t channel, sample_to_rmt_t fn)
+{
+    translator = fn;
+    return ESP_OK;
+}
+
+esp_err_t rmt_write_sample(rmt_channel_t channel, const uint8_t *src, size_t src_size, bool wait_tx_done)
+{
+    sent_num = 0;
+    while (src_size) {
+        size_t translated = 0, num = 0;
+        translator(src, &sent[sent_num], src_size, wanted_num, &translated, &num);
+        if (translated == 0 || num > wanted_num) {
+            return ESP_FAIL;
+        }
+        src += translated;
+        src_size -= translated;
+        sent_num += num;
+    }
+    return ESP_OK;
+}
+
+esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t wait_time)
+{
+    return ESP_OK;
+}
+
+// The adapter before the table: a branch per bit, items built from the tick counts
+static uint32_t led_t0h_ticks, led_t1h_ticks, led_t0l_ticks, led_t1l_ticks;
+
+static void legacy_rmt_adapter(const void *src, rmt_item32_t *dest, size_t src_size,
+                               size_t wanted_num, size_t *translated_size, size_t *item_num)
+{
+    const rmt_item32_t bit0 = {{{ led_t0h_ticks, 1, led_t0l_ticks, 0 }}}; //Logical 0
+    const rmt_item32_t bit1 = {{{ led_t1h_ticks, 1, led_t1l_ticks, 0 }}}; //Logical 1
+    size_t size = 0;
+    size_t num = 0;
+    uint8_t *psrc = (uint8_t *)src;
+    rmt_item32_t *pdest = dest;
+    while (size < src_size && num < wanted_num) {
+        for (int i = 0; i < 8; i++) {
+            // MSB first
+            if (*psrc & (1 << (7 - i))) {
+                pdest->val =  bit1.val;
+            } else {
+                pdest->val =  bit0.val;
+            }
+            num++;
+            pdest++;
+        }
+        size++;
+        psrc++;
+    }
+    *translated_size = size;
+    *item_num = num;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void)
+{
+    int failed = 0;
+    static uint8_t pixels[LEDS * 3];
+    static rmt_item32_t ref[LEDS * 3 * 8];
+    srand(1);
+    for (size_t i = 0; i < sizeof(pixels); i++) {
+        pixels[i] = rand();
+    }
+
+    const struct {
+        led_model_t model;
+        const char *name;
+        uint32_t t0h, t0l, t1h, t1l;
+    } models[] = {
+        {LED_MODEL_WS2812, "WS2812", WS2812_T0H_NS, WS2812_T0L_NS, WS2812_T1H_NS, WS2812_T1L_NS},
+        {LED_MODEL_SK6812, "SK6812", SK6812_T0H_NS, SK6812_T0L_NS, SK6812_T1H_NS, SK6812_T1L_NS},
+    };
+    for (size_t m = 0; m < sizeof(models) / sizeof(models[0]); m++) {
+        led_strip_config_t strip_config = {
+            .strip_gpio_num = 8,
+            .max_leds = LEDS,
+            .led_pixel_format = LED_PIXEL_FORMAT_GRB,
+            .led_model = models[m].model,
+        };
+        led_strip_rmt_config_t dev_config = { .rmt_channel = 0 };
+        led_strip_handle_t strip;
+        if (led_strip_new_rmt_device(&strip_config, &dev_config, &strip) != ESP_OK) {
+            printf("FAIL: create strip\n");
+            return 1;
+        }
+        // the tick counts as the old code worked them out
+        float ratio = (float)HOST_RMT_COUNTER_HZ / 1e9;
+        led_t0h_ticks = (uint32_t)(ratio * models[m].t0h);
+        led_t0l_ticks = (uint32_t)(ratio * models[m].t0l);
+        led_t1h_ticks = (uint32_t)(ratio * models[m].t1h);
+        led_t1l_ticks = (uint32_t)(ratio * models[m].t1l);
+        size_t ref_size, ref_num;
+        legacy_rmt_adapter(pixels, ref, sizeof(pixels), SIZE_MAX, &ref_size, &ref_num);
+
+        // free items per call, from a byte to more than a 64 item memory block
+        strip->set_pixels(strip, 0, LEDS, pixels, LED_PIXEL_FORMAT_GRB);
+        int bad = 0;
+        for (wanted_num = 8; wanted_num <= 130; wanted_num++) {
+            memset(sent, 0, sizeof(sent));
+            bad += strip->refresh(strip) != ESP_OK || sent_num != ref_num || memcmp(sent, ref, sizeof(ref));
+        }
+        printf("%s, 8 to 130 free items per call: %d differ from the per bit adapter\n", models[m].name, bad);
+        failed |= bad != 0;
+        strip->del(strip);
+    }
+
+    // a call never writes past the items asked for, the old adapter wrote whole bytes past them
+    rmt_item32_t dest[16];
+    const int asked = 12;
+    size_t size, num;
+    memset(dest, 0, sizeof(dest));
+    ws2812_rmt_adapter(pixels, dest, sizeof(pixels), asked, &size, &num);
+    int written = 0;
+    for (int i = 0; i < 16; i++) {
+        written = dest[i].val ? i + 1 : written;
+    }
+    memset(dest, 0, sizeof(dest));
+    legacy_rmt_adapter(pixels, dest, sizeof(pixels), asked, &size, &num);
+    int legacy_written = 0;
+    for (int i = 0; i < 16; i++) {
+        legacy_written = dest[i].val ? i + 1 : legacy_written;
+    }
+    printf("%d items asked for: table writes %d, per bit adapter wrote %d\n", asked, written, legacy_written);
+    failed |= written > asked;
+
+    // cost per byte with a whole frame asked for at once
+    double t = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        pixels[r % sizeof(pixels)] = r;
+        legacy_rmt_adapter(pixels, sent, sizeof(pixels), SIZE_MAX, &size, &num);
+        __asm__ volatile("" ::: "memory");
+    }
+    double legacy_ns = (now_ns() - t) / BENCH_ROUNDS / sizeof(pixels);
+    t = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        pixels[r % sizeof(pixels)] = r;
+        ws2812_rmt_adapter(pixels, sent, sizeof(pixels), SIZE_MAX, &size, &num);
+        __asm__ volatile("" ::: "memory");
+    }
+    double table_ns = (now_ns() - t) / BENCH_ROUNDS / sizeof(pixels);
+    printf("translate per byte: per bit %.2f ns, nibble table %.2f ns (%.1fx)\n", legacy_ns, table_ns, legacy_ns / table_ns);
+
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed;
+}
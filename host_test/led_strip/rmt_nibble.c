@@ -0,0 +1,181 @@
+/*
+ * RMT nibble encoder: the simple encoder callback writes the same symbols as a bit by bit bytes encoder,
+ * whatever the free space it's handed, what it costs per byte, and whether it refills the RMT memory in time
+ */
+#include <stdio.h>
+#include <time.h>
+
+#include "led_strip_rmt_encoder.c"
+
+#define BYTES 300
+#define BENCH_ROUNDS 20000
+#define REFILL_FRAMES 2000
+// WS2812 bit on the wire
+#define BIT_PERIOD_NS 1250
+
+static rmt_simple_encoder_config_t simple_config;
+static rmt_bytes_encoder_config_t bits_config;
+
+esp_err_t rmt_new_simple_encoder(const rmt_simple_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder)
+{
+    static rmt_encoder_t simple_encoder;
+    simple_config = *config;
+    *ret_encoder = &simple_encoder;
+    return ESP_OK;
+}
+
+esp_err_t rmt_new_bytes_encoder(const rmt_bytes_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder)
+{
+    static rmt_encoder_t bytes_encoder;
+    bits_config = *config;
+    *ret_encoder = &bytes_encoder;
+    return ESP_OK;
+}
+
+esp_err_t rmt_del_encoder(rmt_encoder_handle_t encoder)
+{
+    return ESP_OK;
+}
+
+esp_err_t rmt_encoder_reset(rmt_encoder_handle_t encoder)
+{
+    return ESP_OK;
+}
+
+// What the bytes encoder sends: one symbol per bit, MSB first
+static void reference_encode(const uint8_t *data, size_t size, uint16_t brightness, rmt_symbol_word_t *out)
+{
+    for (size_t i = 0; i < size; i++) {
+        uint8_t byte = led_strip_scale(data[i], brightness);
+        for (int bit = 7; bit >= 0; bit--) {
+            *out++ = byte & BIT(bit) ? bits_config.bit1 : bits_config.bit0;
+        }
+    }
+}
+
+/**
+ * @brief Run the callback as the simple encoder does, handing it `chunk` free symbols at a time
+ *
+ * @return symbols written, 0 if the callback misbehaved
+ */
+static size_t simple_encode(const uint8_t *data, size_t size, size_t chunk, rmt_symbol_word_t *out)
+{
+    size_t written = 0;
+    bool done = false;
+    while (!done) {
+        size_t n = simple_config.callback(data, size, written, chunk, out + written, &done, simple_config.arg);
+        if (n == 0 || n > chunk) {
+            return 0;
+        }
+        written += n;
+    }
+    return written;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void)
+{
+    int failed = 0;
+    static uint8_t data[BYTES];
+    static rmt_symbol_word_t ref[BYTES * 8], out[BYTES * 8];
+    srand(1);
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = rand();
+    }
+
+    const led_model_t models[] = {LED_MODEL_WS2812, LED_MODEL_SK6812};
+    const uint16_t brightness[] = {LED_STRIP_BRIGHTNESS_MAX, 128};
+    for (size_t m = 0; m < sizeof(models) / sizeof(models[0]); m++) {
+        led_strip_encoder_config_t config = {
+            .resolution = 10000000,
+            .led_model = models[m],
+        };
+        // the bytes encoder, for the bit symbols it's given
+        rmt_encoder_handle_t encoder;
+        if (rmt_new_led_strip_encoder(&config, &encoder) != ESP_OK) {
+            printf("FAIL: create encoder\n");
+            return 1;
+        }
+        encoder->del(encoder);
+        config.flags.nibble_encoder = true;
+        if (rmt_new_led_strip_encoder(&config, &encoder) != ESP_OK) {
+            printf("FAIL: create encoder\n");
+            return 1;
+        }
+        for (size_t b = 0; b < sizeof(brightness) / sizeof(brightness[0]); b++) {
+            rmt_led_strip_encoder_set_brightness(encoder, brightness[b], NULL);
+            reference_encode(data, BYTES, brightness[b], ref);
+            int bad_chunks = 0;
+            // the driver calls back once at least min_chunk_size symbols are free
+            for (size_t chunk = simple_config.min_chunk_size; chunk <= 70; chunk++) {
+                memset(out, 0, sizeof(out));
+                size_t written = simple_encode(data, BYTES, chunk, out);
+                bad_chunks += written != BYTES * 8 || memcmp(out, ref, sizeof(ref));
+            }
+            printf("%s, brightness %3u, free space %zu to 70 symbols: %d differ from the bytes encoder\n",
+                   models[m] == LED_MODEL_WS2812 ? "WS2812" : "SK6812", brightness[b], simple_config.min_chunk_size, bad_chunks);
+            failed |= bad_chunks != 0;
+        }
+        encoder->del(encoder);
+    }
+
+    // cost per byte with the whole frame free, as in a DMA buffer, with the SK6812 symbols left from above
+    led_strip_encoder_config_t config = { .resolution = 10000000, .led_model = LED_MODEL_SK6812, .flags.nibble_encoder = true };
+    rmt_encoder_handle_t encoder;
+    rmt_new_led_strip_encoder(&config, &encoder);
+    double t = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        data[r % BYTES] = r;
+        reference_encode(data, BYTES, LED_STRIP_BRIGHTNESS_MAX, out);
+        __asm__ volatile("" ::: "memory");
+    }
+    double bits_ns = (now_ns() - t) / BENCH_ROUNDS / BYTES;
+    t = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        data[r % BYTES] = r;
+        simple_encode(data, BYTES, BYTES * 8, out);
+        __asm__ volatile("" ::: "memory");
+    }
+    double nibble_ns = (now_ns() - t) / BENCH_ROUNDS / BYTES;
+    printf("encode per byte: bit by bit %.2f ns, nibble table %.2f ns (%.1fx)\n", bits_ns, nibble_ns, bits_ns / nibble_ns);
+
+    // Without DMA the RMT memory is refilled half a block at a time, the callback must fill one half before
+    // the other one is sent out. The refills slower than that deadline, on this host, are the underruns.
+    const size_t mem_blocks[] = {48, 64, 128};
+    for (size_t m = 0; m < sizeof(mem_blocks) / sizeof(mem_blocks[0]); m++) {
+        size_t half = mem_blocks[m] / 2;
+        double deadline_ns = half * BIT_PERIOD_NS;
+        double longest_ns = 0, total_ns = 0;
+        unsigned long refills = 0, underruns = 0;
+        for (int f = 0; f < REFILL_FRAMES; f++) {
+            size_t written = 0;
+            bool done = false;
+            while (!done) {
+                double start = now_ns();
+                written += simple_config.callback(data, BYTES, written, half, out, &done, simple_config.arg);
+                double refill_ns = now_ns() - start;
+                total_ns += refill_ns;
+                refills++;
+                underruns += refill_ns > deadline_ns;
+                if (refill_ns > longest_ns) {
+                    longest_ns = refill_ns;
+                }
+            }
+        }
+        printf("mem_block_symbols %3zu: %zu symbols refilled within %.1f us, %.3f us on average, longest %.2f us, "
+               "%lu underruns of %lu refills\n", mem_blocks[m], half, deadline_ns / 1000, total_ns / refills / 1000, longest_ns / 1000,
+               underruns, refills);
+        // the host may preempt the harness now and then, that isn't the encoder's doing
+        failed |= underruns > refills / 1000;
+    }
+    encoder->del(encoder);
+
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed;
+}
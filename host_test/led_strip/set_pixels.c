@@ -0,0 +1,124 @@
+/*
+ * Bulk set_pixels: same frame as a set_pixel call per pixel, and the time it saves, over strips from a handful
+ * of LEDs to a few thousand
+ */
+#include <stdio.h>
+#include <time.h>
+
+#include "led_strip.h"
+#include "led_strip_spi.h"
+#include "mock_spi.h"
+
+#define MAX_LEDS 3000
+// the same pixel work per length, so the short strips are timed over enough calls
+#define PIXEL_ROUNDS 2000000
+
+static const uint32_t lengths[] = {7, 300, 1000, MAX_LEDS};
+
+static led_strip_handle_t new_strip(led_pixel_format_t format, uint32_t leds)
+{
+    led_strip_config_t strip_config = {
+        .strip_gpio_num = 8,
+        .max_leds = leds,
+        .led_pixel_format = format,
+        .led_model = LED_MODEL_SK6812,
+    };
+    led_strip_spi_config_t spi_config = { .spi_bus = SPI2_HOST, .flags.with_dma = true };
+    led_strip_handle_t strip;
+    if (led_strip_new_spi_device(&strip_config, &spi_config, &strip) != ESP_OK) {
+        printf("FAIL: create strip\n");
+        exit(1);
+    }
+    return strip;
+}
+
+static size_t sent(led_strip_handle_t strip, uint8_t *out)
+{
+    size_t len;
+    host_spi_reset();
+    led_strip_refresh(strip);
+    const uint8_t *bus = host_spi_output(&len);
+    memcpy(out, bus, len);
+    return len;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief Checks set_pixels against set_pixel on a strip of a given length and times both
+ */
+static int check_length(uint32_t leds, const uint8_t *grb)
+{
+    int failed = 0;
+    static uint8_t ref[MAX_LEDS * 4 * 5], out[MAX_LEDS * 4 * 5];
+
+    // GRB strip: one call against one per pixel
+    led_strip_handle_t strip = new_strip(LED_PIXEL_FORMAT_GRB, leds);
+    for (uint32_t i = 0; i < leds; i++) {
+        led_strip_set_pixel(strip, i, grb[i * 3 + 1], grb[i * 3], grb[i * 3 + 2]);
+    }
+    size_t n = sent(strip, ref);
+    led_strip_set_pixels(strip, 0, leds, grb, LED_PIXEL_FORMAT_GRB);
+    size_t m = sent(strip, out);
+    bool same = n == m && !memcmp(ref, out, n);
+    failed |= !same;
+
+    int rounds = PIXEL_ROUNDS / leds;
+    double t = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (uint32_t i = 0; i < leds; i++) {
+            led_strip_set_pixel(strip, i, grb[i * 3 + 1], grb[i * 3], grb[i * 3 + 2]);
+        }
+    }
+    double single_ns = (now_ns() - t) / rounds;
+    t = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        led_strip_set_pixels(strip, 0, leds, grb, LED_PIXEL_FORMAT_GRB);
+    }
+    double bulk_ns = (now_ns() - t) / rounds;
+    printf("%4u LEDs: set_pixels vs set_pixel %s, set_pixel loop %.2f us, set_pixels %.2f us (%.1fx)\n", leds,
+           same ? "identical" : "DIFFERENT", single_ns / 1000, bulk_ns / 1000, single_ns / bulk_ns);
+    led_strip_del(strip);
+
+    // GRB source on a GRBW strip: white is turned off
+    strip = new_strip(LED_PIXEL_FORMAT_GRBW, leds);
+    for (uint32_t i = 0; i < leds; i++) {
+        led_strip_set_pixel_rgbw(strip, i, grb[i * 3 + 1], grb[i * 3], grb[i * 3 + 2], 0);
+    }
+    n = sent(strip, ref);
+    for (uint32_t i = 0; i < leds; i++) {
+        led_strip_set_pixel_rgbw(strip, i, 1, 2, 3, 255);
+    }
+    led_strip_set_pixels(strip, 0, leds, grb, LED_PIXEL_FORMAT_GRB);
+    m = sent(strip, out);
+    same = n == m && !memcmp(ref, out, n);
+    failed |= !same;
+
+    // the range is checked once
+    esp_err_t ret = led_strip_set_pixels(strip, leds - 1, 2, grb, LED_PIXEL_FORMAT_GRB);
+    failed |= ret != ESP_ERR_INVALID_ARG;
+    printf("           GRB source on a GRBW strip, white off: %s, range past the strip end: %s\n",
+           same ? "identical" : "DIFFERENT", ret == ESP_ERR_INVALID_ARG ? "refused" : "ACCEPTED");
+    led_strip_del(strip);
+    return failed;
+}
+
+int main(void)
+{
+    int failed = 0;
+    static uint8_t grb[MAX_LEDS * 3];
+    srand(1);
+    for (size_t i = 0; i < sizeof(grb); i++) {
+        grb[i] = rand();
+    }
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        failed |= check_length(lengths[i], grb);
+    }
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed;
+}
@@ -0,0 +1,142 @@
+/*
+ * SPI streaming mode: same bytes on the bus as the normal mode, DMA memory used, and the chunks refilled
+ * from the transaction-done callback without leaving the bus idle mid frame
+ */
+#include <stdio.h>
+#include <time.h>
+
+#include "led_strip.h"
+#include "led_strip_spi.h"
+#include "mock_spi.h"
+
+static int done_count;
+
+static bool on_refresh_done(led_strip_handle_t strip, void *user_ctx)
+{
+    done_count++;
+    return false;
+}
+
+static led_strip_handle_t new_strip(uint32_t leds, bool streaming)
+{
+    led_strip_config_t strip_config = {
+        .strip_gpio_num = 8,
+        .max_leds = leds,
+        .led_pixel_format = LED_PIXEL_FORMAT_GRB,
+        .led_model = LED_MODEL_WS2812,
+    };
+    led_strip_spi_config_t spi_config = { .spi_bus = SPI2_HOST, .flags.with_dma = true, .flags.streaming = streaming };
+    led_strip_handle_t strip;
+    host_dma_peak = host_dma_bytes;
+    if (led_strip_new_spi_device(&strip_config, &spi_config, &strip) != ESP_OK) {
+        printf("FAIL: create strip\n");
+        exit(1);
+    }
+    led_strip_event_callbacks_t cbs = { .on_refresh_done = on_refresh_done };
+    led_strip_register_event_callbacks(strip, &cbs, NULL);
+    return strip;
+}
+
+/**
+ * @brief Send a frame with the given settings, the bytes sent are left in `out`
+ */
+static size_t send(uint32_t leds, bool streaming, const uint8_t *pixels, uint32_t prefix, uint16_t brightness, uint8_t *out)
+{
+    led_strip_handle_t strip = new_strip(leds, streaming);
+    size_t dma = host_dma_peak;
+    if (brightness != LED_STRIP_BRIGHTNESS_MAX) {
+        led_strip_set_brightness(strip, brightness, false);
+    }
+    if (prefix) {
+        led_strip_set_refresh_mode(strip, LED_STRIP_REFRESH_PREFIX);
+        led_strip_refresh(strip);
+    }
+    led_strip_set_pixels(strip, 0, prefix ? prefix : leds, pixels, LED_PIXEL_FORMAT_GRB);
+    host_spi_reset();
+    done_count = 0;
+    led_strip_refresh(strip);
+    size_t len;
+    const uint8_t *bus = host_spi_output(&len);
+    memcpy(out, bus, len);
+    host_spi_stats_t stats;
+    host_spi_stats(&stats);
+    if (!prefix && brightness == LED_STRIP_BRIGHTNESS_MAX) {
+        printf("%-9s %5u LEDs: %6zu B DMA, %3u transactions, %6zu B sent, %d done callback\n",
+               streaming ? "streaming" : "normal", leds, dma, stats.transactions, len, done_count);
+    }
+    led_strip_del(strip);
+    return len;
+}
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+int main(void)
+{
+    int failed = 0;
+    static uint8_t pixels[5000 * 3];
+    static uint8_t ref[5000 * 3 * 5], out[5000 * 3 * 5];
+    srand(1);
+    for (size_t i = 0; i < sizeof(pixels); i++) {
+        pixels[i] = rand();
+    }
+
+    // bytes on the bus, whole frames, around the chunk size
+    const uint32_t sizes[] = {1, 31, 32, 33, 1000, 5000};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size_t n = send(sizes[i], false, pixels, 0, LED_STRIP_BRIGHTNESS_MAX, ref);
+        size_t m = send(sizes[i], true, pixels, 0, LED_STRIP_BRIGHTNESS_MAX, out);
+        if (n != m || memcmp(ref, out, n) || done_count != 1) {
+            printf("FAIL: %u LEDs streamed differently\n", sizes[i]);
+            failed = 1;
+        }
+    }
+    // prefix refresh and brightness
+    size_t n = send(1000, false, pixels, 100, LED_STRIP_BRIGHTNESS_MAX, ref);
+    size_t m = send(1000, true, pixels, 100, LED_STRIP_BRIGHTNESS_MAX, out);
+    printf("prefix refresh: %s\n", n == m && !memcmp(ref, out, n) ? "identical" : "DIFFERENT");
+    failed |= n != m || memcmp(ref, out, n);
+    n = send(1000, false, pixels, 0, 100, ref);
+    m = send(1000, true, pixels, 0, 100, out);
+    printf("brightness: %s\n", n == m && !memcmp(ref, out, n) ? "identical" : "DIFFERENT");
+    failed |= n != m || memcmp(ref, out, n);
+
+    // async refresh at the wire speed: returns at once, and the refill task keeps chunks queued ahead of the bus,
+    // on a long strip too where the frame is 5 times as many chunks
+    host_spi_wire_time = true;
+    const uint32_t wire_sizes[] = {1000, 5000};
+    for (size_t i = 0; i < sizeof(wire_sizes) / sizeof(wire_sizes[0]); i++) {
+        uint32_t leds = wire_sizes[i];
+        led_strip_handle_t strip = new_strip(leds, true);
+        led_strip_set_pixels(strip, 0, leds, pixels, LED_PIXEL_FORMAT_GRB);
+        const int frames = 20;
+        double call_us = 0;
+        double t = now_us();
+        host_spi_reset();
+        done_count = 0;
+        for (int f = 0; f < frames; f++) {
+            double c = now_us();
+            if (led_strip_refresh_async(strip) != ESP_OK) {
+                printf("FAIL: refresh_async\n");
+                return 1;
+            }
+            call_us += now_us() - c;
+            led_strip_wait_refresh_done(strip, -1);
+        }
+        double frame_us = (now_us() - t) / frames;
+        host_spi_stats_t stats;
+        host_spi_stats(&stats);
+        printf("%u LEDs async at wire speed: refresh_async returns in %.0f us, %.0f us per frame (%.1f fps), "
+               "bus idle %u times in %d frames, %d done callbacks\n", leds, call_us / frames, frame_us, 1e6 / frame_us,
+               stats.idle, frames, done_count);
+        failed |= stats.idle != frames || done_count != frames;
+        led_strip_del(strip);
+    }
+
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed;
+}
@@ -0,0 +1,133 @@
+/*
+ * SPI encoding: the waveform sent on the bus, decoded into LED bits, meets the datasheet timing of the
+ * LED model at every clock source the driver accepts
+ */
+#include <stdio.h>
+
+#include "led_strip_spi_dev.c"
+#include "mock_spi.h"
+
+#define LEDS 8
+
+static const char *model_name[LED_MODEL_INVALID] = {
+    [LED_MODEL_WS2812] = "WS2812",
+    [LED_MODEL_SK6812] = "SK6812",
+};
+
+/**
+ * @brief Decode the bits on the bus into LED bits and check each one against the model timing
+ *
+ * Every LED bit starts with a rising edge, its high time tells a 0 from a 1. The low time of the last bit
+ * runs into the reset time, so it isn't checked.
+ *
+ * @return number of LED bits out of the limits or decoded to the wrong value
+ */
+static int check_waveform(const led_strip_spi_timing_t *timing, const uint8_t *bus, size_t len, double symbol_ns,
+                          const uint8_t *pixels, size_t bits, double *t0h_ns, double *t1h_ns)
+{
+    int errors = 0;
+    size_t pos = 0;
+    size_t total = len * 8;
+    size_t bit = 0;
+#define LINE(p) ((bus[(p) / 8] >> (7 - (p) % 8)) & 1)
+    while (pos < total && bit < bits) {
+        if (!LINE(pos)) {
+            errors++;
+            break;
+        }
+        size_t high = 0;
+        while (pos + high < total && LINE(pos + high)) {
+            high++;
+        }
+        size_t low = 0;
+        while (pos + high + low < total && !LINE(pos + high + low)) {
+            low++;
+        }
+        bool last = pos + high + low == total;
+        double high_ns = high * symbol_ns;
+        double period_ns = (high + low) * symbol_ns;
+        bool value = pixels[bit / 8] & BIT(7 - bit % 8);
+        bool ok;
+        if (value) {
+            *t1h_ns = high_ns;
+            ok = high_ns >= timing->t1h_min && high_ns <= timing->t1h_max;
+        } else {
+            *t0h_ns = high_ns;
+            ok = high_ns >= timing->t0h_min && high_ns <= timing->t0h_max;
+        }
+        if (!last) {
+            ok = ok && low * symbol_ns >= timing->tl_min && period_ns >= timing->period_min && period_ns <= timing->period_max;
+        }
+        errors += !ok;
+        pos += high + low;
+        bit++;
+    }
+#undef LINE
+    return errors + (bit != bits);
+}
+
+int main(void)
+{
+    int failed = 0;
+    static uint8_t pixels[LEDS * 3] = {0x00, 0xFF, 0x55, 0xAA, 0x0F, 0xF0, 0x81, 0x7E};
+    srand(1);
+    for (size_t i = 8; i < sizeof(pixels); i++) {
+        pixels[i] = rand();
+    }
+
+    for (led_model_t model = LED_MODEL_WS2812; model < LED_MODEL_INVALID; model++) {
+        const led_strip_spi_timing_t *timing = &s_led_timing[model];
+        int supported = 0;
+        int refused = 0;
+        int bad_clocks = 0;
+        int symbols_used[SPI_MAX_SYMBOLS_PER_BIT + 1] = {0};
+        // source clocks from 2 to 160 MHz, 250 kHz apart
+        for (uint32_t src = 2000000; src <= 160000000; src += 250000) {
+            host_spi_src_hz = src;
+            led_strip_config_t strip_config = {
+                .strip_gpio_num = 8,
+                .max_leds = LEDS,
+                .led_pixel_format = LED_PIXEL_FORMAT_GRB,
+                .led_model = model,
+            };
+            led_strip_spi_config_t spi_config = { .spi_bus = SPI2_HOST, .flags.with_dma = true };
+            led_strip_handle_t strip;
+            esp_err_t ret = led_strip_new_spi_device(&strip_config, &spi_config, &strip);
+            if (ret == ESP_ERR_NOT_SUPPORTED) {
+                refused++;
+                continue;
+            }
+            if (ret != ESP_OK) {
+                printf("FAIL: create %s strip at %u Hz\n", model_name[model], src);
+                return 1;
+            }
+            supported++;
+            led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
+            double khz = 1e6 / host_spi_bit_ns();
+            symbols_used[spi_strip->bytes_per_color]++;
+
+            host_spi_reset();
+            led_strip_set_pixels(strip, 0, LEDS, pixels, LED_PIXEL_FORMAT_GRB);
+            led_strip_refresh(strip);
+            size_t len;
+            const uint8_t *bus = host_spi_output(&len);
+            double t0h_ns = 0, t1h_ns = 0;
+            int errors = check_waveform(timing, bus, len, host_spi_bit_ns(), pixels, sizeof(pixels) * 8, &t0h_ns, &t1h_ns);
+            if (errors) {
+                printf("%s at %.1f kHz, %u symbols: %d bits out of the timing\n", model_name[model], khz, spi_strip->bytes_per_color, errors);
+                bad_clocks++;
+            }
+            if (src == 80000000) {
+                printf("%s, 80 MHz source: %u SPI bits per LED bit at %.1f kHz, T0H %.0f ns, T1H %.0f ns, period %.0f ns\n",
+                       model_name[model], spi_strip->bytes_per_color, khz, t0h_ns, t1h_ns, spi_strip->bytes_per_color * 1e6 / khz);
+            }
+            led_strip_del(strip);
+        }
+        printf("%s: %d source clocks accepted (%d with 3, %d with 4, %d with 5 SPI bits per LED bit), %d refused, "
+               "%d out of the timing\n", model_name[model], supported, symbols_used[3], symbols_used[4], symbols_used[5], refused, bad_clocks);
+        failed |= bad_clocks != 0 || symbols_used[2] != 0 || supported == 0;
+    }
+
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed;
+}
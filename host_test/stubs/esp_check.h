@@ -0,0 +1,7 @@
+#pragma once
+#include "esp_log.h"
+#define ESP_RETURN_ON_FALSE(a, err, tag, fmt, ...) do { if (!(a)) { ESP_LOGD(tag, fmt, ##__VA_ARGS__); return err; } } while (0)
+#define ESP_RETURN_ON_ERROR(x, tag, fmt, ...) do { esp_err_t e_ = (x); if (e_ != ESP_OK) { ESP_LOGD(tag, fmt, ##__VA_ARGS__); return e_; } } while (0)
+#define ESP_GOTO_ON_FALSE(a, err, goto_tag, tag, fmt, ...) do { if (!(a)) { ret = err; ESP_LOGD(tag, fmt, ##__VA_ARGS__); goto goto_tag; } } while (0)
+#define ESP_GOTO_ON_ERROR(x, goto_tag, tag, fmt, ...) do { esp_err_t e_ = (x); if (e_ != ESP_OK) { ret = e_; ESP_LOGD(tag, fmt, ##__VA_ARGS__); goto goto_tag; } } while (0)
+#define ESP_RETURN_ON_FALSE_ISR ESP_RETURN_ON_FALSE
@@ -0,0 +1,17 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#define MALLOC_CAP_DEFAULT (1<<12)
+#define MALLOC_CAP_INTERNAL (1<<11)
+#define MALLOC_CAP_DMA (1<<3)
+#define MALLOC_CAP_8BIT (1<<2)
+#define MALLOC_CAP_SPIRAM (1<<10)
+void *heap_caps_calloc(size_t, size_t, uint32_t);
+void *heap_caps_malloc(size_t, uint32_t);
+size_t heap_caps_get_free_size(uint32_t);
+void *heap_caps_calloc_prefer(size_t n, size_t size, size_t num, ...);
+// DMA capable memory in use and its peak, free() is routed through host_free to keep count
+extern size_t host_dma_bytes, host_dma_peak;
+void host_free(void *ptr);
+#define free host_free
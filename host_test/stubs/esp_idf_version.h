@@ -0,0 +1,7 @@
+#pragma once
+#define ESP_IDF_VERSION_VAL(a,b,c) (((a)<<16)|((b)<<8)|(c))
+#ifdef STUB_IDF4
+#define ESP_IDF_VERSION ESP_IDF_VERSION_VAL(4,4,0)
+#else
+#define ESP_IDF_VERSION ESP_IDF_VERSION_VAL(5,3,1)
+#endif
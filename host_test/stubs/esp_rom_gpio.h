@@ -0,0 +1,4 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+void esp_rom_gpio_connect_out_signal(uint32_t, uint32_t, bool, bool);
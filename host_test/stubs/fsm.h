@@ -0,0 +1,37 @@
+#pragma once
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+#include "freertos/queue.h"
+typedef struct fsm_t { void *current_data; int current_state; void *transitions; } fsm_t;
+struct fsm_actor_t { int x; };
+typedef struct fsm_state_t { int x; } fsm_state_t;
+typedef void (*fsm_action_t)(fsm_t *self, void *data);
+#define FSM_ST_FIRST 1
+#define FSM_ST_NONE 0
+#define FSM_EV_FIRST 1
+#define FSM_TIMEOUT_EV 0
+#define FSM_STATES_INIT(n)
+#define FSM_CREATE_STATE(n, id, parent, sub, entry, run, exit) static fsm_action_t n##_##id##_actions[] __attribute__((unused)) = { entry, run, exit }; static fsm_state_t n##_##id##_st __attribute__((unused));
+#define FSM_STATES_END()
+#define FSM_TRANSITIONS_INIT(n) static int n##_tr[] = {
+#define FSM_TRANSITION_CREATE(n, a, e, b) a, e, b,
+#define FSM_TRANSITION_WORK_CREATE(n, a, e, b, w) a, e, b, (w != 0),
+#define FSM_TRANSITIONS_END() };
+#define FSM_TRANSITIONS_GET(n) (n##_tr)
+#define FSM_TRANSITIONS_SIZE(n) (sizeof(n##_tr))
+#define FSM_STATE_GET(n, id) (n##_##id##_st)
+#define FSM_ACTOR_INIT(n) static struct fsm_actor_t n[] = {
+#define FSM_ACTOR_CREATE(st, a, b, c) {st},
+#define FSM_ACTOR_END() };
+#define FSM_ACTOR_GET(n) (n)
+#define FSM_ACTOR_SIZE(n) (sizeof(n)/sizeof(n[0]))
+int fsm_init(fsm_t *, void *, int, int, int, fsm_state_t *, void *);
+void fsm_timed_event_set(fsm_state_t *, uint32_t);
+int fsm_dispatch(fsm_t *, int, void *);
+int fsm_run(fsm_t *);
+void fsm_ticks_hook(fsm_t *);
+int fsm_state_get(fsm_t *);
+int fsm_actor_link(fsm_t *, struct fsm_actor_t *, int);
+void fsm_music(void);
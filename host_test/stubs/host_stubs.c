@@ -0,0 +1,427 @@
+/*
+ * Host implementations of the ESP-IDF and FreeRTOS calls the components use, on top of pthreads.
+ *
+ * Tasks are threads, notifications and semaphores are condition variables and ticks are milliseconds.
+ * Every function is weak, so a harness can replace the ones it needs to drive itself, e.g. a virtual clock.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_rom_gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "soc/spi_periph.h"
+#include "fsm.h"
+
+#undef free
+
+#define HOST_WEAK __attribute__((weak))
+
+//------------------------------------------------------//
+//  Heap                                                //
+//------------------------------------------------------//
+
+#define HOST_DMA_BLOCKS 256
+
+size_t host_dma_bytes, host_dma_peak;
+
+static struct {
+    void *ptr;
+    size_t size;
+} dma_blocks[HOST_DMA_BLOCKS];
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *host_alloc(size_t size, uint32_t caps)
+{
+    void *ptr = calloc(1, size ? size : 1);
+    if (ptr == NULL || !(caps & MALLOC_CAP_DMA)) {
+        return ptr;
+    }
+    pthread_mutex_lock(&heap_lock);
+    for (int i = 0; i < HOST_DMA_BLOCKS; i++) {
+        if (dma_blocks[i].ptr == NULL) {
+            dma_blocks[i].ptr = ptr;
+            dma_blocks[i].size = size;
+            host_dma_bytes += size;
+            if (host_dma_bytes > host_dma_peak) {
+                host_dma_peak = host_dma_bytes;
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&heap_lock);
+    return ptr;
+}
+
+void host_free(void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&heap_lock);
+    for (int i = 0; i < HOST_DMA_BLOCKS; i++) {
+        if (dma_blocks[i].ptr == ptr) {
+            host_dma_bytes -= dma_blocks[i].size;
+            dma_blocks[i].ptr = NULL;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&heap_lock);
+    free(ptr);
+}
+
+HOST_WEAK void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    return host_alloc(n * size, caps);
+}
+
+HOST_WEAK void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    return host_alloc(size, caps);
+}
+
+HOST_WEAK void *heap_caps_calloc_prefer(size_t n, size_t size, size_t num, ...)
+{
+    // the first capabilities given are the preferred ones, PSRAM for the callers here
+    return host_alloc(n * size, MALLOC_CAP_SPIRAM);
+}
+
+HOST_WEAK size_t heap_caps_get_free_size(uint32_t caps)
+{
+    return SIZE_MAX;
+}
+
+//------------------------------------------------------//
+//  Time                                                //
+//------------------------------------------------------//
+
+static int64_t host_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+HOST_WEAK int64_t esp_timer_get_time(void)
+{
+    return host_now_us();
+}
+
+HOST_WEAK void esp_rom_delay_us(uint32_t us)
+{
+    int64_t end = esp_timer_get_time() + us;
+    while (esp_timer_get_time() < end) {
+    }
+}
+
+// esp_timer instances never fire on their own, a harness that needs them drives the callbacks
+struct esp_timer {
+    esp_timer_create_args_t args;
+    bool active;
+};
+
+HOST_WEAK esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *ret)
+{
+    struct esp_timer *timer = calloc(1, sizeof(struct esp_timer));
+    if (timer == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    timer->args = *args;
+    *ret = timer;
+    return ESP_OK;
+}
+
+HOST_WEAK esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t us)
+{
+    timer->active = true;
+    return ESP_OK;
+}
+
+HOST_WEAK esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t us)
+{
+    // same lower bound as esp_timer
+    if (us < 50) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    timer->active = true;
+    return ESP_OK;
+}
+
+HOST_WEAK esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = false;
+    return ESP_OK;
+}
+
+HOST_WEAK esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    free(timer);
+    return ESP_OK;
+}
+
+HOST_WEAK bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    return timer->active;
+}
+
+//------------------------------------------------------//
+//  Tasks                                               //
+//------------------------------------------------------//
+
+struct tskTaskControlBlock {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+    TaskFunction_t fn;
+    void *arg;
+};
+
+static __thread TaskHandle_t current_task;
+
+static void host_cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static TaskHandle_t host_task_new(void)
+{
+    TaskHandle_t task = calloc(1, sizeof(struct tskTaskControlBlock));
+    pthread_mutex_init(&task->lock, NULL);
+    host_cond_init(&task->cond);
+    return task;
+}
+
+static TaskHandle_t host_task_self(void)
+{
+    // threads not created with xTaskCreate, like main, get a task on first use
+    if (current_task == NULL) {
+        current_task = host_task_new();
+        current_task->thread = pthread_self();
+    }
+    return current_task;
+}
+
+static void host_unlock(void *lock)
+{
+    pthread_mutex_unlock(lock);
+}
+
+/**
+ * @brief Wait on a condition until it's signalled or the ticks run out, the lock is held
+ *
+ * @return false on timeout
+ */
+static bool host_cond_wait(pthread_cond_t *cond, pthread_mutex_t *lock, const struct timespec *deadline)
+{
+    int ret;
+    // a task deleted while waiting must leave the lock free
+    pthread_cleanup_push(host_unlock, lock);
+    ret = deadline ? pthread_cond_timedwait(cond, lock, deadline) : pthread_cond_wait(cond, lock);
+    pthread_cleanup_pop(0);
+    return ret != ETIMEDOUT;
+}
+
+static struct timespec *host_deadline(TickType_t ticks, struct timespec *ts)
+{
+    if (ticks == portMAX_DELAY) {
+        return NULL;
+    }
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += ticks / 1000;
+    ts->tv_nsec += (long)(ticks % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+static void *host_task_main(void *arg)
+{
+    current_task = arg;
+    current_task->fn(current_task->arg);
+    return NULL;
+}
+
+HOST_WEAK BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *ret)
+{
+    TaskHandle_t task = host_task_new();
+    task->fn = fn;
+    task->arg = arg;
+    // the handle is given out first, the task may be notified as soon as it runs
+    if (ret) {
+        *ret = task;
+    }
+    if (pthread_create(&task->thread, NULL, host_task_main, task) != 0) {
+        return pdFALSE;
+    }
+    pthread_detach(task->thread);
+    return pdPASS;
+}
+
+HOST_WEAK void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL || task == current_task) {
+        pthread_exit(NULL);
+    }
+    pthread_cancel(task->thread);
+}
+
+HOST_WEAK void vTaskDelay(TickType_t ticks)
+{
+    usleep(ticks * 1000);
+}
+
+HOST_WEAK TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(host_now_us() / 1000);
+}
+
+HOST_WEAK uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    TaskHandle_t task = host_task_self();
+    struct timespec ts;
+    struct timespec *deadline = host_deadline(ticks, &ts);
+    pthread_mutex_lock(&task->lock);
+    while (task->notify == 0 && ticks != 0 && host_cond_wait(&task->cond, &task->lock, deadline)) {
+    }
+    uint32_t value = task->notify;
+    if (value) {
+        task->notify = clear ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+HOST_WEAK BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+HOST_WEAK void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken)
+{
+    xTaskNotifyGive(task);
+    if (woken) {
+        *woken = pdTRUE;
+    }
+}
+
+//------------------------------------------------------//
+//  Semaphores                                          //
+//------------------------------------------------------//
+
+struct host_sem {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t count;
+};
+
+static SemaphoreHandle_t host_sem_new(uint32_t count)
+{
+    SemaphoreHandle_t sem = calloc(1, sizeof(struct host_sem));
+    if (sem == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&sem->lock, NULL);
+    host_cond_init(&sem->cond);
+    sem->count = count;
+    return sem;
+}
+
+// no priority inheritance nor owner checks, a mutex is a binary semaphore given at creation
+HOST_WEAK SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return host_sem_new(1);
+}
+
+HOST_WEAK SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return host_sem_new(0);
+}
+
+HOST_WEAK BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    struct timespec ts;
+    struct timespec *deadline = host_deadline(ticks, &ts);
+    pthread_mutex_lock(&sem->lock);
+    while (sem->count == 0 && ticks != 0 && host_cond_wait(&sem->cond, &sem->lock, deadline)) {
+    }
+    BaseType_t taken = sem->count != 0;
+    if (taken) {
+        sem->count--;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return taken ? pdTRUE : pdFALSE;
+}
+
+HOST_WEAK BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    pthread_mutex_lock(&sem->lock);
+    BaseType_t given = sem->count == 0;
+    if (given) {
+        sem->count = 1;
+        pthread_cond_signal(&sem->cond);
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return given ? pdTRUE : pdFALSE;
+}
+
+HOST_WEAK void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    free(sem);
+}
+
+//------------------------------------------------------//
+//  Misc                                                //
+//------------------------------------------------------//
+
+const spi_signal_conn_t spi_periph_signal[4];
+
+HOST_WEAK void esp_rom_gpio_connect_out_signal(uint32_t gpio, uint32_t signal, bool out_inv, bool oen_inv)
+{
+}
+
+HOST_WEAK const char *esp_err_to_name(esp_err_t err)
+{
+    return err == ESP_OK ? "ESP_OK" : "ESP_ERR";
+}
+
+// The fsm library is a submodule, harnesses that need its behaviour implement these themselves
+HOST_WEAK int fsm_init(fsm_t *fsm, void *transitions, int size, int events, int period, fsm_state_t *root, void *data)
+{
+    return 0;
+}
+
+HOST_WEAK int fsm_dispatch(fsm_t *fsm, int ev, void *data)
+{
+    return 0;
+}
+
+HOST_WEAK int fsm_run(fsm_t *fsm)
+{
+    return 0;
+}
+
+HOST_WEAK int fsm_state_get(fsm_t *fsm)
+{
+    return 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+typedef int rmt_channel_t;
+typedef struct { union { struct { uint32_t duration0 :15; uint32_t level0 :1; uint32_t duration1 :15; uint32_t level1 :1; }; uint32_t val; }; } rmt_item32_t;
+typedef struct { rmt_channel_t channel; int clk_div; int mem_block_num; } rmt_config_t;
+#define RMT_DEFAULT_CONFIG_TX(gpio, ch) { .channel = (ch), .clk_div = 80, .mem_block_num = 1 }
+typedef void (*sample_to_rmt_t)(const void *src, rmt_item32_t *dest, size_t src_size, size_t wanted_num, size_t *translated_size, size_t *item_num);
+typedef void (*rmt_tx_end_fn_t)(rmt_channel_t channel, void *arg);
+esp_err_t rmt_config(const rmt_config_t *);
+esp_err_t rmt_driver_install(rmt_channel_t, size_t, int);
+esp_err_t rmt_driver_uninstall(rmt_channel_t);
+esp_err_t rmt_get_counter_clock(rmt_channel_t, uint32_t *);
+esp_err_t rmt_translator_init(rmt_channel_t, sample_to_rmt_t);
+esp_err_t rmt_write_sample(rmt_channel_t, const uint8_t *, size_t, bool);
+esp_err_t rmt_wait_tx_done(rmt_channel_t, TickType_t);
@@ -0,0 +1,222 @@
+/*
+ * Mock SPI master driver for the led_strip SPI backend, see mock_spi.h
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "driver/spi_master.h"
+#include "mock_spi.h"
+
+#undef free
+
+#define HOST_SPI_RING 64
+
+uint32_t host_spi_src_hz = 80000000;
+bool host_spi_wire_time;
+
+struct spi_device_t {
+    spi_device_interface_config_t config;
+    int actual_khz;
+    uint32_t div;
+    pthread_t bus;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    spi_transaction_t *queued[HOST_SPI_RING];   // queued, the head one is on the bus
+    spi_transaction_t *done[HOST_SPI_RING];     // sent, not collected yet
+    uint32_t queued_head, queued_tail;
+    uint32_t done_head, done_tail;
+    bool stop;
+};
+
+static struct spi_device_t device;
+static bool device_added;
+static uint8_t *output;
+static size_t output_len, output_cap;
+static host_spi_stats_t stats;
+
+static uint32_t in_flight(void)
+{
+    return (device.queued_tail - device.queued_head) + (device.done_tail - device.done_head);
+}
+
+static void capture(const spi_transaction_t *trans)
+{
+    size_t len = trans->length / 8;
+    if (output_len + len > output_cap) {
+        output_cap = (output_len + len) * 2;
+        output = realloc(output, output_cap);
+    }
+    memcpy(output + output_len, trans->tx_buffer, len);
+    output_len += len;
+}
+
+static void *bus_main(void *arg)
+{
+    pthread_mutex_lock(&device.lock);
+    for (;;) {
+        while (!device.stop && device.queued_head == device.queued_tail) {
+            pthread_cond_wait(&device.cond, &device.lock);
+        }
+        if (device.stop) {
+            break;
+        }
+        spi_transaction_t *trans = device.queued[device.queued_head % HOST_SPI_RING];
+        pthread_mutex_unlock(&device.lock);
+
+        if (host_spi_wire_time) {
+            uint64_t ns = (uint64_t)trans->length * 1000000 / device.actual_khz;
+            struct timespec ts = { .tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000 };
+            nanosleep(&ts, NULL);
+        }
+        capture(trans);
+        if (device.config.post_cb) {
+            device.config.post_cb(trans);
+        }
+
+        pthread_mutex_lock(&device.lock);
+        device.queued_head++;
+        device.done[device.done_tail++ % HOST_SPI_RING] = trans;
+        stats.transactions++;
+        if (device.queued_head == device.queued_tail) {
+            stats.idle++;
+        }
+        pthread_cond_broadcast(&device.cond);
+    }
+    pthread_mutex_unlock(&device.lock);
+    return NULL;
+}
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *config, int dma)
+{
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_free(spi_host_device_t host)
+{
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *config, spi_device_handle_t *ret)
+{
+    if (device_added || config->queue_size > HOST_SPI_RING / 2) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    memset(&device, 0, sizeof(device));
+    device.config = *config;
+    // integer divider of the source clock, rounded to the next frequency down
+    uint32_t div = (host_spi_src_hz + config->clock_speed_hz - 1) / config->clock_speed_hz;
+    device.div = div;
+    device.actual_khz = host_spi_src_hz / div / 1000;
+    pthread_mutex_init(&device.lock, NULL);
+    pthread_cond_init(&device.cond, NULL);
+    pthread_create(&device.bus, NULL, bus_main, NULL);
+    device_added = true;
+    *ret = &device;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle)
+{
+    pthread_mutex_lock(&handle->lock);
+    handle->stop = true;
+    pthread_cond_broadcast(&handle->cond);
+    pthread_mutex_unlock(&handle->lock);
+    pthread_join(handle->bus, NULL);
+    device_added = false;
+    return ESP_OK;
+}
+
+esp_err_t spi_device_get_actual_freq(spi_device_handle_t handle, int *freq_khz)
+{
+    *freq_khz = handle->actual_khz;
+    return ESP_OK;
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans, TickType_t ticks)
+{
+    pthread_mutex_lock(&handle->lock);
+    // the driver keeps queue_size transactions in each of its queues, only the waits are left out here
+    if (handle->queued_tail - handle->queued_head >= handle->config.queue_size ||
+            handle->done_tail - handle->done_head >= handle->config.queue_size) {
+        pthread_mutex_unlock(&handle->lock);
+        fprintf(stderr, "mock spi: transaction queue full\n");
+        return ESP_ERR_TIMEOUT;
+    }
+    handle->queued[handle->queued_tail++ % HOST_SPI_RING] = trans;
+    if (in_flight() > stats.queue_peak) {
+        stats.queue_peak = in_flight();
+    }
+    pthread_cond_broadcast(&handle->cond);
+    pthread_mutex_unlock(&handle->lock);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans, TickType_t ticks)
+{
+    pthread_mutex_lock(&handle->lock);
+    if (ticks != 0 && handle->done_head == handle->done_tail && handle->queued_head == handle->queued_tail) {
+        pthread_mutex_unlock(&handle->lock);
+        fprintf(stderr, "mock spi: waiting for a result with nothing queued\n");
+        return ESP_ERR_TIMEOUT;
+    }
+    while (ticks != 0 && handle->done_head == handle->done_tail) {
+        pthread_cond_wait(&handle->cond, &handle->lock);
+    }
+    esp_err_t ret = ESP_ERR_TIMEOUT;
+    if (handle->done_head != handle->done_tail) {
+        *trans = handle->done[handle->done_head++ % HOST_SPI_RING];
+        ret = ESP_OK;
+    }
+    pthread_mutex_unlock(&handle->lock);
+    return ret;
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *trans)
+{
+    spi_transaction_t *done = NULL;
+    esp_err_t ret = spi_device_queue_trans(handle, trans, portMAX_DELAY);
+    if (ret == ESP_OK) {
+        ret = spi_device_get_trans_result(handle, &done, portMAX_DELAY);
+    }
+    return ret;
+}
+
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t *trans)
+{
+    return spi_device_transmit(handle, trans);
+}
+
+esp_err_t spi_device_acquire_bus(spi_device_handle_t handle, TickType_t ticks)
+{
+    return ESP_OK;
+}
+
+void spi_device_release_bus(spi_device_handle_t handle)
+{
+}
+
+double host_spi_bit_ns(void)
+{
+    return 1e9 * device.div / host_spi_src_hz;
+}
+
+const uint8_t *host_spi_output(size_t *len)
+{
+    *len = output_len;
+    return output;
+}
+
+void host_spi_reset(void)
+{
+    output_len = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+void host_spi_stats(host_spi_stats_t *ret)
+{
+    *ret = stats;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Mock SPI master, one device at a time
+ *
+ * A bus thread sends the queued transactions in order, calls the device post_cb from its "ISR" and
+ * hands them back through the result queue, like the driver does. Every byte sent is captured.
+ */
+typedef struct {
+    uint32_t transactions;  // transactions sent
+    uint32_t idle;          // times the bus ran out of queued transactions
+    uint32_t queue_peak;    // most transactions queued or waiting to be collected at once
+} host_spi_stats_t;
+
+// Clock the SPI peripheral divides down to make the device clock, the actual frequency is reported from it
+extern uint32_t host_spi_src_hz;
+// Keep each transaction on the bus for its wire time at the actual clock, off by default
+extern bool host_spi_wire_time;
+
+// Time a bit takes on the wire at the actual clock, exact where the driver only gets the clock in kHz
+double host_spi_bit_ns(void);
+const uint8_t *host_spi_output(size_t *len);
+void host_spi_reset(void);
+void host_spi_stats(host_spi_stats_t *stats);
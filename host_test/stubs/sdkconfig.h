@@ -0,0 +1,5 @@
+#pragma once
+#define CONFIG_IDF_TARGET_ESP32 1
+#define CONFIG_FREERTOS_HZ 1000
+#define CONFIG_LED_STRIP_FRAME_CACHE_SLOTS 2
+#define CONFIG_LED_STRIP_SPI_STREAM_TASK_PRIORITY 10
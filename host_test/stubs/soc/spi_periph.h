@@ -0,0 +1,3 @@
+#pragma once
+typedef struct { int spid_out; } spi_signal_conn_t;
+extern const spi_signal_conn_t spi_periph_signal[];
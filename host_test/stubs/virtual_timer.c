@@ -0,0 +1,116 @@
+/*
+ * Virtual esp_timer clock for the harnesses counting timer wakeups, see virtual_timer.h
+ */
+#include <stdlib.h>
+
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "virtual_timer.h"
+
+struct esp_timer {
+    esp_timer_create_args_t args;
+    bool active;
+    int64_t due_us;
+    uint64_t period_us;     // 0 for a one-shot timer
+    struct esp_timer *next;
+};
+
+static int64_t now_us;
+static struct esp_timer *timers;
+
+int64_t esp_timer_get_time(void)
+{
+    return now_us;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *ret)
+{
+    struct esp_timer *timer = calloc(1, sizeof(struct esp_timer));
+    if (timer == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    timer->args = *args;
+    timer->next = timers;
+    timers = timer;
+    *ret = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t us)
+{
+    if (timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = true;
+    timer->due_us = now_us + us;
+    timer->period_us = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t us)
+{
+    // same lower bound as esp_timer
+    if (us < 50) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = true;
+    timer->due_us = now_us + us;
+    timer->period_us = us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    for (struct esp_timer **link = &timers; *link != NULL; link = &(*link)->next) {
+        if (*link == timer) {
+            *link = timer->next;
+            break;
+        }
+    }
+    free(timer);
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    return timer->active;
+}
+
+void virtual_timer_run_until(int64_t until_us)
+{
+    for (;;) {
+        struct esp_timer *first = NULL;
+        for (struct esp_timer *timer = timers; timer != NULL; timer = timer->next) {
+            if (timer->active && timer->due_us <= until_us && (first == NULL || timer->due_us < first->due_us)) {
+                first = timer;
+            }
+        }
+        if (first == NULL) {
+            break;
+        }
+        if (first->due_us > now_us) {
+            now_us = first->due_us;
+        }
+        if (first->period_us != 0) {
+            first->due_us += first->period_us;
+        } else {
+            first->active = false;
+        }
+        first->args.callback(first->args.arg);
+    }
+    if (until_us > now_us) {
+        now_us = until_us;
+    }
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * @brief Virtual esp_timer clock, it only moves when the harness runs it
+ *
+ * Replaces esp_timer_get_time and the esp_timer instances of host_stubs.c. The timers due fire in
+ * order of expiry, each at its own time, from the thread running the clock.
+ */
+void virtual_timer_run_until(int64_t until_us);
@@ -43,6 +43,18 @@ FSM_ACTOR_CREATE(S_UNPRESS_ST, btn_pressed, NULL, NULL)
 FSM_ACTOR_CREATE(L_PRESS_ST, btn_long_pressed, NULL, NULL)
 FSM_ACTOR_END()
 
+/**
+ * @brief Internal LED pixels
+ * 
+ */
+static led_pixel_t led_pixels[LED_PIXEL_FRAMES] = {
+    {
+        .red = 200,
+        .green = 16,
+        .blue = 16,
+    }
+};
+
 /**
  * @brief Internal LED instance definition
  * 
@@ -55,12 +67,10 @@ static led_ins_t led = {
     .spi_config = {
         .spi_bus = SPI2_HOST,
         .flags.with_dma = true,
+        .flags.double_buffer = true,
     },
-    .colour[0] = {
-        .rgb.red = 200,
-        .rgb.green = 16,
-        .rgb.blue = 16,
-    }
+    .pixels = led_pixels,
+    .pixels_len = LED_PIXEL_FRAMES,
 };
 
 static led_colour_t colour[7];
@@ -78,6 +88,7 @@ static led_ins_t led_ext = {
     .spi_config = {
         .spi_bus = SPI3_HOST,
         .flags.with_dma = true,
+        .flags.double_buffer = true,
     },
 };
 #endif
@@ -167,9 +178,9 @@ static void init_led_colour(led_ins_t *led)
 {
     for (size_t i = 0; i < led->strip_config.max_leds; i++)
     {
-        led->colour[i].rgb.red = 16;
-        led->colour[i].rgb.green = 16;
-        led->colour[i].rgb.blue = 200;
+        led->pixels[i].red = 16;
+        led->pixels[i].green = 16;
+        led->pixels[i].blue = 200;
         colour[i].rgb.red = 16;
         colour[i].rgb.green = 16;
         colour[i].rgb.blue = 200;
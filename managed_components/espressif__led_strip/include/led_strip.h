@@ -6,13 +6,18 @@
 #pragma once
 
 #include <stdint.h>
+#include "sdkconfig.h"
 #include "esp_err.h"
-#include "led_strip_rmt.h"
 #include "esp_idf_version.h"
+#include "led_strip_capture.h"
+#include "led_strip_timing.h"
 
+#if !CONFIG_IDF_TARGET_LINUX
+#include "led_strip_rmt.h"
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
 #include "led_strip_spi.h"
 #endif
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -54,6 +59,27 @@ esp_err_t led_strip_set_pixel(led_strip_handle_t strip, uint32_t index, uint32_t
  */
 esp_err_t led_strip_set_pixel_rgbw(led_strip_handle_t strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue, uint32_t white);
 
+/**
+ * @brief Set a span of consecutive pixels from a buffer
+ *
+ * @note The range is validated once and the whole span is encoded in one pass, which is much cheaper than
+ *       calling `led_strip_set_pixel` for every pixel of a frame
+ * @note A LED_PIXEL_FORMAT_GRB buffer can be written to a GRBW strip, the white component is then turned off
+ *
+ * @param strip: LED strip
+ * @param start: index of the first pixel to set
+ * @param count: number of pixels to set
+ * @param src: pixel data, laid out as `format` (e.g. G,R,B,G,R,B... for LED_PIXEL_FORMAT_GRB)
+ * @param format: pixel format of `src`
+ *
+ * @return
+ *      - ESP_OK: Set the pixels successfully
+ *      - ESP_ERR_INVALID_ARG: Set the pixels failed because of invalid parameters
+ *      - ESP_ERR_NOT_SUPPORTED: The backend of this strip doesn't support bulk set_pixels
+ *      - ESP_FAIL: Set the pixels failed because other error occurred
+ */
+esp_err_t led_strip_set_pixels(led_strip_handle_t strip, uint32_t start, uint32_t count, const uint8_t *src, led_pixel_format_t format);
+
 /**
  * @brief Set HSV for a specific pixel
  *
@@ -70,6 +96,24 @@ esp_err_t led_strip_set_pixel_rgbw(led_strip_handle_t strip, uint32_t index, uin
  */
 esp_err_t led_strip_set_pixel_hsv(led_strip_handle_t strip, uint32_t index, uint16_t hue, uint8_t saturation, uint8_t value);
 
+/**
+ * @brief Set HSV for a span of consecutive pixels
+ *
+ * @note The colors are converted a chunk at a time with integer arithmetic and written with `led_strip_set_pixels`,
+ *       the result is the same as calling `led_strip_set_pixel_hsv` for every pixel
+ *
+ * @param strip: LED strip
+ * @param start: index of the first pixel to set
+ * @param count: number of pixels to set
+ * @param src: HSV colors of the pixels
+ *
+ * @return
+ *      - ESP_OK: Set the pixels successfully
+ *      - ESP_ERR_INVALID_ARG: Set the pixels failed because of invalid parameters
+ *      - ESP_FAIL: Set the pixels failed because other error occurred
+ */
+esp_err_t led_strip_set_pixels_hsv(led_strip_handle_t strip, uint32_t start, uint32_t count, const led_strip_hsv_t *src);
+
 /**
  * @brief Refresh memory colors to LEDs
  *
@@ -84,6 +128,52 @@ esp_err_t led_strip_set_pixel_hsv(led_strip_handle_t strip, uint32_t index, uint
  */
 esp_err_t led_strip_refresh(led_strip_handle_t strip);
 
+/**
+ * @brief Start flushing memory colors to LEDs without waiting for the transfer to finish
+ *
+ * @note The calling task can prepare the next frame while the current one is on the wire. Pixel setters wait
+ *       for the frame in flight to be sent out first, unless the strip has a second pixel buffer
+ *       (e.g. `led_strip_spi_config_t::flags::double_buffer`)
+ * @note Starting a new refresh waits for the frame in flight to be sent out first
+ *
+ * @param strip: LED strip
+ *
+ * @return
+ *      - ESP_OK: The frame has been queued for transmission
+ *      - ESP_ERR_NOT_SUPPORTED: The backend of this strip doesn't support asynchronous refresh
+ *      - ESP_FAIL: Refresh failed because some other error occurred
+ */
+esp_err_t led_strip_refresh_async(led_strip_handle_t strip);
+
+/**
+ * @brief Wait for the frame started by `led_strip_refresh_async` to be sent out
+ *
+ * @param strip: LED strip
+ * @param timeout_ms: wait timeout, in ms. Pass 0 to only check whether a frame is still in flight, -1 to wait forever
+ *
+ * @return
+ *      - ESP_OK: No frame is in flight
+ *      - ESP_ERR_TIMEOUT: A frame is still in flight
+ *      - ESP_ERR_NOT_SUPPORTED: The backend of this strip doesn't support asynchronous refresh
+ *      - ESP_FAIL: Wait failed because some other error occurred
+ */
+esp_err_t led_strip_wait_refresh_done(led_strip_handle_t strip, int32_t timeout_ms);
+
+/**
+ * @brief Register LED strip event callbacks
+ *
+ * @param strip: LED strip
+ * @param cbs: group of callback functions, the callbacks are invoked from ISR context
+ * @param user_ctx: user data, passed to the callback functions
+ *
+ * @return
+ *      - ESP_OK: Register the callbacks successfully
+ *      - ESP_ERR_INVALID_ARG: Register the callbacks failed because of invalid argument
+ *      - ESP_ERR_NOT_SUPPORTED: The backend of this strip doesn't support event callbacks
+ *      - ESP_FAIL: Register the callbacks failed because some other error occurred
+ */
+esp_err_t led_strip_register_event_callbacks(led_strip_handle_t strip, const led_strip_event_callbacks_t *cbs, void *user_ctx);
+
 /**
  * @brief Clear LED strip (turn off all LEDs)
  *
@@ -95,6 +185,172 @@ esp_err_t led_strip_refresh(led_strip_handle_t strip);
  */
 esp_err_t led_strip_clear(led_strip_handle_t strip);
 
+/**
+ * @brief Turn off all the pixels in the buffer, without sending them to the strip
+ *
+ * @note The LEDs keep showing the last frame until the next `led_strip_refresh`
+ *
+ * @param strip: LED strip
+ *
+ * @return
+ *      - ESP_OK: Clear the buffer successfully
+ *      - ESP_ERR_INVALID_ARG: Clear the buffer failed because of invalid argument
+ *      - ESP_ERR_NOT_SUPPORTED: The backend of this strip doesn't support clearing the buffer only
+ *      - ESP_FAIL: Clear the buffer failed because some other error occurred
+ */
+esp_err_t led_strip_clear_buffer_only(led_strip_handle_t strip);
+
+/**
+ * @brief Copy the current frame into a slot of the strip frame cache
+ *
+ * @note The memory of a slot is allocated the first time a frame is captured into it, and kept until the strip is deleted
+ *
+ * @param strip: LED strip
+ * @param slot: index of the slot, below CONFIG_LED_STRIP_FRAME_CACHE_SLOTS
+ *
+ * @return
+ *      - ESP_OK: Capture the frame successfully
+ *      - ESP_ERR_INVALID_ARG: Capture the frame failed because of invalid argument
+ *      - ESP_ERR_NO_MEM: Capture the frame failed because there's no memory for the slot
+ *      - ESP_ERR_NOT_SUPPORTED: The backend of this strip doesn't support the frame cache
+ *      - ESP_FAIL: Capture the frame failed because some other error occurred
+ */
+esp_err_t led_strip_capture_frame(led_strip_handle_t strip, uint32_t slot);
+
+/**
+ * @brief Send a frame captured by `led_strip_capture_frame` to the strip, the pixel buffer is left untouched
+ *
+ * @note Like `led_strip_refresh_async`, the function returns once the frame is queued if the backend supports asynchronous refresh,
+ *       otherwise it returns once the frame is sent
+ *
+ * @param strip: LED strip
+ * @param slot: index of the slot, below CONFIG_LED_STRIP_FRAME_CACHE_SLOTS
+ *
+ * @return
+ *      - ESP_OK: Start sending the frame successfully
+ *      - ESP_ERR_INVALID_ARG: Send the frame failed because of invalid argument
+ *      - ESP_ERR_INVALID_STATE: Send the frame failed because no frame was captured into the slot
+ *      - ESP_ERR_NOT_SUPPORTED: The backend of this strip doesn't support the frame cache
+ *      - ESP_FAIL: Send the frame failed because some other error occurred
+ */
+esp_err_t led_strip_refresh_frame(led_strip_handle_t strip, uint32_t slot);
+
+/**
+ * @brief Set how much of the strip `led_strip_refresh` and `led_strip_refresh_async` send
+ *
+ * @note LEDs like WS2812 latch the pixels from the start of the chain, the ones past the end of a frame keep their colour.
+ *       In LED_STRIP_REFRESH_PREFIX mode only the pixels up to the last one modified since the previous refresh are sent,
+ *       so the bus time is proportional to the updated part of the strip.
+ * @note The strip falls back to a full refresh after the content of the strip and the pixel buffer may differ,
+ *       i.e. after `led_strip_clear_buffer_only` and `led_strip_refresh_frame`. Call this function again to force it.
+ *
+ * @param strip: LED strip
+ * @param mode: refresh mode
+ *
+ * @return
+ *      - ESP_OK: Set the refresh mode successfully
+ *      - ESP_ERR_INVALID_ARG: Set the refresh mode failed because of invalid argument
+ *      - ESP_ERR_NOT_SUPPORTED: The backend of this strip doesn't support the refresh mode
+ *      - ESP_FAIL: Set the refresh mode failed because some other error occurred
+ */
+esp_err_t led_strip_set_refresh_mode(led_strip_handle_t strip, led_strip_refresh_mode_t mode);
+
+/**
+ * @brief Get the highest frame rate that the strip can be refreshed at
+ *
+ * @note The whole strip is sent in every frame, followed by the reset time that latches it.
+ *       A refresh only waits for the part of the reset time that hasn't elapsed yet, so frames can be sent back to back at this rate.
+ *
+ * @param strip: LED strip
+ * @param ret_fps: returned frames per second
+ *
+ * @return
+ *      - ESP_OK: Get the frame rate successfully
+ *      - ESP_ERR_INVALID_ARG: Get the frame rate failed because of invalid argument
+ *      - ESP_ERR_NOT_SUPPORTED: Get the frame rate failed because the backend doesn't report it
+ */
+esp_err_t led_strip_get_max_fps(led_strip_handle_t strip, uint32_t *ret_fps);
+
+/**
+ * @brief Get the timing of a refresh of the whole strip: time on the wire, reset time, setup cost and highest frame rate
+ *
+ * @note The figures follow the model of led_strip_timing.h, the setup costs are estimates.
+ *       Each backend logs them when the strip is created.
+ *
+ * @param strip: LED strip
+ * @param ret_timing: returned timing
+ *
+ * @return
+ *      - ESP_OK: Get the timing successfully
+ *      - ESP_ERR_INVALID_ARG: Get the timing failed because of invalid argument
+ *      - ESP_ERR_NOT_SUPPORTED: Get the timing failed because the backend doesn't report it
+ */
+esp_err_t led_strip_get_timing(led_strip_handle_t strip, led_strip_timing_t *ret_timing);
+
+/**
+ * @brief Get the pixel buffer of the strip, to render a frame straight into it
+ *
+ * @note The buffer holds the pixels in wire order (G,R,B or G,R,B,W), the bytes written are sent as is by `led_strip_commit`.
+ *       The call waits until no frame in flight reads the buffer, so it can be written right away.
+ * @note The pointer is valid until `led_strip_commit`, a double buffered strip hands out the other buffer for the next frame.
+ *       `led_strip_set_pixel`, `led_strip_set_pixel_rgbw`, `led_strip_set_pixels`, `led_strip_set_brightness`,
+ *       `led_strip_refresh`, `led_strip_refresh_async`, `led_strip_clear`, `led_strip_clear_buffer_only`,
+ *       `led_strip_capture_frame` and `led_strip_refresh_frame` are refused in the meantime.
+ *
+ * @param strip: LED strip
+ * @param ret_buf: returned pixel buffer
+ * @param ret_len: returned size of the buffer, in bytes
+ * @param ret_format: returned pixel format of the buffer
+ *
+ * @return
+ *      - ESP_OK: Get the framebuffer successfully
+ *      - ESP_ERR_INVALID_ARG: Get the framebuffer failed because of invalid argument
+ *      - ESP_ERR_NOT_SUPPORTED: The backend of this strip doesn't keep the pixels in wire order
+ *      - ESP_FAIL: Get the framebuffer failed because some other error occurred
+ */
+esp_err_t led_strip_get_framebuffer(led_strip_handle_t strip, uint8_t **ret_buf, uint32_t *ret_len, led_pixel_format_t *ret_format);
+
+/**
+ * @brief Send the frame rendered into the buffer given by `led_strip_get_framebuffer`
+ *
+ * @note The frame is sent like with `led_strip_refresh_async` where the backend supports it, the whole strip is sent
+ *
+ * @param strip: LED strip
+ *
+ * @return
+ *      - ESP_OK: Start sending the frame successfully
+ *      - ESP_ERR_INVALID_ARG: Commit failed because of invalid argument
+ *      - ESP_ERR_INVALID_STATE: Commit failed because the framebuffer wasn't taken
+ *      - ESP_ERR_NOT_SUPPORTED: The backend of this strip doesn't support direct framebuffer access
+ *      - ESP_FAIL: Commit failed because some other error occurred
+ */
+esp_err_t led_strip_commit(led_strip_handle_t strip);
+
+/**
+ * @brief Set the global brightness of the strip
+ *
+ * @note The color bytes are scaled in the pass that turns them into the wire signal, there's no extra pass over the frame.
+ *       The RMT backend scales them while a frame is sent, a strip created with the bytes encoder is switched over to
+ *       the nibble encoder the first time (ESP-IDF v5.3 or later). The SPI backend bakes the factor into its bit expansion table.
+ * @note Without the streaming mode, the SPI backend encodes the pixels when they're set. A new brightness encodes the
+ *       pixel buffer again, from a copy of the color bytes kept from then on, and drops the frames captured with
+ *       `led_strip_capture_frame`. Dithering isn't available there.
+ * @note With dithering, the fraction that a byte loses to the scaling is added to the same byte of the next frame,
+ *       so that dim colors and slow fades average out to the exact level over a few frames.
+ *
+ * @param strip: LED strip
+ * @param brightness: 8.8 fixed point factor, from 0 (off) to LED_STRIP_BRIGHTNESS_MAX (unchanged)
+ * @param dither: carry the fraction lost by every byte over to the next frame
+ *
+ * @return
+ *      - ESP_OK: Set the brightness successfully
+ *      - ESP_ERR_INVALID_ARG: Set the brightness failed because of invalid argument
+ *      - ESP_ERR_NOT_SUPPORTED: The backend of this strip can't apply the brightness in its configuration
+ *      - ESP_ERR_NO_MEM: Set the brightness failed because there's no memory for the dithering state or the color bytes
+ *      - ESP_FAIL: Set the brightness failed because some other error occurred
+ */
+esp_err_t led_strip_set_brightness(led_strip_handle_t strip, uint16_t brightness, bool dither);
+
 /**
  * @brief Free LED strip resources
  *
@@ -0,0 +1,77 @@
+/*
+ * SPDX-FileCopyrightText: 2022-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "led_strip_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief LED Strip capture specific configuration
+ */
+typedef struct {
+    uint32_t frame_num;     /*!< Frames kept in the capture ring, the oldest one is overwritten by a new refresh */
+    uint32_t bit_period_ns; /*!< Emulated time of a bit on the wire, in ns. Set to 0 to send frames in no time */
+    uint32_t reset_us;      /*!< Emulated reset time between two frames, in us */
+} led_strip_capture_config_t;
+
+/**
+ * @brief Frame recorded by a capture strip
+ */
+typedef struct {
+    int64_t timestamp_us;  /*!< Time at which the frame started on the emulated wire, in us */
+    uint32_t len;          /*!< Number of pixels sent, less than the strip length after a prefix refresh */
+    const uint8_t *pixels; /*!< Pixels sent, in wire order (G,R,B or G,R,B,W). Valid until the slot is overwritten */
+} led_strip_capture_frame_t;
+
+/**
+ * @brief Create LED strip that records its frames in memory instead of driving a peripheral
+ *
+ * @note The frames are copied into a ring allocated upfront, a refresh costs a memcpy and no allocation.
+ *       The wire time and reset time of a real strip can be emulated, so that the timing of the application is kept.
+ * @note The backend doesn't depend on any peripheral, it also builds for the linux target of ESP-IDF.
+ *
+ * @param led_config LED strip configuration, `strip_gpio_num` and `led_model` are ignored
+ * @param capture_config Capture specific configuration
+ * @param ret_strip Returned LED strip handle
+ * @return
+ *      - ESP_OK: create LED strip handle successfully
+ *      - ESP_ERR_INVALID_ARG: create LED strip handle failed because of invalid argument
+ *      - ESP_ERR_NO_MEM: create LED strip handle failed because of out of memory
+ */
+esp_err_t led_strip_new_capture_device(const led_strip_config_t *led_config, const led_strip_capture_config_t *capture_config, led_strip_handle_t *ret_strip);
+
+/**
+ * @brief Get the number of frames refreshed by a capture strip since it was created
+ *
+ * @param strip LED strip created by `led_strip_new_capture_device`
+ * @param ret_count Returned number of frames, including the ones overwritten in the ring
+ * @return
+ *      - ESP_OK: get the count successfully
+ *      - ESP_ERR_INVALID_ARG: get the count failed because the strip isn't a capture strip
+ */
+esp_err_t led_strip_capture_get_count(led_strip_handle_t strip, uint32_t *ret_count);
+
+/**
+ * @brief Get a frame recorded by a capture strip
+ *
+ * @param strip LED strip created by `led_strip_new_capture_device`
+ * @param age 0 for the last frame refreshed, 1 for the one before...
+ * @param ret_frame Returned frame
+ * @return
+ *      - ESP_OK: get the frame successfully
+ *      - ESP_ERR_INVALID_ARG: get the frame failed because the strip isn't a capture strip
+ *      - ESP_ERR_NOT_FOUND: get the frame failed because the frame isn't in the ring (not sent yet or overwritten)
+ */
+esp_err_t led_strip_capture_get_frame(led_strip_handle_t strip, uint32_t age, led_strip_capture_frame_t *ret_frame);
+
+#ifdef __cplusplus
+}
+#endif
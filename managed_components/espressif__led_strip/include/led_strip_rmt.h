@@ -31,6 +31,11 @@ typedef struct {
     size_t mem_block_symbols;   /*!< How many RMT symbols can one RMT channel hold at one time. Set to 0 will fallback to use the default size. */
     struct {
         uint32_t with_dma: 1;   /*!< Use DMA to transmit data */
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+        uint32_t persistent_enable: 1; /*!< Keep the RMT channel enabled for the whole life of the strip, instead of enabling it for every frame */
+        uint32_t double_buffer: 1;     /*!< Allocate a second pixel buffer, so the next frame can be written while `led_strip_refresh_async` sends the current one */
+        uint32_t nibble_encoder: 1;    /*!< Encode the pixels with a nibble to symbols table, straight into the RMT memory. Requires ESP-IDF v5.3 or later */
+#endif
     } flags;                    /*!< Extra driver flags */
 } led_strip_rmt_config_t;
 
@@ -22,6 +22,10 @@ typedef struct {
     spi_host_device_t spi_bus;  /*!< SPI bus ID. Which buses are available depends on the specific chip */
     struct {
         uint32_t with_dma: 1;   /*!< Use DMA to transmit data */
+        uint32_t double_buffer: 1; /*!< Allocate a second pixel buffer, so the next frame can be encoded while `led_strip_refresh_async` sends the current one */
+        uint32_t streaming: 1;  /*!< Keep the pixels unencoded, possibly in PSRAM, and encode them chunk by chunk into a few small DMA buffers
+                                     while the frame is sent. Needs `with_dma`, the chunks are refilled by a driver task woken up as each one is sent,
+                                     see `CONFIG_LED_STRIP_SPI_STREAM_TASK_PRIORITY` */
     } flags;                    /*!< Extra driver flags */
 } led_strip_spi_config_t;
 
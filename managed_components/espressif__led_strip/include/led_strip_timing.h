@@ -0,0 +1,119 @@
+/*
+ * SPDX-FileCopyrightText: 2022-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Timing model of a refresh
+ *
+ * A frame occupies the wire for bits x bit period. It is latched by the reset time, during which the line idles low.
+ * Setting up the peripheral costs some CPU time on every frame: part of it is done while the reset time runs
+ * (and is hidden unless it is longer), the rest is spent after the reset time and adds up to the frame period.
+ *
+ * The macros are constant expressions, a static configuration can be checked when building, e.g.
+ *     _Static_assert(LED_STRIP_RMT_MAX_FPS(300, 3, false) >= 60, "strip too long for 60 fps");
+ */
+
+// low time that latches a frame into the LEDs, 280us to accomodate WS2812B-V5
+#define LED_STRIP_RESET_US 280
+
+// period of a bit sent by the RMT backend, T0H + T0L = T1H + T1L = 1.2us for every supported LED model
+#define LED_STRIP_RMT_BIT_PERIOD_NS 1200
+// estimated cost of enabling the RMT channel before a frame and disabling it afterwards, hidden by the reset time
+#define LED_STRIP_RMT_ENABLE_US 30
+// estimated cost of starting an RMT transmission, up to the first bit on the wire
+#define LED_STRIP_RMT_SETUP_US 15
+// estimated cost of queuing an SPI transaction (and encoding the first chunk when streaming), up to the first bit on the wire
+#define LED_STRIP_SPI_SETUP_US 20
+
+/**
+ * @brief Period of a LED bit sent by the SPI backend, each LED bit taking `symbols` SPI bits at `clock_hz`
+ */
+#define LED_STRIP_SPI_BIT_PERIOD_NS(clock_hz, symbols) ((symbols) * 1000000000ULL / (clock_hz))
+
+/**
+ * @brief Time a frame of `leds` pixels of `bytes_per_pixel` bytes occupies the wire, in ns
+ */
+#define LED_STRIP_WIRE_TIME_NS(leds, bytes_per_pixel, bit_period_ns) \
+    ((uint64_t)(leds) * (bytes_per_pixel) * 8 * (bit_period_ns))
+
+/**
+ * @brief Shortest period between two frames, in ns
+ *
+ * @note `hidden_us` is the setup done while the reset time runs, `setup_us` the setup done once it has elapsed
+ */
+#define LED_STRIP_FRAME_TIME_NS(leds, bytes_per_pixel, bit_period_ns, reset_us, hidden_us, setup_us) \
+    (LED_STRIP_WIRE_TIME_NS(leds, bytes_per_pixel, bit_period_ns) +                                  \
+     ((reset_us) > (hidden_us) ? (reset_us) : (hidden_us)) * 1000ULL + (setup_us) * 1000ULL)
+
+/**
+ * @brief Highest sustainable frame rate, the frames being sent back to back
+ */
+#define LED_STRIP_MAX_FPS(leds, bytes_per_pixel, bit_period_ns, reset_us, hidden_us, setup_us) \
+    (1000000000ULL / LED_STRIP_FRAME_TIME_NS(leds, bytes_per_pixel, bit_period_ns, reset_us, hidden_us, setup_us))
+
+/**
+ * @brief Highest frame rate of a strip driven by the RMT backend
+ *
+ * @note Without `persistent_enable`, the channel is enabled and disabled around every frame
+ */
+#define LED_STRIP_RMT_MAX_FPS(leds, bytes_per_pixel, persistent_enable)                                 \
+    LED_STRIP_MAX_FPS(leds, bytes_per_pixel, LED_STRIP_RMT_BIT_PERIOD_NS, LED_STRIP_RESET_US,            \
+                      (persistent_enable) ? 0 : LED_STRIP_RMT_ENABLE_US, LED_STRIP_RMT_SETUP_US)
+
+/**
+ * @brief Highest frame rate of a strip driven by the SPI backend, each LED bit taking `symbols` SPI bits at `clock_hz`
+ */
+#define LED_STRIP_SPI_MAX_FPS(leds, bytes_per_pixel, clock_hz, symbols)                                  \
+    LED_STRIP_MAX_FPS(leds, bytes_per_pixel, LED_STRIP_SPI_BIT_PERIOD_NS(clock_hz, symbols),             \
+                      LED_STRIP_RESET_US, 0, LED_STRIP_SPI_SETUP_US)
+
+/**
+ * @brief Timing of the refresh of a whole strip
+ */
+typedef struct {
+    uint32_t bit_period_ns; /*!< Duration of a bit on the wire, in ns */
+    uint32_t wire_time_us;  /*!< Time the whole strip occupies the wire, in us */
+    uint32_t reset_us;      /*!< Reset time that latches a frame, in us */
+    uint32_t hidden_us;     /*!< Setup done while the reset time runs, in us */
+    uint32_t setup_us;      /*!< Setup done once the reset time has elapsed, in us */
+    uint32_t frame_time_us; /*!< Shortest period between two frames, in us */
+    uint32_t max_fps;       /*!< Highest sustainable frame rate */
+} led_strip_timing_t;
+
+/**
+ * @brief Fill a timing from the parameters of a strip, as the `LED_STRIP_*_NS` macros compute it
+ *
+ * @param timing Returned timing
+ * @param leds Number of LEDs of the strip
+ * @param bytes_per_pixel 3 for GRB, 4 for GRBW
+ * @param bit_period_ns Duration of a bit on the wire, in ns
+ * @param reset_us Reset time, in us
+ * @param hidden_us Setup done while the reset time runs, in us
+ * @param setup_us Setup done once the reset time has elapsed, in us
+ */
+static inline void led_strip_timing_calc(led_strip_timing_t *timing, uint32_t leds, uint32_t bytes_per_pixel, uint32_t bit_period_ns,
+                                         uint32_t reset_us, uint32_t hidden_us, uint32_t setup_us)
+{
+    uint64_t frame_ns = LED_STRIP_FRAME_TIME_NS(leds, bytes_per_pixel, bit_period_ns, reset_us, hidden_us, setup_us);
+    timing->bit_period_ns = bit_period_ns;
+    timing->wire_time_us = (LED_STRIP_WIRE_TIME_NS(leds, bytes_per_pixel, bit_period_ns) + 999) / 1000;
+    timing->reset_us = reset_us;
+    timing->hidden_us = hidden_us;
+    timing->setup_us = setup_us;
+    timing->frame_time_us = (frame_ns + 999) / 1000;
+    // a strip that takes no time at all, only an emulated one can do that
+    timing->max_fps = frame_ns ? 1000000000ULL / frame_ns : UINT32_MAX;
+}
+
+#ifdef __cplusplus
+}
+#endif
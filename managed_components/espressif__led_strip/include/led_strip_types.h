@@ -6,6 +6,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -30,11 +31,53 @@ typedef enum {
     LED_MODEL_INVALID /*!< Invalid LED strip model */
 } led_model_t;
 
+/**
+ * @brief LED strip refresh mode
+ */
+typedef enum {
+    LED_STRIP_REFRESH_FULL,   /*!< Every refresh sends the whole strip */
+    LED_STRIP_REFRESH_PREFIX, /*!< A refresh sends the pixels from the start of the strip up to the last one modified since the previous refresh */
+    LED_STRIP_REFRESH_INVALID /*!< Invalid refresh mode */
+} led_strip_refresh_mode_t;
+
+/**
+ * @brief Full brightness, in 8.8 fixed point
+ */
+#define LED_STRIP_BRIGHTNESS_MAX 0x100
+
+/**
+ * @brief HSV color of a pixel
+ */
+typedef struct {
+    uint16_t hue;       /*!< Hue, in degrees (0 - 360) */
+    uint8_t saturation; /*!< Saturation (0 - 255, rescaled from 0 - 1) */
+    uint8_t value;      /*!< Value (0 - 255, rescaled from 0 - 1) */
+} led_strip_hsv_t;
+
 /**
  * @brief LED strip handle
  */
 typedef struct led_strip_t *led_strip_handle_t;
 
+/**
+ * @brief Type of LED strip refresh done callback
+ *
+ * @note The callback is invoked from the driver ISR, it must not block and should be placed in IRAM
+ *       if the peripheral ISR is placed in IRAM (e.g. CONFIG_SPI_MASTER_ISR_IN_IRAM)
+ *
+ * @param strip LED strip handle
+ * @param user_ctx User data, passed from `led_strip_register_event_callbacks`
+ * @return Whether a high priority task has been woken up by this callback
+ */
+typedef bool (*led_strip_refresh_done_cb_t)(led_strip_handle_t strip, void *user_ctx);
+
+/**
+ * @brief Group of supported LED strip event callbacks
+ */
+typedef struct {
+    led_strip_refresh_done_cb_t on_refresh_done; /*!< Invoked when a frame has been sent out */
+} led_strip_event_callbacks_t;
+
 /**
  * @brief LED Strip Configuration
  */
@@ -7,6 +7,8 @@
 
 #include <stdint.h>
 #include "esp_err.h"
+#include "led_strip_types.h"
+#include "led_strip_timing.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -51,6 +53,22 @@ struct led_strip_t {
      */
     esp_err_t (*set_pixel_rgbw)(led_strip_t *strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue, uint32_t white);
 
+    /**
+     * @brief Set a span of consecutive pixels from a buffer
+     *
+     * @param strip: LED strip
+     * @param start: index of the first pixel to set
+     * @param count: number of pixels to set
+     * @param src: pixel data, laid out as `format` (e.g. G,R,B,G,R,B... for LED_PIXEL_FORMAT_GRB)
+     * @param format: pixel format of `src`
+     *
+     * @return
+     *      - ESP_OK: Set the pixels successfully
+     *      - ESP_ERR_INVALID_ARG: Set the pixels failed because of invalid parameters
+     *      - ESP_FAIL: Set the pixels failed because other error occurred
+     */
+    esp_err_t (*set_pixels)(led_strip_t *strip, uint32_t start, uint32_t count, const uint8_t *src, led_pixel_format_t format);
+
     /**
      * @brief Refresh memory colors to LEDs
      *
@@ -66,6 +84,43 @@ struct led_strip_t {
      */
     esp_err_t (*refresh)(led_strip_t *strip);
 
+    /**
+     * @brief Start sending the memory colors to LEDs without waiting for the transfer to finish
+     *
+     * @param strip: LED strip
+     *
+     * @return
+     *      - ESP_OK: The frame has been queued for transmission
+     *      - ESP_FAIL: Refresh failed because some other error occurred
+     */
+    esp_err_t (*refresh_async)(led_strip_t *strip);
+
+    /**
+     * @brief Wait for the frame started by `refresh_async` to be sent out
+     *
+     * @param strip: LED strip
+     * @param timeout_ms: wait timeout, in ms. 0 only checks the state, -1 waits forever
+     *
+     * @return
+     *      - ESP_OK: No frame is in flight
+     *      - ESP_ERR_TIMEOUT: A frame is still in flight when the timeout expires
+     *      - ESP_FAIL: Wait failed because some other error occurred
+     */
+    esp_err_t (*wait_refresh_done)(led_strip_t *strip, int32_t timeout_ms);
+
+    /**
+     * @brief Register event callbacks
+     *
+     * @param strip: LED strip
+     * @param cbs: group of callback functions
+     * @param user_ctx: user data, passed to the callback functions
+     *
+     * @return
+     *      - ESP_OK: Register the callbacks successfully
+     *      - ESP_FAIL: Register the callbacks failed because some other error occurred
+     */
+    esp_err_t (*register_event_callbacks)(led_strip_t *strip, const led_strip_event_callbacks_t *cbs, void *user_ctx);
+
     /**
      * @brief Clear LED strip (turn off all LEDs)
      *
@@ -78,6 +133,108 @@ struct led_strip_t {
      */
     esp_err_t (*clear)(led_strip_t *strip);
 
+    /**
+     * @brief Turn off all the pixels in the buffer, without sending them to the strip
+     *
+     * @param strip: LED strip
+     *
+     * @return
+     *      - ESP_OK: Clear the buffer successfully
+     *      - ESP_FAIL: Clear the buffer failed because some other error occurred
+     */
+    esp_err_t (*clear_buffer_only)(led_strip_t *strip);
+
+    /**
+     * @brief Copy the current frame into a frame cache slot
+     *
+     * @param strip: LED strip
+     * @param slot: index of the slot, below CONFIG_LED_STRIP_FRAME_CACHE_SLOTS
+     *
+     * @return
+     *      - ESP_OK: Capture the frame successfully
+     *      - ESP_ERR_NO_MEM: Capture the frame failed because there's no memory for the slot
+     *      - ESP_FAIL: Capture the frame failed because some other error occurred
+     */
+    esp_err_t (*capture_frame)(led_strip_t *strip, uint32_t slot);
+
+    /**
+     * @brief Send a frame captured by `capture_frame` to the strip
+     *
+     * @param strip: LED strip
+     * @param slot: index of the slot, below CONFIG_LED_STRIP_FRAME_CACHE_SLOTS
+     *
+     * @return
+     *      - ESP_OK: Start sending the frame successfully
+     *      - ESP_ERR_INVALID_STATE: Send the frame failed because no frame was captured into the slot
+     *      - ESP_FAIL: Send the frame failed because some other error occurred
+     */
+    esp_err_t (*refresh_frame)(led_strip_t *strip, uint32_t slot);
+
+    /**
+     * @brief Set how much of the strip a refresh sends, the next refresh sends the whole strip
+     *
+     * @param strip: LED strip
+     * @param mode: refresh mode
+     *
+     * @return
+     *      - ESP_OK: Set the refresh mode successfully
+     *      - ESP_FAIL: Set the refresh mode failed because some other error occurred
+     */
+    esp_err_t (*set_refresh_mode)(led_strip_t *strip, led_strip_refresh_mode_t mode);
+
+    /**
+     * @brief Get the timing of a refresh of the whole strip, frames being sent back to back
+     *
+     * @param strip: LED strip
+     * @param ret_timing: returned timing
+     *
+     * @return
+     *      - ESP_OK: Get the timing successfully
+     *      - ESP_FAIL: Get the timing failed because some other error occurred
+     */
+    esp_err_t (*get_timing)(led_strip_t *strip, led_strip_timing_t *ret_timing);
+
+    /**
+     * @brief Hand the pixel buffer out for direct writing, until `commit` is called
+     *
+     * @param strip: LED strip
+     * @param ret_buf: returned pixel buffer, in wire order
+     * @param ret_len: returned size of the buffer, in bytes
+     * @param ret_format: returned pixel format of the buffer
+     *
+     * @return
+     *      - ESP_OK: Get the framebuffer successfully
+     *      - ESP_FAIL: Get the framebuffer failed because some other error occurred
+     */
+    esp_err_t (*get_framebuffer)(led_strip_t *strip, uint8_t **ret_buf, uint32_t *ret_len, led_pixel_format_t *ret_format);
+
+    /**
+     * @brief Give the pixel buffer back and send it to the strip
+     *
+     * @param strip: LED strip
+     *
+     * @return
+     *      - ESP_OK: Start sending the frame successfully
+     *      - ESP_ERR_INVALID_STATE: Commit failed because the framebuffer wasn't handed out
+     *      - ESP_FAIL: Commit failed because some other error occurred
+     */
+    esp_err_t (*commit)(led_strip_t *strip);
+
+    /**
+     * @brief Set the factor that the color bytes are scaled by when they're encoded
+     *
+     * @param strip: LED strip
+     * @param brightness: 8.8 fixed point factor, up to LED_STRIP_BRIGHTNESS_MAX
+     * @param dither: carry the truncated fraction of every byte over to the next frame
+     *
+     * @return
+     *      - ESP_OK: Set the brightness successfully
+     *      - ESP_ERR_NOT_SUPPORTED: Set the brightness failed because the backend can't apply it in this configuration
+     *      - ESP_ERR_NO_MEM: Set the brightness failed because there's no memory for the dithering state
+     *      - ESP_FAIL: Set the brightness failed because some other error occurred
+     */
+    esp_err_t (*set_brightness)(led_strip_t *strip, uint16_t brightness, bool dither);
+
     /**
      * @brief Free LED strip resources
      *
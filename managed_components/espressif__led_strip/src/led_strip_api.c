@@ -16,23 +16,37 @@ esp_err_t led_strip_set_pixel(led_strip_handle_t strip, uint32_t index, uint32_t
     return strip->set_pixel(strip, index, red, green, blue);
 }
 
-esp_err_t led_strip_set_pixel_hsv(led_strip_handle_t strip, uint32_t index, uint16_t hue, uint8_t saturation, uint8_t value)
+esp_err_t led_strip_set_pixels(led_strip_handle_t strip, uint32_t start, uint32_t count, const uint8_t *src, led_pixel_format_t format)
 {
-    ESP_RETURN_ON_FALSE(strip, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(strip && src, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(strip->set_pixels, ESP_ERR_NOT_SUPPORTED, TAG, "bulk set_pixels not supported");
+    return strip->set_pixels(strip, start, count, src, format);
+}
 
-    uint32_t red = 0;
-    uint32_t green = 0;
-    uint32_t blue = 0;
+// pixels converted on the stack at a time by led_strip_set_pixels_hsv
+#define LED_STRIP_HSV_CHUNK_PIXELS 32
 
+/**
+ * @brief Convert a HSV color into G,R,B bytes, with multiplications and shifts only
+ *
+ * The divisions by 60 and 255 are replaced with reciprocal multiplications that are exact over the whole range
+ * of their operands, the result is the same as the straightforward integer conversion for every input.
+ */
+static inline void led_strip_hsv_to_grb(uint16_t hue, uint8_t saturation, uint8_t value, uint8_t *grb)
+{
     uint32_t rgb_max = value;
-    uint32_t rgb_min = rgb_max * (255 - saturation) / 255.0f;
+    uint32_t x = rgb_max * (255 - saturation);
+    uint32_t rgb_min = (x + 1 + (x >> 8)) >> 8; // x / 255, x <= 255 * 255
 
-    uint32_t i = hue / 60;
-    uint32_t diff = hue % 60;
+    uint32_t i = (hue * 34953U) >> 21; // hue / 60, hue <= 65535
+    uint32_t diff = hue - i * 60;
 
     // RGB adjustment amount by hue
-    uint32_t rgb_adj = (rgb_max - rgb_min) * diff / 60;
+    uint32_t rgb_adj = ((rgb_max - rgb_min) * diff * 17477U) >> 20; // / 60, (rgb_max - rgb_min) * diff <= 255 * 59
 
+    uint8_t red = 0;
+    uint8_t green = 0;
+    uint8_t blue = 0;
     switch (i) {
     case 0:
         red = rgb_max;
@@ -65,8 +79,34 @@ esp_err_t led_strip_set_pixel_hsv(led_strip_handle_t strip, uint32_t index, uint
         blue = rgb_max - rgb_adj;
         break;
     }
+    grb[0] = green;
+    grb[1] = red;
+    grb[2] = blue;
+}
 
-    return strip->set_pixel(strip, index, red, green, blue);
+esp_err_t led_strip_set_pixel_hsv(led_strip_handle_t strip, uint32_t index, uint16_t hue, uint8_t saturation, uint8_t value)
+{
+    ESP_RETURN_ON_FALSE(strip, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    uint8_t grb[3];
+    led_strip_hsv_to_grb(hue, saturation, value, grb);
+    return strip->set_pixel(strip, index, grb[1], grb[0], grb[2]);
+}
+
+esp_err_t led_strip_set_pixels_hsv(led_strip_handle_t strip, uint32_t start, uint32_t count, const led_strip_hsv_t *src)
+{
+    ESP_RETURN_ON_FALSE(strip && src, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    uint8_t grb[LED_STRIP_HSV_CHUNK_PIXELS * 3];
+    while (count) {
+        uint32_t num = count < LED_STRIP_HSV_CHUNK_PIXELS ? count : LED_STRIP_HSV_CHUNK_PIXELS;
+        for (uint32_t i = 0; i < num; i++) {
+            led_strip_hsv_to_grb(src[i].hue, src[i].saturation, src[i].value, &grb[i * 3]);
+        }
+        ESP_RETURN_ON_ERROR(strip->set_pixels(strip, start, num, grb, LED_PIXEL_FORMAT_GRB), TAG, "set pixels failed");
+        start += num;
+        count -= num;
+        src += num;
+    }
+    return ESP_OK;
 }
 
 esp_err_t led_strip_set_pixel_rgbw(led_strip_handle_t strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue, uint32_t white)
@@ -81,12 +121,98 @@ esp_err_t led_strip_refresh(led_strip_handle_t strip)
     return strip->refresh(strip);
 }
 
+esp_err_t led_strip_refresh_async(led_strip_handle_t strip)
+{
+    ESP_RETURN_ON_FALSE(strip, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(strip->refresh_async, ESP_ERR_NOT_SUPPORTED, TAG, "asynchronous refresh not supported");
+    return strip->refresh_async(strip);
+}
+
+esp_err_t led_strip_wait_refresh_done(led_strip_handle_t strip, int32_t timeout_ms)
+{
+    ESP_RETURN_ON_FALSE(strip, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(strip->wait_refresh_done, ESP_ERR_NOT_SUPPORTED, TAG, "asynchronous refresh not supported");
+    return strip->wait_refresh_done(strip, timeout_ms);
+}
+
+esp_err_t led_strip_register_event_callbacks(led_strip_handle_t strip, const led_strip_event_callbacks_t *cbs, void *user_ctx)
+{
+    ESP_RETURN_ON_FALSE(strip && cbs, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(strip->register_event_callbacks, ESP_ERR_NOT_SUPPORTED, TAG, "event callbacks not supported");
+    return strip->register_event_callbacks(strip, cbs, user_ctx);
+}
+
 esp_err_t led_strip_clear(led_strip_handle_t strip)
 {
     ESP_RETURN_ON_FALSE(strip, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
     return strip->clear(strip);
 }
 
+esp_err_t led_strip_clear_buffer_only(led_strip_handle_t strip)
+{
+    ESP_RETURN_ON_FALSE(strip, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(strip->clear_buffer_only, ESP_ERR_NOT_SUPPORTED, TAG, "clear_buffer_only not supported");
+    return strip->clear_buffer_only(strip);
+}
+
+esp_err_t led_strip_capture_frame(led_strip_handle_t strip, uint32_t slot)
+{
+    ESP_RETURN_ON_FALSE(strip && slot < CONFIG_LED_STRIP_FRAME_CACHE_SLOTS, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(strip->capture_frame, ESP_ERR_NOT_SUPPORTED, TAG, "frame cache not supported");
+    return strip->capture_frame(strip, slot);
+}
+
+esp_err_t led_strip_refresh_frame(led_strip_handle_t strip, uint32_t slot)
+{
+    ESP_RETURN_ON_FALSE(strip && slot < CONFIG_LED_STRIP_FRAME_CACHE_SLOTS, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(strip->refresh_frame, ESP_ERR_NOT_SUPPORTED, TAG, "frame cache not supported");
+    return strip->refresh_frame(strip, slot);
+}
+
+esp_err_t led_strip_set_refresh_mode(led_strip_handle_t strip, led_strip_refresh_mode_t mode)
+{
+    ESP_RETURN_ON_FALSE(strip && mode < LED_STRIP_REFRESH_INVALID, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(strip->set_refresh_mode, ESP_ERR_NOT_SUPPORTED, TAG, "refresh mode not supported");
+    return strip->set_refresh_mode(strip, mode);
+}
+
+esp_err_t led_strip_get_max_fps(led_strip_handle_t strip, uint32_t *ret_fps)
+{
+    ESP_RETURN_ON_FALSE(strip && ret_fps, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    led_strip_timing_t timing;
+    ESP_RETURN_ON_ERROR(led_strip_get_timing(strip, &timing), TAG, "get timing failed");
+    *ret_fps = timing.max_fps;
+    return ESP_OK;
+}
+
+esp_err_t led_strip_get_timing(led_strip_handle_t strip, led_strip_timing_t *ret_timing)
+{
+    ESP_RETURN_ON_FALSE(strip && ret_timing, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(strip->get_timing, ESP_ERR_NOT_SUPPORTED, TAG, "timing not supported");
+    return strip->get_timing(strip, ret_timing);
+}
+
+esp_err_t led_strip_get_framebuffer(led_strip_handle_t strip, uint8_t **ret_buf, uint32_t *ret_len, led_pixel_format_t *ret_format)
+{
+    ESP_RETURN_ON_FALSE(strip && ret_buf && ret_len && ret_format, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(strip->get_framebuffer, ESP_ERR_NOT_SUPPORTED, TAG, "framebuffer access not supported");
+    return strip->get_framebuffer(strip, ret_buf, ret_len, ret_format);
+}
+
+esp_err_t led_strip_commit(led_strip_handle_t strip)
+{
+    ESP_RETURN_ON_FALSE(strip, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(strip->commit, ESP_ERR_NOT_SUPPORTED, TAG, "framebuffer access not supported");
+    return strip->commit(strip);
+}
+
+esp_err_t led_strip_set_brightness(led_strip_handle_t strip, uint16_t brightness, bool dither)
+{
+    ESP_RETURN_ON_FALSE(strip && brightness <= LED_STRIP_BRIGHTNESS_MAX, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(strip->set_brightness, ESP_ERR_NOT_SUPPORTED, TAG, "brightness not supported");
+    return strip->set_brightness(strip, brightness, dither);
+}
+
 esp_err_t led_strip_del(led_strip_handle_t strip)
 {
     ESP_RETURN_ON_FALSE(strip, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
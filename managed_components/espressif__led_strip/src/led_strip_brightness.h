@@ -0,0 +1,37 @@
+/*
+ * SPDX-FileCopyrightText: 2022-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include "led_strip_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Scale a color byte by a 8.8 fixed point brightness, rounded to the nearest
+ */
+static inline uint8_t led_strip_scale(uint8_t data, uint16_t brightness)
+{
+    return (data * brightness + 0x80) >> 8;
+}
+
+/**
+ * @brief Scale a color byte by a 8.8 fixed point brightness, carrying the truncated fraction over to the next frame
+ *
+ * @param residual: fraction left over by the previous frame for this byte, updated with the one of this frame
+ */
+static inline uint8_t led_strip_scale_dither(uint8_t data, uint16_t brightness, uint8_t *residual)
+{
+    uint32_t scaled = data * brightness + *residual; // <= 0xFFFF as brightness <= LED_STRIP_BRIGHTNESS_MAX
+    *residual = scaled & 0xFF;
+    return scaled >> 8;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,311 @@
+/*
+ * SPDX-FileCopyrightText: 2022-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/cdefs.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "led_strip.h"
+#include "led_strip_interface.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#include <unistd.h>
+#else
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#endif
+
+static const char *TAG = "led_strip_capture";
+
+typedef struct {
+    led_strip_t base;
+    uint32_t strip_len;
+    uint32_t dirty_len;          // number of pixels from the start of the strip modified since the last refresh
+    led_strip_refresh_mode_t refresh_mode;
+    uint8_t bytes_per_pixel;
+    uint32_t bit_period_ns;      // emulated time of a bit on the wire
+    uint32_t reset_us;           // emulated reset time between two frames
+    int64_t wire_busy_until_us;  // end of the last frame on the emulated wire
+    uint32_t frame_num;          // slots in the capture ring
+    uint32_t frame_count;        // frames refreshed since the creation
+    led_strip_capture_frame_t *frames; // capture ring, frame_count % frame_num is the next slot
+    uint8_t *ring_buf;           // pixels of the capture ring, a whole strip per slot
+    uint8_t *frame_cache[CONFIG_LED_STRIP_FRAME_CACHE_SLOTS]; // pixels captured by the user, allocated on first capture
+    uint8_t pixel_buf[];
+} led_strip_capture_obj;
+
+static int64_t led_strip_capture_now_us(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return esp_timer_get_time();
+#endif
+}
+
+static void led_strip_capture_wait_until(int64_t time_us)
+{
+    int64_t left_us;
+    while ((left_us = time_us - led_strip_capture_now_us()) > 0) {
+#if CONFIG_IDF_TARGET_LINUX
+        usleep(left_us);
+#else
+        esp_rom_delay_us(left_us);
+#endif
+    }
+}
+
+static inline void led_strip_capture_mark_dirty(led_strip_capture_obj *capture_strip, uint32_t end)
+{
+    if (end > capture_strip->dirty_len) {
+        capture_strip->dirty_len = end;
+    }
+}
+
+static esp_err_t led_strip_capture_set_pixel(led_strip_t *strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue)
+{
+    led_strip_capture_obj *capture_strip = __containerof(strip, led_strip_capture_obj, base);
+    ESP_RETURN_ON_FALSE(index < capture_strip->strip_len, ESP_ERR_INVALID_ARG, TAG, "index out of maximum number of LEDs");
+    uint8_t *buf = capture_strip->pixel_buf + index * capture_strip->bytes_per_pixel;
+    // In the order of GRB, as LED strip like WS2812 sends out pixels in this order
+    buf[0] = green & 0xFF;
+    buf[1] = red & 0xFF;
+    buf[2] = blue & 0xFF;
+    if (capture_strip->bytes_per_pixel > 3) {
+        buf[3] = 0;
+    }
+    led_strip_capture_mark_dirty(capture_strip, index + 1);
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_capture_set_pixel_rgbw(led_strip_t *strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue, uint32_t white)
+{
+    led_strip_capture_obj *capture_strip = __containerof(strip, led_strip_capture_obj, base);
+    ESP_RETURN_ON_FALSE(index < capture_strip->strip_len, ESP_ERR_INVALID_ARG, TAG, "index out of maximum number of LEDs");
+    ESP_RETURN_ON_FALSE(capture_strip->bytes_per_pixel == 4, ESP_ERR_INVALID_ARG, TAG, "wrong LED pixel format, expected 4 bytes per pixel");
+    uint8_t *buf = capture_strip->pixel_buf + index * 4;
+    // SK6812 component order is GRBW
+    buf[0] = green & 0xFF;
+    buf[1] = red & 0xFF;
+    buf[2] = blue & 0xFF;
+    buf[3] = white & 0xFF;
+    led_strip_capture_mark_dirty(capture_strip, index + 1);
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_capture_set_pixels(led_strip_t *strip, uint32_t start, uint32_t count, const uint8_t *src, led_pixel_format_t format)
+{
+    led_strip_capture_obj *capture_strip = __containerof(strip, led_strip_capture_obj, base);
+    ESP_RETURN_ON_FALSE(format < LED_PIXEL_FORMAT_INVALID, ESP_ERR_INVALID_ARG, TAG, "invalid led_pixel_format");
+    ESP_RETURN_ON_FALSE(start < capture_strip->strip_len && count <= capture_strip->strip_len - start, ESP_ERR_INVALID_ARG, TAG, "pixels out of maximum number of LEDs");
+    uint8_t src_bytes_per_pixel = format == LED_PIXEL_FORMAT_GRBW ? 4 : 3;
+    ESP_RETURN_ON_FALSE(src_bytes_per_pixel <= capture_strip->bytes_per_pixel, ESP_ERR_INVALID_ARG, TAG, "wrong LED pixel format, the strip has no white component");
+    uint8_t *buf = capture_strip->pixel_buf + start * capture_strip->bytes_per_pixel;
+    if (src_bytes_per_pixel == capture_strip->bytes_per_pixel) {
+        memcpy(buf, src, count * src_bytes_per_pixel);
+    } else {
+        // GRB data on a GRBW strip, turn off the white component
+        for (uint32_t i = 0; i < count; i++) {
+            *buf++ = *src++;
+            *buf++ = *src++;
+            *buf++ = *src++;
+            *buf++ = 0;
+        }
+    }
+    led_strip_capture_mark_dirty(capture_strip, start + count);
+    return ESP_OK;
+}
+
+// record `len` pixels into the ring and put them on the emulated wire, a single frame is on the wire at a time
+static void led_strip_capture_start(led_strip_capture_obj *capture_strip, const uint8_t *pixels, uint32_t len)
+{
+    if (capture_strip->frame_count) {
+        led_strip_capture_wait_until(capture_strip->wire_busy_until_us + capture_strip->reset_us);
+    }
+    int64_t now_us = led_strip_capture_now_us();
+    uint32_t slot = capture_strip->frame_count % capture_strip->frame_num;
+    led_strip_capture_frame_t *frame = &capture_strip->frames[slot];
+    memcpy((uint8_t *)frame->pixels, pixels, len * capture_strip->bytes_per_pixel);
+    frame->len = len;
+    frame->timestamp_us = now_us;
+    capture_strip->frame_count++;
+    uint64_t wire_ns = (uint64_t)len * capture_strip->bytes_per_pixel * 8 * capture_strip->bit_period_ns;
+    capture_strip->wire_busy_until_us = now_us + wire_ns / 1000;
+}
+
+static uint32_t led_strip_capture_refresh_len(const led_strip_capture_obj *capture_strip)
+{
+    if (capture_strip->refresh_mode == LED_STRIP_REFRESH_PREFIX) {
+        // a refresh always sends something, the first pixel if none was modified
+        return capture_strip->dirty_len ? capture_strip->dirty_len : 1;
+    }
+    return capture_strip->strip_len;
+}
+
+static esp_err_t led_strip_capture_refresh_async(led_strip_t *strip)
+{
+    led_strip_capture_obj *capture_strip = __containerof(strip, led_strip_capture_obj, base);
+    led_strip_capture_start(capture_strip, capture_strip->pixel_buf, led_strip_capture_refresh_len(capture_strip));
+    capture_strip->dirty_len = 0;
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_capture_wait_refresh_done(led_strip_t *strip, int32_t timeout_ms)
+{
+    led_strip_capture_obj *capture_strip = __containerof(strip, led_strip_capture_obj, base);
+    if (timeout_ms >= 0 && capture_strip->wire_busy_until_us > led_strip_capture_now_us() + timeout_ms * 1000LL) {
+        led_strip_capture_wait_until(led_strip_capture_now_us() + timeout_ms * 1000LL);
+        return ESP_ERR_TIMEOUT;
+    }
+    led_strip_capture_wait_until(capture_strip->wire_busy_until_us);
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_capture_refresh(led_strip_t *strip)
+{
+    ESP_RETURN_ON_ERROR(led_strip_capture_refresh_async(strip), TAG, "start sending pixels failed");
+    return led_strip_capture_wait_refresh_done(strip, -1);
+}
+
+static esp_err_t led_strip_capture_clear_buffer_only(led_strip_t *strip)
+{
+    led_strip_capture_obj *capture_strip = __containerof(strip, led_strip_capture_obj, base);
+    memset(capture_strip->pixel_buf, 0, capture_strip->strip_len * capture_strip->bytes_per_pixel);
+    capture_strip->dirty_len = capture_strip->strip_len;
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_capture_clear(led_strip_t *strip)
+{
+    ESP_RETURN_ON_ERROR(led_strip_capture_clear_buffer_only(strip), TAG, "clear pixel buffer failed");
+    return led_strip_capture_refresh(strip);
+}
+
+static esp_err_t led_strip_capture_capture_frame(led_strip_t *strip, uint32_t slot)
+{
+    led_strip_capture_obj *capture_strip = __containerof(strip, led_strip_capture_obj, base);
+    uint32_t frame_size = capture_strip->strip_len * capture_strip->bytes_per_pixel;
+    if (!capture_strip->frame_cache[slot]) {
+        capture_strip->frame_cache[slot] = malloc(frame_size);
+        ESP_RETURN_ON_FALSE(capture_strip->frame_cache[slot], ESP_ERR_NO_MEM, TAG, "no mem for frame cache slot");
+    }
+    memcpy(capture_strip->frame_cache[slot], capture_strip->pixel_buf, frame_size);
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_capture_refresh_frame(led_strip_t *strip, uint32_t slot)
+{
+    led_strip_capture_obj *capture_strip = __containerof(strip, led_strip_capture_obj, base);
+    ESP_RETURN_ON_FALSE(capture_strip->frame_cache[slot], ESP_ERR_INVALID_STATE, TAG, "no frame captured in the slot");
+    // the strip no longer shows the pixel buffer
+    capture_strip->dirty_len = capture_strip->strip_len;
+    led_strip_capture_start(capture_strip, capture_strip->frame_cache[slot], capture_strip->strip_len);
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_capture_set_refresh_mode(led_strip_t *strip, led_strip_refresh_mode_t mode)
+{
+    led_strip_capture_obj *capture_strip = __containerof(strip, led_strip_capture_obj, base);
+    capture_strip->refresh_mode = mode;
+    capture_strip->dirty_len = capture_strip->strip_len;
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_capture_get_timing(led_strip_t *strip, led_strip_timing_t *ret_timing)
+{
+    led_strip_capture_obj *capture_strip = __containerof(strip, led_strip_capture_obj, base);
+    // only the wire is emulated, there's no peripheral to set up
+    led_strip_timing_calc(ret_timing, capture_strip->strip_len, capture_strip->bytes_per_pixel, capture_strip->bit_period_ns,
+                          capture_strip->reset_us, 0, 0);
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_capture_del(led_strip_t *strip)
+{
+    led_strip_capture_obj *capture_strip = __containerof(strip, led_strip_capture_obj, base);
+    for (int i = 0; i < CONFIG_LED_STRIP_FRAME_CACHE_SLOTS; i++) {
+        free(capture_strip->frame_cache[i]);
+    }
+    free(capture_strip->frames);
+    free(capture_strip->ring_buf);
+    free(capture_strip);
+    return ESP_OK;
+}
+
+esp_err_t led_strip_capture_get_count(led_strip_handle_t strip, uint32_t *ret_count)
+{
+    ESP_RETURN_ON_FALSE(strip && strip->del == led_strip_capture_del && ret_count, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    led_strip_capture_obj *capture_strip = __containerof(strip, led_strip_capture_obj, base);
+    *ret_count = capture_strip->frame_count;
+    return ESP_OK;
+}
+
+esp_err_t led_strip_capture_get_frame(led_strip_handle_t strip, uint32_t age, led_strip_capture_frame_t *ret_frame)
+{
+    ESP_RETURN_ON_FALSE(strip && strip->del == led_strip_capture_del && ret_frame, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    led_strip_capture_obj *capture_strip = __containerof(strip, led_strip_capture_obj, base);
+    ESP_RETURN_ON_FALSE(age < capture_strip->frame_count && age < capture_strip->frame_num, ESP_ERR_NOT_FOUND, TAG, "frame not in the capture ring");
+    *ret_frame = capture_strip->frames[(capture_strip->frame_count - 1 - age) % capture_strip->frame_num];
+    return ESP_OK;
+}
+
+esp_err_t led_strip_new_capture_device(const led_strip_config_t *led_config, const led_strip_capture_config_t *capture_config, led_strip_handle_t *ret_strip)
+{
+    led_strip_capture_obj *capture_strip = NULL;
+    esp_err_t ret = ESP_OK;
+    ESP_GOTO_ON_FALSE(led_config && capture_config && ret_strip, ESP_ERR_INVALID_ARG, err, TAG, "invalid argument");
+    ESP_GOTO_ON_FALSE(led_config->led_pixel_format < LED_PIXEL_FORMAT_INVALID, ESP_ERR_INVALID_ARG, err, TAG, "invalid led_pixel_format");
+    ESP_GOTO_ON_FALSE(led_config->max_leds && capture_config->frame_num, ESP_ERR_INVALID_ARG, err, TAG, "empty strip or capture ring");
+    uint8_t bytes_per_pixel = led_config->led_pixel_format == LED_PIXEL_FORMAT_GRBW ? 4 : 3;
+    uint32_t frame_size = led_config->max_leds * bytes_per_pixel;
+    capture_strip = calloc(1, sizeof(led_strip_capture_obj) + frame_size);
+    ESP_GOTO_ON_FALSE(capture_strip, ESP_ERR_NO_MEM, err, TAG, "no mem for capture strip");
+    // the whole ring is allocated upfront, so that a refresh doesn't allocate
+    capture_strip->frames = calloc(capture_config->frame_num, sizeof(led_strip_capture_frame_t));
+    capture_strip->ring_buf = calloc(capture_config->frame_num, frame_size);
+    ESP_GOTO_ON_FALSE(capture_strip->frames && capture_strip->ring_buf, ESP_ERR_NO_MEM, err, TAG, "no mem for capture ring");
+    for (uint32_t i = 0; i < capture_config->frame_num; i++) {
+        capture_strip->frames[i].pixels = capture_strip->ring_buf + i * frame_size;
+    }
+
+    capture_strip->bytes_per_pixel = bytes_per_pixel;
+    capture_strip->strip_len = led_config->max_leds;
+    capture_strip->dirty_len = led_config->max_leds;
+    capture_strip->bit_period_ns = capture_config->bit_period_ns;
+    capture_strip->reset_us = capture_config->reset_us;
+    capture_strip->frame_num = capture_config->frame_num;
+    capture_strip->base.set_pixel = led_strip_capture_set_pixel;
+    capture_strip->base.set_pixel_rgbw = led_strip_capture_set_pixel_rgbw;
+    capture_strip->base.set_pixels = led_strip_capture_set_pixels;
+    capture_strip->base.refresh = led_strip_capture_refresh;
+    capture_strip->base.refresh_async = led_strip_capture_refresh_async;
+    capture_strip->base.wait_refresh_done = led_strip_capture_wait_refresh_done;
+    capture_strip->base.clear = led_strip_capture_clear;
+    capture_strip->base.clear_buffer_only = led_strip_capture_clear_buffer_only;
+    capture_strip->base.capture_frame = led_strip_capture_capture_frame;
+    capture_strip->base.refresh_frame = led_strip_capture_refresh_frame;
+    capture_strip->base.set_refresh_mode = led_strip_capture_set_refresh_mode;
+    capture_strip->base.get_timing = led_strip_capture_get_timing;
+    capture_strip->base.del = led_strip_capture_del;
+
+    led_strip_timing_t strip_timing;
+    led_strip_capture_get_timing(&capture_strip->base, &strip_timing);
+    ESP_LOGI(TAG, "%"PRIu32" LEDs: %"PRIu32"us on the wire + %"PRIu32"us reset + %"PRIu32"us setup, up to %"PRIu32" fps",
+             capture_strip->strip_len, strip_timing.wire_time_us, strip_timing.reset_us, strip_timing.setup_us, strip_timing.max_fps);
+    *ret_strip = &capture_strip->base;
+    return ESP_OK;
+err:
+    if (capture_strip) {
+        free(capture_strip->frames);
+        free(capture_strip->ring_buf);
+        free(capture_strip);
+    }
+    return ret;
+}
@@ -0,0 +1,35 @@
+/*
+ * SPDX-FileCopyrightText: 2022-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "led_strip_timing.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Wait for whatever is left of the reset time after the previous frame
+ *
+ * The line idles low once a frame has been sent, so the reset time runs on its own while the caller
+ * prepares the next frame. Only the part that hasn't elapsed yet is spent here.
+ *
+ * @param frame_end_us: time at which the previous frame finished, as given by `esp_timer_get_time`
+ */
+static inline void led_strip_wait_reset(int64_t frame_end_us)
+{
+    int64_t left_us = frame_end_us + LED_STRIP_RESET_US - esp_timer_get_time();
+    if (left_us > 0) {
+        esp_rom_delay_us(left_us);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
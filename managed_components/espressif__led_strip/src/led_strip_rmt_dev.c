@@ -4,14 +4,18 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 #include <stdlib.h>
+#include <inttypes.h>
 #include <string.h>
 #include <sys/cdefs.h>
 #include "esp_log.h"
 #include "esp_check.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
 #include "driver/rmt_tx.h"
 #include "led_strip.h"
 #include "led_strip_interface.h"
 #include "led_strip_rmt_encoder.h"
+#include "led_strip_reset.h"
 
 #define LED_STRIP_RMT_DEFAULT_RESOLUTION 10000000 // 10MHz resolution
 #define LED_STRIP_RMT_DEFAULT_TRANS_QUEUE_SIZE 4
@@ -28,15 +32,74 @@ typedef struct {
     led_strip_t base;
     rmt_channel_handle_t rmt_chan;
     rmt_encoder_handle_t strip_encoder;
+    led_strip_encoder_config_t encoder_config; // configuration of the strip encoder, kept to switch over to the nibble encoder
     uint32_t strip_len;
+    uint32_t dirty_len; // number of pixels from the start of the strip modified since the last refresh
+    led_strip_refresh_mode_t refresh_mode;
     uint8_t bytes_per_pixel;
-    uint8_t pixel_buf[];
+    bool persistent_enable;  // the channel stays enabled between frames
+    bool enabled;            // the channel is enabled
+    bool trans_pending;      // a frame queued by an asynchronous refresh hasn't been waited for yet
+    bool fb_acquired;        // the pixel buffer is handed out by get_framebuffer, until commit
+    int64_t frame_end_us;    // time at which the last frame finished, the reset time runs from there
+    led_strip_refresh_done_cb_t on_refresh_done; // user callback, invoked when a frame has been sent
+    void *user_ctx;          // user context of the callback
+    const uint8_t *tx_buf;   // pixels of the frame being sent
+    uint8_t *pixel_buf;      // buffer that the pixels are written into
+    uint8_t *spare_buf;      // the other buffer of a double buffered strip, NULL otherwise
+    uint8_t *frame_cache[CONFIG_LED_STRIP_FRAME_CACHE_SLOTS]; // pixels captured by the user, allocated on first capture
+    uint8_t *dither_residual; // dithering state of the encoder, NULL without dithering
+    uint8_t frame_buf[];
 } led_strip_rmt_obj;
 
+static bool IRAM_ATTR led_strip_rmt_trans_done(rmt_channel_handle_t tx_chan, const rmt_tx_done_event_data_t *edata, void *user_ctx)
+{
+    led_strip_rmt_obj *rmt_strip = (led_strip_rmt_obj *)user_ctx;
+    rmt_strip->frame_end_us = esp_timer_get_time();
+    if (rmt_strip->on_refresh_done) {
+        return rmt_strip->on_refresh_done(&rmt_strip->base, rmt_strip->user_ctx);
+    }
+    return false;
+}
+
+static esp_err_t led_strip_rmt_wait_done(led_strip_rmt_obj *rmt_strip, int timeout_ms)
+{
+    if (rmt_strip->trans_pending) {
+        esp_err_t ret = rmt_tx_wait_all_done(rmt_strip->rmt_chan, timeout_ms);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        rmt_strip->trans_pending = false;
+    }
+    if (rmt_strip->enabled && !rmt_strip->persistent_enable) {
+        ESP_RETURN_ON_ERROR(rmt_disable(rmt_strip->rmt_chan), TAG, "disable RMT channel failed");
+        rmt_strip->enabled = false;
+    }
+    return ESP_OK;
+}
+
+// the encoder reads the pixels while the frame is being sent, they can't be modified in the meantime
+static inline esp_err_t led_strip_rmt_wait_writable(led_strip_rmt_obj *rmt_strip, const uint8_t *buf)
+{
+    if (rmt_strip->trans_pending && rmt_strip->tx_buf == buf) {
+        return led_strip_rmt_wait_done(rmt_strip, -1);
+    }
+    return ESP_OK;
+}
+
+static inline void led_strip_rmt_mark_dirty(led_strip_rmt_obj *rmt_strip, uint32_t end)
+{
+    if (end > rmt_strip->dirty_len) {
+        rmt_strip->dirty_len = end;
+    }
+}
+
 static esp_err_t led_strip_rmt_set_pixel(led_strip_t *strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue)
 {
     led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    ESP_RETURN_ON_FALSE(!rmt_strip->fb_acquired, ESP_ERR_INVALID_STATE, TAG, "framebuffer is being rendered, commit it instead");
     ESP_RETURN_ON_FALSE(index < rmt_strip->strip_len, ESP_ERR_INVALID_ARG, TAG, "index out of maximum number of LEDs");
+    ESP_RETURN_ON_ERROR(led_strip_rmt_wait_writable(rmt_strip, rmt_strip->pixel_buf), TAG, "wait for pending frame failed");
     uint32_t start = index * rmt_strip->bytes_per_pixel;
     // In thr order of GRB, as LED strip like WS2812 sends out pixels in this order
     rmt_strip->pixel_buf[start + 0] = green & 0xFF;
@@ -45,51 +108,273 @@ static esp_err_t led_strip_rmt_set_pixel(led_strip_t *strip, uint32_t index, uin
     if (rmt_strip->bytes_per_pixel > 3) {
         rmt_strip->pixel_buf[start + 3] = 0;
     }
+    led_strip_rmt_mark_dirty(rmt_strip, index + 1);
     return ESP_OK;
 }
 
 static esp_err_t led_strip_rmt_set_pixel_rgbw(led_strip_t *strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue, uint32_t white)
 {
     led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    ESP_RETURN_ON_FALSE(!rmt_strip->fb_acquired, ESP_ERR_INVALID_STATE, TAG, "framebuffer is being rendered, commit it instead");
     ESP_RETURN_ON_FALSE(index < rmt_strip->strip_len, ESP_ERR_INVALID_ARG, TAG, "index out of maximum number of LEDs");
     ESP_RETURN_ON_FALSE(rmt_strip->bytes_per_pixel == 4, ESP_ERR_INVALID_ARG, TAG, "wrong LED pixel format, expected 4 bytes per pixel");
+    ESP_RETURN_ON_ERROR(led_strip_rmt_wait_writable(rmt_strip, rmt_strip->pixel_buf), TAG, "wait for pending frame failed");
     uint8_t *buf_start = rmt_strip->pixel_buf + index * 4;
     // SK6812 component order is GRBW
     *buf_start = green & 0xFF;
     *++buf_start = red & 0xFF;
     *++buf_start = blue & 0xFF;
     *++buf_start = white & 0xFF;
+    led_strip_rmt_mark_dirty(rmt_strip, index + 1);
     return ESP_OK;
 }
 
-static esp_err_t led_strip_rmt_refresh(led_strip_t *strip)
+static esp_err_t led_strip_rmt_set_pixels(led_strip_t *strip, uint32_t start, uint32_t count, const uint8_t *src, led_pixel_format_t format)
 {
     led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    ESP_RETURN_ON_FALSE(!rmt_strip->fb_acquired, ESP_ERR_INVALID_STATE, TAG, "framebuffer is being rendered, commit it instead");
+    ESP_RETURN_ON_FALSE(format < LED_PIXEL_FORMAT_INVALID, ESP_ERR_INVALID_ARG, TAG, "invalid led_pixel_format");
+    ESP_RETURN_ON_FALSE(start < rmt_strip->strip_len && count <= rmt_strip->strip_len - start, ESP_ERR_INVALID_ARG, TAG, "pixels out of maximum number of LEDs");
+    uint8_t src_bytes_per_pixel = format == LED_PIXEL_FORMAT_GRBW ? 4 : 3;
+    ESP_RETURN_ON_FALSE(src_bytes_per_pixel <= rmt_strip->bytes_per_pixel, ESP_ERR_INVALID_ARG, TAG, "wrong LED pixel format, the strip has no white component");
+    ESP_RETURN_ON_ERROR(led_strip_rmt_wait_writable(rmt_strip, rmt_strip->pixel_buf), TAG, "wait for pending frame failed");
+    uint8_t *buf = rmt_strip->pixel_buf + start * rmt_strip->bytes_per_pixel;
+    if (src_bytes_per_pixel == rmt_strip->bytes_per_pixel) {
+        // the buffer is already kept in the wire order, copy the whole span at once
+        memcpy(buf, src, count * src_bytes_per_pixel);
+    } else {
+        // GRB data on a GRBW strip, turn off the white component
+        for (uint32_t i = 0; i < count; i++) {
+            *buf++ = *src++;
+            *buf++ = *src++;
+            *buf++ = *src++;
+            *buf++ = 0;
+        }
+    }
+    led_strip_rmt_mark_dirty(rmt_strip, start + count);
+    return ESP_OK;
+}
+
+// start sending `len` pixels, a single frame is in flight at a time
+static esp_err_t led_strip_rmt_start(led_strip_rmt_obj *rmt_strip, const uint8_t *pixels, uint32_t len)
+{
     rmt_transmit_config_t tx_conf = {
         .loop_count = 0,
     };
 
-    ESP_RETURN_ON_ERROR(rmt_enable(rmt_strip->rmt_chan), TAG, "enable RMT channel failed");
-    ESP_RETURN_ON_ERROR(rmt_transmit(rmt_strip->rmt_chan, rmt_strip->strip_encoder, rmt_strip->pixel_buf,
-                                     rmt_strip->strip_len * rmt_strip->bytes_per_pixel, &tx_conf), TAG, "transmit pixels by RMT failed");
-    ESP_RETURN_ON_ERROR(rmt_tx_wait_all_done(rmt_strip->rmt_chan, -1), TAG, "flush RMT channel failed");
-    ESP_RETURN_ON_ERROR(rmt_disable(rmt_strip->rmt_chan), TAG, "disable RMT channel failed");
+    ESP_RETURN_ON_ERROR(led_strip_rmt_wait_done(rmt_strip, -1), TAG, "wait for pending frame failed");
+    if (!rmt_strip->enabled) {
+        ESP_RETURN_ON_ERROR(rmt_enable(rmt_strip->rmt_chan), TAG, "enable RMT channel failed");
+        rmt_strip->enabled = true;
+    }
+    led_strip_wait_reset(rmt_strip->frame_end_us);
+    ESP_RETURN_ON_ERROR(rmt_transmit(rmt_strip->rmt_chan, rmt_strip->strip_encoder, pixels,
+                                     len * rmt_strip->bytes_per_pixel, &tx_conf), TAG, "transmit pixels by RMT failed");
+    rmt_strip->tx_buf = pixels;
+    rmt_strip->trans_pending = true;
     return ESP_OK;
 }
 
-static esp_err_t led_strip_rmt_clear(led_strip_t *strip)
+static esp_err_t led_strip_rmt_send(led_strip_rmt_obj *rmt_strip, const uint8_t *pixels, uint32_t len)
+{
+    ESP_RETURN_ON_ERROR(led_strip_rmt_start(rmt_strip, pixels, len), TAG, "start sending pixels failed");
+    ESP_RETURN_ON_ERROR(led_strip_rmt_wait_done(rmt_strip, -1), TAG, "flush RMT channel failed");
+    return ESP_OK;
+}
+
+static uint32_t led_strip_rmt_refresh_len(const led_strip_rmt_obj *rmt_strip)
+{
+    if (rmt_strip->refresh_mode == LED_STRIP_REFRESH_PREFIX) {
+        // a refresh always sends something, the first pixel if none was modified
+        return rmt_strip->dirty_len ? rmt_strip->dirty_len : 1;
+    }
+    return rmt_strip->strip_len;
+}
+
+static esp_err_t led_strip_rmt_refresh(led_strip_t *strip)
 {
     led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
-    // Write zero to turn off all leds
+    ESP_RETURN_ON_FALSE(!rmt_strip->fb_acquired, ESP_ERR_INVALID_STATE, TAG, "framebuffer is being rendered, commit it instead");
+    ESP_RETURN_ON_ERROR(led_strip_rmt_send(rmt_strip, rmt_strip->pixel_buf, led_strip_rmt_refresh_len(rmt_strip)), TAG, "send pixels failed");
+    rmt_strip->dirty_len = 0;
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_rmt_refresh_async(led_strip_t *strip)
+{
+    led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    ESP_RETURN_ON_FALSE(!rmt_strip->fb_acquired, ESP_ERR_INVALID_STATE, TAG, "framebuffer is being rendered, commit it instead");
+    ESP_RETURN_ON_ERROR(led_strip_rmt_start(rmt_strip, rmt_strip->pixel_buf, led_strip_rmt_refresh_len(rmt_strip)), TAG, "start sending pixels failed");
+    rmt_strip->dirty_len = 0;
+
+    if (rmt_strip->spare_buf) {
+        // keep writing into the other buffer, starting from the frame just queued
+        uint8_t *sent_buf = rmt_strip->pixel_buf;
+        rmt_strip->pixel_buf = rmt_strip->spare_buf;
+        rmt_strip->spare_buf = sent_buf;
+        memcpy(rmt_strip->pixel_buf, sent_buf, rmt_strip->strip_len * rmt_strip->bytes_per_pixel);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_rmt_wait_refresh_done(led_strip_t *strip, int32_t timeout_ms)
+{
+    led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    return led_strip_rmt_wait_done(rmt_strip, timeout_ms);
+}
+
+static esp_err_t led_strip_rmt_register_event_callbacks(led_strip_t *strip, const led_strip_event_callbacks_t *cbs, void *user_ctx)
+{
+    led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    // don't swap the callback under the feet of a frame in flight
+    ESP_RETURN_ON_ERROR(led_strip_rmt_wait_done(rmt_strip, -1), TAG, "wait for pending frame failed");
+    rmt_strip->user_ctx = user_ctx;
+    rmt_strip->on_refresh_done = cbs->on_refresh_done;
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_rmt_capture_frame(led_strip_t *strip, uint32_t slot)
+{
+    led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    uint32_t frame_size = rmt_strip->strip_len * rmt_strip->bytes_per_pixel;
+    ESP_RETURN_ON_FALSE(!rmt_strip->fb_acquired, ESP_ERR_INVALID_STATE, TAG, "framebuffer is being rendered, commit it instead");
+    if (!rmt_strip->frame_cache[slot]) {
+        rmt_strip->frame_cache[slot] = malloc(frame_size);
+        ESP_RETURN_ON_FALSE(rmt_strip->frame_cache[slot], ESP_ERR_NO_MEM, TAG, "no mem for frame cache slot");
+    }
+    ESP_RETURN_ON_ERROR(led_strip_rmt_wait_writable(rmt_strip, rmt_strip->frame_cache[slot]), TAG, "wait for pending frame failed");
+    memcpy(rmt_strip->frame_cache[slot], rmt_strip->pixel_buf, frame_size);
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_rmt_refresh_frame(led_strip_t *strip, uint32_t slot)
+{
+    led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    ESP_RETURN_ON_FALSE(!rmt_strip->fb_acquired, ESP_ERR_INVALID_STATE, TAG, "framebuffer is being rendered, commit it instead");
+    ESP_RETURN_ON_FALSE(rmt_strip->frame_cache[slot], ESP_ERR_INVALID_STATE, TAG, "no frame captured in the slot");
+    // the strip no longer shows the pixel buffer
+    rmt_strip->dirty_len = rmt_strip->strip_len;
+    return led_strip_rmt_start(rmt_strip, rmt_strip->frame_cache[slot], rmt_strip->strip_len);
+}
+
+static esp_err_t led_strip_rmt_clear_buffer_only(led_strip_t *strip)
+{
+    led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    ESP_RETURN_ON_FALSE(!rmt_strip->fb_acquired, ESP_ERR_INVALID_STATE, TAG, "framebuffer is being rendered, commit it instead");
+    ESP_RETURN_ON_ERROR(led_strip_rmt_wait_writable(rmt_strip, rmt_strip->pixel_buf), TAG, "wait for pending frame failed");
+    // Write zero to turn off all leds, the encoder turns the raw bytes into symbols on the fly so there's nothing else to reset
     memset(rmt_strip->pixel_buf, 0, rmt_strip->strip_len * rmt_strip->bytes_per_pixel);
+    rmt_strip->dirty_len = rmt_strip->strip_len;
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_rmt_set_refresh_mode(led_strip_t *strip, led_strip_refresh_mode_t mode)
+{
+    led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    rmt_strip->refresh_mode = mode;
+    rmt_strip->dirty_len = rmt_strip->strip_len;
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_rmt_clear(led_strip_t *strip)
+{
+    led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    ESP_RETURN_ON_FALSE(!rmt_strip->fb_acquired, ESP_ERR_INVALID_STATE, TAG, "framebuffer is being rendered, commit it instead");
+    ESP_RETURN_ON_ERROR(led_strip_rmt_clear_buffer_only(strip), TAG, "clear pixel buffer failed");
     return led_strip_rmt_refresh(strip);
 }
 
+static esp_err_t led_strip_rmt_get_timing(led_strip_t *strip, led_strip_timing_t *ret_timing)
+{
+    led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    // the channel is enabled before waiting for the reset time, the transmission is started after
+    led_strip_timing_calc(ret_timing, rmt_strip->strip_len, rmt_strip->bytes_per_pixel, LED_STRIP_RMT_BIT_PERIOD_NS, LED_STRIP_RESET_US,
+                          rmt_strip->persistent_enable ? 0 : LED_STRIP_RMT_ENABLE_US, LED_STRIP_RMT_SETUP_US);
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_rmt_get_framebuffer(led_strip_t *strip, uint8_t **ret_buf, uint32_t *ret_len, led_pixel_format_t *ret_format)
+{
+    led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    ESP_RETURN_ON_ERROR(led_strip_rmt_wait_writable(rmt_strip, rmt_strip->pixel_buf), TAG, "wait for pending frame failed");
+    // there's no telling which pixels get rendered, the commit sends them all
+    rmt_strip->dirty_len = rmt_strip->strip_len;
+    rmt_strip->fb_acquired = true;
+    *ret_buf = rmt_strip->pixel_buf;
+    *ret_len = rmt_strip->strip_len * rmt_strip->bytes_per_pixel;
+    *ret_format = rmt_strip->bytes_per_pixel == 4 ? LED_PIXEL_FORMAT_GRBW : LED_PIXEL_FORMAT_GRB;
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_rmt_commit(led_strip_t *strip)
+{
+    led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    ESP_RETURN_ON_FALSE(rmt_strip->fb_acquired, ESP_ERR_INVALID_STATE, TAG, "framebuffer not acquired");
+    rmt_strip->fb_acquired = false;
+    return led_strip_rmt_refresh_async(strip);
+}
+
+// only the nibble encoder scales the bytes, it replaces the bytes encoder for good
+static esp_err_t led_strip_rmt_use_nibble_encoder(led_strip_rmt_obj *rmt_strip)
+{
+    led_strip_encoder_config_t config = rmt_strip->encoder_config;
+    config.flags.nibble_encoder = true;
+    rmt_encoder_handle_t encoder = NULL;
+    ESP_RETURN_ON_ERROR(rmt_new_led_strip_encoder(&config, &encoder), TAG, "create nibble encoder failed");
+    rmt_del_encoder(rmt_strip->strip_encoder);
+    rmt_strip->strip_encoder = encoder;
+    rmt_strip->encoder_config = config;
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_rmt_set_brightness(led_strip_t *strip, uint16_t brightness, bool dither)
+{
+    led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    ESP_RETURN_ON_FALSE(!rmt_strip->fb_acquired, ESP_ERR_INVALID_STATE, TAG, "framebuffer is being rendered, commit it instead");
+    // the encoder scales the bytes while the frame is sent
+    ESP_RETURN_ON_ERROR(led_strip_rmt_wait_done(rmt_strip, -1), TAG, "wait for pending frame failed");
+    uint8_t *residual = NULL;
+    if (dither) {
+        residual = rmt_strip->dither_residual;
+        if (!residual) {
+            // read by the encoder, which may run in the ISR
+            residual = heap_caps_calloc(1, rmt_strip->strip_len * rmt_strip->bytes_per_pixel, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+            ESP_RETURN_ON_FALSE(residual, ESP_ERR_NO_MEM, TAG, "no mem for dithering state");
+        }
+    }
+    esp_err_t ret = rmt_led_strip_encoder_set_brightness(rmt_strip->strip_encoder, brightness, residual);
+    if (ret == ESP_ERR_NOT_SUPPORTED && !rmt_strip->encoder_config.flags.nibble_encoder) {
+        ret = led_strip_rmt_use_nibble_encoder(rmt_strip);
+        if (ret == ESP_OK) {
+            ret = rmt_led_strip_encoder_set_brightness(rmt_strip->strip_encoder, brightness, residual);
+        }
+    }
+    if (ret != ESP_OK) {
+        if (residual != rmt_strip->dither_residual) {
+            free(residual);
+        }
+        return ret;
+    }
+    // dithering switched on or off
+    if (residual != rmt_strip->dither_residual) {
+        free(rmt_strip->dither_residual);
+        rmt_strip->dither_residual = residual;
+    }
+    return ESP_OK;
+}
+
 static esp_err_t led_strip_rmt_del(led_strip_t *strip)
 {
     led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    // the channel must be disabled before it's deleted
+    rmt_strip->persistent_enable = false;
+    ESP_RETURN_ON_ERROR(led_strip_rmt_wait_done(rmt_strip, -1), TAG, "wait for pending frame failed");
     ESP_RETURN_ON_ERROR(rmt_del_channel(rmt_strip->rmt_chan), TAG, "delete RMT channel failed");
     ESP_RETURN_ON_ERROR(rmt_del_encoder(rmt_strip->strip_encoder), TAG, "delete strip encoder failed");
+    for (int i = 0; i < CONFIG_LED_STRIP_FRAME_CACHE_SLOTS; i++) {
+        free(rmt_strip->frame_cache[i]);
+    }
+    free(rmt_strip->dither_residual);
     free(rmt_strip);
     return ESP_OK;
 }
@@ -108,7 +393,8 @@ esp_err_t led_strip_new_rmt_device(const led_strip_config_t *led_config, const l
     } else {
         assert(false);
     }
-    rmt_strip = calloc(1, sizeof(led_strip_rmt_obj) + led_config->max_leds * bytes_per_pixel);
+    uint8_t frame_num = rmt_config->flags.double_buffer ? 2 : 1;
+    rmt_strip = calloc(1, sizeof(led_strip_rmt_obj) + frame_num * led_config->max_leds * bytes_per_pixel);
     ESP_GOTO_ON_FALSE(rmt_strip, ESP_ERR_NO_MEM, err, TAG, "no mem for rmt strip");
     uint32_t resolution = rmt_config->resolution_hz ? rmt_config->resolution_hz : LED_STRIP_RMT_DEFAULT_RESOLUTION;
 
@@ -133,25 +419,60 @@ esp_err_t led_strip_new_rmt_device(const led_strip_config_t *led_config, const l
     };
     ESP_GOTO_ON_ERROR(rmt_new_tx_channel(&rmt_chan_config, &rmt_strip->rmt_chan), err, TAG, "create RMT TX channel failed");
 
-    led_strip_encoder_config_t strip_encoder_conf = {
+    rmt_strip->encoder_config = (led_strip_encoder_config_t) {
         .resolution = resolution,
-        .led_model = led_config->led_model
+        .led_model = led_config->led_model,
+        .flags.nibble_encoder = rmt_config->flags.nibble_encoder,
     };
-    ESP_GOTO_ON_ERROR(rmt_new_led_strip_encoder(&strip_encoder_conf, &rmt_strip->strip_encoder), err, TAG, "create LED strip encoder failed");
+    ESP_GOTO_ON_ERROR(rmt_new_led_strip_encoder(&rmt_strip->encoder_config, &rmt_strip->strip_encoder), err, TAG, "create LED strip encoder failed");
+
+    rmt_tx_event_callbacks_t cbs = {
+        .on_trans_done = led_strip_rmt_trans_done,
+    };
+    ESP_GOTO_ON_ERROR(rmt_tx_register_event_callbacks(rmt_strip->rmt_chan, &cbs, rmt_strip), err, TAG, "register RMT callbacks failed");
+    if (rmt_config->flags.persistent_enable) {
+        ESP_GOTO_ON_ERROR(rmt_enable(rmt_strip->rmt_chan), err, TAG, "enable RMT channel failed");
+        rmt_strip->enabled = true;
+        rmt_strip->persistent_enable = true;
+    }
 
 
     rmt_strip->bytes_per_pixel = bytes_per_pixel;
     rmt_strip->strip_len = led_config->max_leds;
+    rmt_strip->dirty_len = led_config->max_leds;
+    rmt_strip->pixel_buf = rmt_strip->frame_buf;
+    if (rmt_config->flags.double_buffer) {
+        rmt_strip->spare_buf = rmt_strip->frame_buf + led_config->max_leds * bytes_per_pixel;
+    }
     rmt_strip->base.set_pixel = led_strip_rmt_set_pixel;
     rmt_strip->base.set_pixel_rgbw = led_strip_rmt_set_pixel_rgbw;
+    rmt_strip->base.set_pixels = led_strip_rmt_set_pixels;
     rmt_strip->base.refresh = led_strip_rmt_refresh;
+    rmt_strip->base.refresh_async = led_strip_rmt_refresh_async;
+    rmt_strip->base.wait_refresh_done = led_strip_rmt_wait_refresh_done;
+    rmt_strip->base.register_event_callbacks = led_strip_rmt_register_event_callbacks;
     rmt_strip->base.clear = led_strip_rmt_clear;
+    rmt_strip->base.clear_buffer_only = led_strip_rmt_clear_buffer_only;
+    rmt_strip->base.capture_frame = led_strip_rmt_capture_frame;
+    rmt_strip->base.refresh_frame = led_strip_rmt_refresh_frame;
+    rmt_strip->base.set_refresh_mode = led_strip_rmt_set_refresh_mode;
+    rmt_strip->base.get_timing = led_strip_rmt_get_timing;
+    rmt_strip->base.get_framebuffer = led_strip_rmt_get_framebuffer;
+    rmt_strip->base.commit = led_strip_rmt_commit;
+    rmt_strip->base.set_brightness = led_strip_rmt_set_brightness;
     rmt_strip->base.del = led_strip_rmt_del;
 
+    led_strip_timing_t strip_timing;
+    led_strip_rmt_get_timing(&rmt_strip->base, &strip_timing);
+    ESP_LOGI(TAG, "%"PRIu32" LEDs: %"PRIu32"us on the wire + %"PRIu32"us reset + %"PRIu32"us setup, up to %"PRIu32" fps",
+             rmt_strip->strip_len, strip_timing.wire_time_us, strip_timing.reset_us, strip_timing.setup_us, strip_timing.max_fps);
     *ret_strip = &rmt_strip->base;
     return ESP_OK;
 err:
     if (rmt_strip) {
+        if (rmt_strip->enabled) {
+            rmt_disable(rmt_strip->rmt_chan);
+        }
         if (rmt_strip->rmt_chan) {
             rmt_del_channel(rmt_strip->rmt_chan);
         }
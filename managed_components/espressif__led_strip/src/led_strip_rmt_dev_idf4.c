@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 #include <stdlib.h>
+#include <inttypes.h>
 #include <string.h>
 #include <sys/cdefs.h>
 #include "esp_log.h"
@@ -11,6 +12,7 @@
 #include "driver/rmt.h"
 #include "led_strip.h"
 #include "led_strip_interface.h"
+#include "led_strip_reset.h"
 
 static const char *TAG = "led_strip_rmt";
 
@@ -24,8 +26,6 @@ static const char *TAG = "led_strip_rmt";
 #define SK6812_T1H_NS   (600)
 #define SK6812_T1L_NS   (600)
 
-#define LED_STRIP_RESET_MS (10)
-
 // the memory size of each RMT channel, in words (4 bytes)
 #if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
 #define LED_STRIP_RMT_DEFAULT_MEM_BLOCK_SYMBOLS 64
@@ -33,16 +33,20 @@ static const char *TAG = "led_strip_rmt";
 #define LED_STRIP_RMT_DEFAULT_MEM_BLOCK_SYMBOLS 48
 #endif
 
-static uint32_t led_t0h_ticks = 0;
-static uint32_t led_t1h_ticks = 0;
-static uint32_t led_t0l_ticks = 0;
-static uint32_t led_t1l_ticks = 0;
+// RMT items of the 4 bits of every nibble, MSB first, built for the LED timing when a strip is created
+// the translator has no per channel context, every strip uses the timing of the last one created
+static DRAM_ATTR rmt_item32_t s_nibble_items[16][4];
 
 typedef struct {
     led_strip_t base;
     rmt_channel_t rmt_channel;
     uint32_t strip_len;
+    uint32_t dirty_len; // number of pixels from the start of the strip modified since the last refresh
+    led_strip_refresh_mode_t refresh_mode;
     uint8_t bytes_per_pixel;
+    uint32_t bit_period_ns;
+    int64_t frame_end_us; // time at which the last frame finished, the reset time runs from there
+    uint8_t *frame_cache[CONFIG_LED_STRIP_FRAME_CACHE_SLOTS]; // pixels captured by the user, allocated on first capture
     uint8_t buffer[0];
 } led_strip_rmt_obj;
 
@@ -54,23 +58,24 @@ static void IRAM_ATTR ws2812_rmt_adapter(const void *src, rmt_item32_t *dest, si
         *item_num = 0;
         return;
     }
-    const rmt_item32_t bit0 = {{{ led_t0h_ticks, 1, led_t0l_ticks, 0 }}}; //Logical 0
-    const rmt_item32_t bit1 = {{{ led_t1h_ticks, 1, led_t1l_ticks, 0 }}}; //Logical 1
     size_t size = 0;
     size_t num = 0;
-    uint8_t *psrc = (uint8_t *)src;
-    rmt_item32_t *pdest = dest;
-    while (size < src_size && num < wanted_num) {
-        for (int i = 0; i < 8; i++) {
-            // MSB first
-            if (*psrc & (1 << (7 - i))) {
-                pdest->val =  bit1.val;
-            } else {
-                pdest->val =  bit0.val;
-            }
-            num++;
-            pdest++;
-        }
+    const uint8_t *psrc = (const uint8_t *)src;
+    uint32_t *pdest = (uint32_t *)dest;
+    // a byte is two table rows of 4 items, copied word by word
+    while (size < src_size && num + 8 <= wanted_num) {
+        const rmt_item32_t *high = s_nibble_items[*psrc >> 4];
+        const rmt_item32_t *low = s_nibble_items[*psrc & 0x0F];
+        pdest[0] = high[0].val;
+        pdest[1] = high[1].val;
+        pdest[2] = high[2].val;
+        pdest[3] = high[3].val;
+        pdest[4] = low[0].val;
+        pdest[5] = low[1].val;
+        pdest[6] = low[2].val;
+        pdest[7] = low[3].val;
+        pdest += 8;
+        num += 8;
         size++;
         psrc++;
     }
@@ -78,6 +83,13 @@ static void IRAM_ATTR ws2812_rmt_adapter(const void *src, rmt_item32_t *dest, si
     *item_num = num;
 }
 
+static inline void led_strip_rmt_mark_dirty(led_strip_rmt_obj *rmt_strip, uint32_t end)
+{
+    if (end > rmt_strip->dirty_len) {
+        rmt_strip->dirty_len = end;
+    }
+}
+
 static esp_err_t led_strip_rmt_set_pixel(led_strip_t *strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue)
 {
     led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
@@ -90,30 +102,117 @@ static esp_err_t led_strip_rmt_set_pixel(led_strip_t *strip, uint32_t index, uin
     if (rmt_strip->bytes_per_pixel > 3) {
         rmt_strip->buffer[start + 3] = 0;
     }
+    led_strip_rmt_mark_dirty(rmt_strip, index + 1);
     return ESP_OK;
 }
 
-static esp_err_t led_strip_rmt_refresh(led_strip_t *strip)
+static esp_err_t led_strip_rmt_set_pixels(led_strip_t *strip, uint32_t start, uint32_t count, const uint8_t *src, led_pixel_format_t format)
 {
     led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
-    ESP_RETURN_ON_ERROR(rmt_write_sample(rmt_strip->rmt_channel, rmt_strip->buffer, rmt_strip->strip_len * rmt_strip->bytes_per_pixel, true), TAG,
+    ESP_RETURN_ON_FALSE(format < LED_PIXEL_FORMAT_INVALID, ESP_ERR_INVALID_ARG, TAG, "invalid led_pixel_format");
+    ESP_RETURN_ON_FALSE(start < rmt_strip->strip_len && count <= rmt_strip->strip_len - start, ESP_ERR_INVALID_ARG, TAG, "pixels out of maximum number of LEDs");
+    uint8_t src_bytes_per_pixel = format == LED_PIXEL_FORMAT_GRBW ? 4 : 3;
+    ESP_RETURN_ON_FALSE(src_bytes_per_pixel <= rmt_strip->bytes_per_pixel, ESP_ERR_INVALID_ARG, TAG, "wrong LED pixel format, the strip has no white component");
+    uint8_t *buf = rmt_strip->buffer + start * rmt_strip->bytes_per_pixel;
+    if (src_bytes_per_pixel == rmt_strip->bytes_per_pixel) {
+        // the buffer is already kept in the wire order, copy the whole span at once
+        memcpy(buf, src, count * src_bytes_per_pixel);
+    } else {
+        // GRB data on a GRBW strip, turn off the white component
+        for (uint32_t i = 0; i < count; i++) {
+            *buf++ = *src++;
+            *buf++ = *src++;
+            *buf++ = *src++;
+            *buf++ = 0;
+        }
+    }
+    led_strip_rmt_mark_dirty(rmt_strip, start + count);
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_rmt_send(led_strip_rmt_obj *rmt_strip, const uint8_t *pixels, uint32_t len)
+{
+    // the line stays low after the previous frame, only the part of the reset time that hasn't elapsed is left
+    led_strip_wait_reset(rmt_strip->frame_end_us);
+    ESP_RETURN_ON_ERROR(rmt_write_sample(rmt_strip->rmt_channel, pixels, len * rmt_strip->bytes_per_pixel, true), TAG,
                         "transmit RMT samples failed");
-    vTaskDelay(pdMS_TO_TICKS(LED_STRIP_RESET_MS));
+    rmt_strip->frame_end_us = esp_timer_get_time();
     return ESP_OK;
 }
 
-static esp_err_t led_strip_rmt_clear(led_strip_t *strip)
+static esp_err_t led_strip_rmt_refresh(led_strip_t *strip)
+{
+    led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    uint32_t len = rmt_strip->strip_len;
+    if (rmt_strip->refresh_mode == LED_STRIP_REFRESH_PREFIX) {
+        // a refresh always sends something, the first pixel if none was modified
+        len = rmt_strip->dirty_len ? rmt_strip->dirty_len : 1;
+    }
+    ESP_RETURN_ON_ERROR(led_strip_rmt_send(rmt_strip, rmt_strip->buffer, len), TAG, "send pixels failed");
+    rmt_strip->dirty_len = 0;
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_rmt_capture_frame(led_strip_t *strip, uint32_t slot)
+{
+    led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    uint32_t frame_size = rmt_strip->strip_len * rmt_strip->bytes_per_pixel;
+    if (!rmt_strip->frame_cache[slot]) {
+        rmt_strip->frame_cache[slot] = malloc(frame_size);
+        ESP_RETURN_ON_FALSE(rmt_strip->frame_cache[slot], ESP_ERR_NO_MEM, TAG, "no mem for frame cache slot");
+    }
+    memcpy(rmt_strip->frame_cache[slot], rmt_strip->buffer, frame_size);
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_rmt_refresh_frame(led_strip_t *strip, uint32_t slot)
+{
+    led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    ESP_RETURN_ON_FALSE(rmt_strip->frame_cache[slot], ESP_ERR_INVALID_STATE, TAG, "no frame captured in the slot");
+    // the strip no longer shows the pixel buffer
+    rmt_strip->dirty_len = rmt_strip->strip_len;
+    return led_strip_rmt_send(rmt_strip, rmt_strip->frame_cache[slot], rmt_strip->strip_len);
+}
+
+static esp_err_t led_strip_rmt_clear_buffer_only(led_strip_t *strip)
 {
     led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
-    // Write zero to turn off all LEDs
+    // Write zero to turn off all LEDs, the encoder turns the raw bytes into symbols on the fly so there's nothing else to reset
     memset(rmt_strip->buffer, 0, rmt_strip->strip_len * rmt_strip->bytes_per_pixel);
+    rmt_strip->dirty_len = rmt_strip->strip_len;
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_rmt_set_refresh_mode(led_strip_t *strip, led_strip_refresh_mode_t mode)
+{
+    led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    rmt_strip->refresh_mode = mode;
+    rmt_strip->dirty_len = rmt_strip->strip_len;
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_rmt_clear(led_strip_t *strip)
+{
+    ESP_RETURN_ON_ERROR(led_strip_rmt_clear_buffer_only(strip), TAG, "clear pixel buffer failed");
     return led_strip_rmt_refresh(strip);
 }
 
+static esp_err_t led_strip_rmt_get_timing(led_strip_t *strip, led_strip_timing_t *ret_timing)
+{
+    led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
+    // the driver stays installed, only the transmission is started after the reset time
+    led_strip_timing_calc(ret_timing, rmt_strip->strip_len, rmt_strip->bytes_per_pixel, rmt_strip->bit_period_ns, LED_STRIP_RESET_US,
+                          0, LED_STRIP_RMT_SETUP_US);
+    return ESP_OK;
+}
+
 static esp_err_t led_strip_rmt_del(led_strip_t *strip)
 {
     led_strip_rmt_obj *rmt_strip = __containerof(strip, led_strip_rmt_obj, base);
     ESP_RETURN_ON_ERROR(rmt_driver_uninstall(rmt_strip->rmt_channel), TAG, "uninstall RMT driver failed");
+    for (int i = 0; i < CONFIG_LED_STRIP_FRAME_CACHE_SLOTS; i++) {
+        free(rmt_strip->frame_cache[i]);
+    }
     free(rmt_strip);
     return ESP_OK;
 }
@@ -158,31 +257,49 @@ esp_err_t led_strip_new_rmt_device(const led_strip_config_t *led_config, const l
     rmt_get_counter_clock((rmt_channel_t)dev_config->rmt_channel, &counter_clk_hz);
     // ns -> ticks
     float ratio = (float)counter_clk_hz / 1e9;
+    rmt_item32_t bit0 = {};
+    rmt_item32_t bit1 = {};
+    uint32_t bit_period_ns = 0;
     if (led_config->led_model == LED_MODEL_WS2812) {
-        led_t0h_ticks = (uint32_t)(ratio * WS2812_T0H_NS);
-        led_t0l_ticks = (uint32_t)(ratio * WS2812_T0L_NS);
-        led_t1h_ticks = (uint32_t)(ratio * WS2812_T1H_NS);
-        led_t1l_ticks = (uint32_t)(ratio * WS2812_T1L_NS);
+        bit_period_ns = WS2812_T0H_NS + WS2812_T0L_NS;
+        bit0 = (rmt_item32_t) {{{ (uint32_t)(ratio * WS2812_T0H_NS), 1, (uint32_t)(ratio * WS2812_T0L_NS), 0 }}}; //Logical 0
+        bit1 = (rmt_item32_t) {{{ (uint32_t)(ratio * WS2812_T1H_NS), 1, (uint32_t)(ratio * WS2812_T1L_NS), 0 }}}; //Logical 1
     } else if (led_config->led_model == LED_MODEL_SK6812) {
-        led_t0h_ticks = (uint32_t)(ratio * SK6812_T0H_NS);
-        led_t0l_ticks = (uint32_t)(ratio * SK6812_T0L_NS);
-        led_t1h_ticks = (uint32_t)(ratio * SK6812_T1H_NS);
-        led_t1l_ticks = (uint32_t)(ratio * SK6812_T1L_NS);
+        bit_period_ns = SK6812_T0H_NS + SK6812_T0L_NS;
+        bit0 = (rmt_item32_t) {{{ (uint32_t)(ratio * SK6812_T0H_NS), 1, (uint32_t)(ratio * SK6812_T0L_NS), 0 }}}; //Logical 0
+        bit1 = (rmt_item32_t) {{{ (uint32_t)(ratio * SK6812_T1H_NS), 1, (uint32_t)(ratio * SK6812_T1L_NS), 0 }}}; //Logical 1
     } else {
         assert(false);
     }
+    for (int nibble = 0; nibble < 16; nibble++) {
+        for (int bit = 0; bit < 4; bit++) {
+            s_nibble_items[nibble][bit] = nibble & (0x08 >> bit) ? bit1 : bit0;
+        }
+    }
 
     // adapter to translates the LES strip date frame into RMT symbols
     rmt_translator_init((rmt_channel_t)dev_config->rmt_channel, ws2812_rmt_adapter);
 
     rmt_strip->bytes_per_pixel = bytes_per_pixel;
     rmt_strip->rmt_channel = (rmt_channel_t)dev_config->rmt_channel;
+    rmt_strip->bit_period_ns = bit_period_ns;
     rmt_strip->strip_len = led_config->max_leds;
+    rmt_strip->dirty_len = led_config->max_leds;
     rmt_strip->base.set_pixel = led_strip_rmt_set_pixel;
+    rmt_strip->base.set_pixels = led_strip_rmt_set_pixels;
     rmt_strip->base.refresh = led_strip_rmt_refresh;
     rmt_strip->base.clear = led_strip_rmt_clear;
+    rmt_strip->base.clear_buffer_only = led_strip_rmt_clear_buffer_only;
+    rmt_strip->base.capture_frame = led_strip_rmt_capture_frame;
+    rmt_strip->base.refresh_frame = led_strip_rmt_refresh_frame;
+    rmt_strip->base.set_refresh_mode = led_strip_rmt_set_refresh_mode;
+    rmt_strip->base.get_timing = led_strip_rmt_get_timing;
     rmt_strip->base.del = led_strip_rmt_del;
 
+    led_strip_timing_t strip_timing;
+    led_strip_rmt_get_timing(&rmt_strip->base, &strip_timing);
+    ESP_LOGI(TAG, "%"PRIu32" LEDs: %"PRIu32"us on the wire + %"PRIu32"us reset + %"PRIu32"us setup, up to %"PRIu32" fps",
+             rmt_strip->strip_len, strip_timing.wire_time_us, strip_timing.reset_us, strip_timing.setup_us, strip_timing.max_fps);
     *ret_strip = &rmt_strip->base;
     return ESP_OK;
 
@@ -5,59 +5,37 @@
  */
 
 #include "esp_check.h"
+#include "esp_idf_version.h"
 #include "led_strip_rmt_encoder.h"
+#include "led_strip_brightness.h"
 
 static const char *TAG = "led_rmt_encoder";
 
 typedef struct {
     rmt_encoder_t base;
     rmt_encoder_t *bytes_encoder;
-    rmt_encoder_t *copy_encoder;
-    int state;
-    rmt_symbol_word_t reset_code;
 } rmt_led_strip_encoder_t;
 
+typedef struct {
+    rmt_encoder_t base;
+    rmt_encoder_t *simple_encoder;
+    uint16_t brightness; // 8.8 fixed point factor the bytes are scaled by
+    uint8_t *residual;   // dithering state of every byte of the frame, NULL without dithering
+    rmt_symbol_word_t nibble_symbols[16][4]; // symbols of the 4 bits of every nibble, MSB first
+} rmt_led_strip_nibble_encoder_t;
+
+// the frame ends with the last bit, the reset time is left to the strip driver, which gets on with other things meanwhile
 static size_t rmt_encode_led_strip(rmt_encoder_t *encoder, rmt_channel_handle_t channel, const void *primary_data, size_t data_size, rmt_encode_state_t *ret_state)
 {
     rmt_led_strip_encoder_t *led_encoder = __containerof(encoder, rmt_led_strip_encoder_t, base);
     rmt_encoder_handle_t bytes_encoder = led_encoder->bytes_encoder;
-    rmt_encoder_handle_t copy_encoder = led_encoder->copy_encoder;
-    rmt_encode_state_t session_state = 0;
-    rmt_encode_state_t state = 0;
-    size_t encoded_symbols = 0;
-    switch (led_encoder->state) {
-    case 0: // send RGB data
-        encoded_symbols += bytes_encoder->encode(bytes_encoder, channel, primary_data, data_size, &session_state);
-        if (session_state & RMT_ENCODING_COMPLETE) {
-            led_encoder->state = 1; // switch to next state when current encoding session finished
-        }
-        if (session_state & RMT_ENCODING_MEM_FULL) {
-            state |= RMT_ENCODING_MEM_FULL;
-            goto out; // yield if there's no free space for encoding artifacts
-        }
-    // fall-through
-    case 1: // send reset code
-        encoded_symbols += copy_encoder->encode(copy_encoder, channel, &led_encoder->reset_code,
-                                                sizeof(led_encoder->reset_code), &session_state);
-        if (session_state & RMT_ENCODING_COMPLETE) {
-            led_encoder->state = 0; // back to the initial encoding session
-            state |= RMT_ENCODING_COMPLETE;
-        }
-        if (session_state & RMT_ENCODING_MEM_FULL) {
-            state |= RMT_ENCODING_MEM_FULL;
-            goto out; // yield if there's no free space for encoding artifacts
-        }
-    }
-out:
-    *ret_state = state;
-    return encoded_symbols;
+    return bytes_encoder->encode(bytes_encoder, channel, primary_data, data_size, ret_state);
 }
 
 static esp_err_t rmt_del_led_strip_encoder(rmt_encoder_t *encoder)
 {
     rmt_led_strip_encoder_t *led_encoder = __containerof(encoder, rmt_led_strip_encoder_t, base);
     rmt_del_encoder(led_encoder->bytes_encoder);
-    rmt_del_encoder(led_encoder->copy_encoder);
     free(led_encoder);
     return ESP_OK;
 }
@@ -65,11 +43,96 @@ static esp_err_t rmt_del_led_strip_encoder(rmt_encoder_t *encoder)
 static esp_err_t rmt_led_strip_encoder_reset(rmt_encoder_t *encoder)
 {
     rmt_led_strip_encoder_t *led_encoder = __containerof(encoder, rmt_led_strip_encoder_t, base);
-    rmt_encoder_reset(led_encoder->bytes_encoder);
-    rmt_encoder_reset(led_encoder->copy_encoder);
-    led_encoder->state = 0;
+    return rmt_encoder_reset(led_encoder->bytes_encoder);
+}
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0)
+/**
+ * @brief Simple encoder callback, writes 8 symbols per pixel byte, scaled by the brightness
+ *
+ * The RMT driver hands over its memory directly when at least `min_chunk_size` (8) symbols are free,
+ * so a byte costs two table lookups and eight word stores.
+ */
+static size_t rmt_encode_led_strip_nibble(const void *data, size_t data_size, size_t symbols_written, size_t symbols_free,
+                                          rmt_symbol_word_t *symbols, bool *done, void *arg)
+{
+    rmt_led_strip_nibble_encoder_t *led_encoder = (rmt_led_strip_nibble_encoder_t *)arg;
+    size_t offset = symbols_written / 8;
+    const uint8_t *bytes = (const uint8_t *)data + offset;
+    size_t bytes_left = data_size - symbols_written / 8;
+    size_t bytes_num = symbols_free / 8 < bytes_left ? symbols_free / 8 : bytes_left;
+    uint32_t *out = (uint32_t *)symbols;
+
+    for (size_t i = 0; i < bytes_num; i++) {
+        uint8_t byte = bytes[i];
+        if (led_encoder->residual) {
+            byte = led_strip_scale_dither(byte, led_encoder->brightness, &led_encoder->residual[offset + i]);
+        } else if (led_encoder->brightness != LED_STRIP_BRIGHTNESS_MAX) {
+            byte = led_strip_scale(byte, led_encoder->brightness);
+        }
+        const rmt_symbol_word_t *high = led_encoder->nibble_symbols[byte >> 4];
+        const rmt_symbol_word_t *low = led_encoder->nibble_symbols[byte & 0x0F];
+        out[0] = high[0].val;
+        out[1] = high[1].val;
+        out[2] = high[2].val;
+        out[3] = high[3].val;
+        out[4] = low[0].val;
+        out[5] = low[1].val;
+        out[6] = low[2].val;
+        out[7] = low[3].val;
+        out += 8;
+    }
+    *done = bytes_num == bytes_left;
+    return bytes_num * 8;
+}
+
+static size_t rmt_encode_led_strip_nibble_forward(rmt_encoder_t *encoder, rmt_channel_handle_t channel, const void *primary_data, size_t data_size, rmt_encode_state_t *ret_state)
+{
+    rmt_led_strip_nibble_encoder_t *led_encoder = __containerof(encoder, rmt_led_strip_nibble_encoder_t, base);
+    return led_encoder->simple_encoder->encode(led_encoder->simple_encoder, channel, primary_data, data_size, ret_state);
+}
+
+static esp_err_t rmt_del_led_strip_nibble_encoder(rmt_encoder_t *encoder)
+{
+    rmt_led_strip_nibble_encoder_t *led_encoder = __containerof(encoder, rmt_led_strip_nibble_encoder_t, base);
+    rmt_del_encoder(led_encoder->simple_encoder);
+    free(led_encoder);
+    return ESP_OK;
+}
+
+static esp_err_t rmt_led_strip_nibble_encoder_reset(rmt_encoder_t *encoder)
+{
+    rmt_led_strip_nibble_encoder_t *led_encoder = __containerof(encoder, rmt_led_strip_nibble_encoder_t, base);
+    return rmt_encoder_reset(led_encoder->simple_encoder);
+}
+
+static esp_err_t rmt_new_led_strip_nibble_encoder(const rmt_bytes_encoder_config_t *bits_config, rmt_encoder_handle_t *ret_encoder)
+{
+    esp_err_t ret = ESP_OK;
+    rmt_led_strip_nibble_encoder_t *led_encoder = calloc(1, sizeof(rmt_led_strip_nibble_encoder_t));
+    ESP_RETURN_ON_FALSE(led_encoder, ESP_ERR_NO_MEM, TAG, "no mem for led strip encoder");
+    led_encoder->base.encode = rmt_encode_led_strip_nibble_forward;
+    led_encoder->base.del = rmt_del_led_strip_nibble_encoder;
+    led_encoder->base.reset = rmt_led_strip_nibble_encoder_reset;
+    led_encoder->brightness = LED_STRIP_BRIGHTNESS_MAX;
+    for (int nibble = 0; nibble < 16; nibble++) {
+        for (int bit = 0; bit < 4; bit++) {
+            led_encoder->nibble_symbols[nibble][bit] = nibble & (0x08 >> bit) ? bits_config->bit1 : bits_config->bit0;
+        }
+    }
+    rmt_simple_encoder_config_t simple_encoder_config = {
+        .callback = rmt_encode_led_strip_nibble,
+        .arg = led_encoder,
+        .min_chunk_size = 8, // room for a whole byte
+    };
+    ESP_GOTO_ON_ERROR(rmt_new_simple_encoder(&simple_encoder_config, &led_encoder->simple_encoder), err, TAG, "create simple encoder failed");
+    *ret_encoder = &led_encoder->base;
     return ESP_OK;
+err:
+    free(led_encoder);
+    return ret;
 }
+#endif
 
 esp_err_t rmt_new_led_strip_encoder(const led_strip_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder)
 {
@@ -77,11 +140,6 @@ esp_err_t rmt_new_led_strip_encoder(const led_strip_encoder_config_t *config, rm
     rmt_led_strip_encoder_t *led_encoder = NULL;
     ESP_GOTO_ON_FALSE(config && ret_encoder, ESP_ERR_INVALID_ARG, err, TAG, "invalid argument");
     ESP_GOTO_ON_FALSE(config->led_model < LED_MODEL_INVALID, ESP_ERR_INVALID_ARG, err, TAG, "invalid led model");
-    led_encoder = calloc(1, sizeof(rmt_led_strip_encoder_t));
-    ESP_GOTO_ON_FALSE(led_encoder, ESP_ERR_NO_MEM, err, TAG, "no mem for led strip encoder");
-    led_encoder->base.encode = rmt_encode_led_strip;
-    led_encoder->base.del = rmt_del_led_strip_encoder;
-    led_encoder->base.reset = rmt_led_strip_encoder_reset;
     rmt_bytes_encoder_config_t bytes_encoder_config;
     if (config->led_model == LED_MODEL_SK6812) {
         bytes_encoder_config = (rmt_bytes_encoder_config_t) {
@@ -119,17 +177,21 @@ esp_err_t rmt_new_led_strip_encoder(const led_strip_encoder_config_t *config, rm
     } else {
         assert(false);
     }
+
+    if (config->flags.nibble_encoder) {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0)
+        return rmt_new_led_strip_nibble_encoder(&bytes_encoder_config, ret_encoder);
+#else
+        ESP_GOTO_ON_FALSE(false, ESP_ERR_NOT_SUPPORTED, err, TAG, "nibble encoder requires ESP-IDF v5.3 or later");
+#endif
+    }
+
+    led_encoder = calloc(1, sizeof(rmt_led_strip_encoder_t));
+    ESP_GOTO_ON_FALSE(led_encoder, ESP_ERR_NO_MEM, err, TAG, "no mem for led strip encoder");
+    led_encoder->base.encode = rmt_encode_led_strip;
+    led_encoder->base.del = rmt_del_led_strip_encoder;
+    led_encoder->base.reset = rmt_led_strip_encoder_reset;
     ESP_GOTO_ON_ERROR(rmt_new_bytes_encoder(&bytes_encoder_config, &led_encoder->bytes_encoder), err, TAG, "create bytes encoder failed");
-    rmt_copy_encoder_config_t copy_encoder_config = {};
-    ESP_GOTO_ON_ERROR(rmt_new_copy_encoder(&copy_encoder_config, &led_encoder->copy_encoder), err, TAG, "create copy encoder failed");
-
-    uint32_t reset_ticks = config->resolution / 1000000 * 280 / 2; // reset code duration defaults to 280us to accomodate WS2812B-V5
-    led_encoder->reset_code = (rmt_symbol_word_t) {
-        .level0 = 0,
-        .duration0 = reset_ticks,
-        .level1 = 0,
-        .duration1 = reset_ticks,
-    };
     *ret_encoder = &led_encoder->base;
     return ESP_OK;
 err:
@@ -137,10 +199,23 @@ err:
         if (led_encoder->bytes_encoder) {
             rmt_del_encoder(led_encoder->bytes_encoder);
         }
-        if (led_encoder->copy_encoder) {
-            rmt_del_encoder(led_encoder->copy_encoder);
-        }
         free(led_encoder);
     }
     return ret;
 }
+
+esp_err_t rmt_led_strip_encoder_set_brightness(rmt_encoder_handle_t encoder, uint16_t brightness, uint8_t *residual)
+{
+    ESP_RETURN_ON_FALSE(encoder && brightness <= LED_STRIP_BRIGHTNESS_MAX, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0)
+    if (encoder->encode == rmt_encode_led_strip_nibble_forward) {
+        rmt_led_strip_nibble_encoder_t *led_encoder = __containerof(encoder, rmt_led_strip_nibble_encoder_t, base);
+        led_encoder->brightness = brightness;
+        led_encoder->residual = residual;
+        return ESP_OK;
+    }
+#endif
+    // the bytes encoder sends the pixel bytes as they are
+    ESP_RETURN_ON_FALSE(brightness == LED_STRIP_BRIGHTNESS_MAX && !residual, ESP_ERR_NOT_SUPPORTED, TAG, "brightness needs the nibble encoder");
+    return ESP_OK;
+}
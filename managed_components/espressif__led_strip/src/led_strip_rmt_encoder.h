@@ -19,20 +19,42 @@ extern "C" {
 typedef struct {
     uint32_t resolution;   /*!< Encoder resolution, in Hz */
     led_model_t led_model; /*!< LED model */
+    struct {
+        uint32_t nibble_encoder: 1; /*!< Write the symbols of every pixel byte straight into the RMT memory from a nibble table,
+                                         instead of chaining the bytes and copy encoders. Requires ESP-IDF v5.3 or later */
+    } flags;               /*!< Extra encoder flags */
 } led_strip_encoder_config_t;
 
 /**
  * @brief Create RMT encoder for encoding LED strip pixels into RMT symbols
  *
+ * @note No reset code is appended to the frame, the line stays low after the last bit and the caller
+ *       must let LED_STRIP_RESET_US elapse before sending the next frame
+ *
  * @param[in] config Encoder configuration
  * @param[out] ret_encoder Returned encoder handle
  * @return
  *      - ESP_ERR_INVALID_ARG for any invalid arguments
  *      - ESP_ERR_NO_MEM out of memory when creating led strip encoder
+ *      - ESP_ERR_NOT_SUPPORTED if the nibble encoder is requested on an ESP-IDF version without the simple encoder
  *      - ESP_OK if creating encoder successfully
  */
 esp_err_t rmt_new_led_strip_encoder(const led_strip_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder);
 
+/**
+ * @brief Scale the pixel bytes by a brightness factor while they're encoded
+ *
+ * @note Must not be called while the encoder is in use by a transmission
+ *
+ * @param[in] encoder Encoder created by `rmt_new_led_strip_encoder`
+ * @param[in] brightness 8.8 fixed point factor, up to LED_STRIP_BRIGHTNESS_MAX
+ * @param[in] residual Dithering state, one byte per pixel byte of a frame, cleared by the caller. NULL disables dithering
+ * @return
+ *      - ESP_ERR_NOT_SUPPORTED if the brightness or the dithering is requested from an encoder that isn't a nibble encoder
+ *      - ESP_OK if setting the brightness successfully
+ */
+esp_err_t rmt_led_strip_encoder_set_brightness(rmt_encoder_handle_t encoder, uint16_t brightness, uint8_t *residual);
+
 #ifdef __cplusplus
 }
 #endif
@@ -4,61 +4,309 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 #include <stdlib.h>
+#include <inttypes.h>
 #include <string.h>
 #include <sys/cdefs.h>
 #include "esp_log.h"
 #include "esp_check.h"
+#include "esp_attr.h"
 #include "esp_rom_gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "soc/spi_periph.h"
 #include "led_strip.h"
 #include "led_strip_interface.h"
+#include "led_strip_reset.h"
+#include "led_strip_brightness.h"
 #include "hal/spi_hal.h"
 
-#define LED_STRIP_SPI_DEFAULT_RESOLUTION (2.5 * 1000 * 1000) // 2.5MHz resolution
 #define LED_STRIP_SPI_DEFAULT_TRANS_QUEUE_SIZE 4
 
-#define SPI_BYTES_PER_COLOR_BYTE 3
-#define SPI_BITS_PER_COLOR_BYTE (SPI_BYTES_PER_COLOR_BYTE * 8)
+// In streaming mode, the frame is encoded LED_STRIP_SPI_STREAM_CHUNK_LEDS LEDs at a time,
+// with up to LED_STRIP_SPI_STREAM_CHUNKS chunks queued to the SPI driver
+#define LED_STRIP_SPI_STREAM_CHUNK_LEDS 32
+#define LED_STRIP_SPI_STREAM_CHUNKS     LED_STRIP_SPI_DEFAULT_TRANS_QUEUE_SIZE
+#define LED_STRIP_SPI_STREAM_TASK_STACK 3072
+
+// Range of SPI bits (symbols) used to send one LED bit, it's also the number of SPI bytes per color byte
+#define SPI_MIN_SYMBOLS_PER_BIT 2
+#define SPI_MAX_SYMBOLS_PER_BIT 5
 
 static const char *TAG = "led_strip_spi";
 
+/**
+ * @brief Bit timing requirements of a LED model, in ns
+ */
+typedef struct {
+    uint16_t t0h_min, t0h_max;       // high time of a 0 bit
+    uint16_t t1h_min, t1h_max;       // high time of a 1 bit
+    uint16_t tl_min;                 // low time of either bit
+    uint16_t period_min, period_max; // period of a bit
+    uint16_t t0h, t1h, period;       // nominal values, the encoding closest to them is preferred
+} led_strip_spi_timing_t;
+
+static const led_strip_spi_timing_t s_led_timing[LED_MODEL_INVALID] = {
+    [LED_MODEL_WS2812] = {
+        .t0h_min = 250, .t0h_max = 550,
+        .t1h_min = 650, .t1h_max = 950,
+        .tl_min = 300,
+        .period_min = 650, .period_max = 1850,
+        .t0h = 300, .t1h = 900, .period = 1200,
+    },
+    [LED_MODEL_SK6812] = {
+        .t0h_min = 150, .t0h_max = 450,
+        .t1h_min = 450, .t1h_max = 750,
+        .tl_min = 450,
+        .period_min = 650, .period_max = 1850,
+        .t0h = 300, .t1h = 600, .period = 1200,
+    },
+};
+
 typedef struct {
     led_strip_t base;
     spi_host_device_t spi_host;
     spi_device_handle_t spi_device;
+    spi_transaction_t trans;                      // transaction of the frame being sent
+    led_strip_refresh_done_cb_t on_refresh_done;  // user callback, invoked when a frame has been sent
+    void *user_ctx;                               // user context of the callback
     uint32_t strip_len;
+    uint32_t frame_size;                          // size of a frame in the pixel buffer, in bytes (raw in streaming mode)
+    uint32_t dirty_len;                           // number of pixels from the start of the strip modified since the last refresh
+    led_strip_refresh_mode_t refresh_mode;
     uint8_t bytes_per_pixel;
-    uint8_t pixel_buf[];
+    uint8_t bytes_per_color;                      // SPI bytes per color byte, i.e. SPI symbols per LED bit
+    uint8_t t0h, t1h;                             // high time of the 0 and 1 bits, in SPI symbols
+    uint16_t brightness;                          // 8.8 fixed point factor the color bytes are scaled by
+    bool trans_pending;                           // a queued frame hasn't been collected yet
+    bool pixel_buf_black;                         // the pixel buffer is cleared, but the black frame isn't copied into it yet
+    uint32_t bit_period_ns;                       // period of a LED bit at the actual SPI clock
+    int64_t frame_end_us;                         // time at which the last frame finished, the reset time runs from there
+    uint8_t *bit_lut;                             // SPI bit pattern of every possible color byte, scaled by the brightness unless dithering
+    uint8_t *dither_residual;                     // dithering state of every raw byte of the frame, streaming mode only
+    uint8_t *raw_buf;                             // color bytes of the pixel buffer, kept once the brightness is changed outside the streaming mode
+    uint8_t *pixel_buf;                           // buffer that the pixels are encoded into
+    uint8_t *spare_buf;                           // the other buffer of a double buffered strip, NULL otherwise
+    uint8_t *black_buf;                           // encoded frame with all the LEDs off, sent as is by clear
+    uint8_t *frame_cache[CONFIG_LED_STRIP_FRAME_CACHE_SLOTS]; // encoded frames captured by the user, allocated on first capture
+    uint32_t frame_caps;                          // memory capabilities of the frame buffers
+    uint8_t *stream_buf;                          // DMA buffers of the chunks in flight, streaming mode only
+    spi_transaction_t stream_trans[LED_STRIP_SPI_STREAM_CHUNKS]; // transactions of the chunks in flight
+    spi_transaction_t *stream_last;               // transaction of the last chunk of the frame, it ends the frame
+    const uint8_t *stream_pixels;                 // raw pixels of the frame being streamed
+    uint32_t stream_total;                        // bytes of raw pixels in the frame being streamed
+    uint32_t stream_queued;                       // bytes of raw pixels encoded and queued so far
+    uint8_t stream_in_flight;                     // chunks queued and not collected yet
+    uint8_t stream_next;                          // DMA buffer the next chunk is encoded into
+    volatile bool stream_active;                  // a frame is being streamed, the done ISR wakes the refill task up
+    esp_err_t stream_err;                         // result of the frame being streamed, or of the last one
+    TaskHandle_t stream_task;                     // refills the DMA buffers freed by the done ISR
+    SemaphoreHandle_t stream_idle;                // taken by the frame being streamed, given back once it's out
+    uint8_t *frame_buf;                           // one allocation behind the pixel, spare and black buffers, freed at del
 } led_strip_spi_obj;
 
-// please make sure to zero-initialize the buf before calling this function
-static void __led_strip_spi_bit(uint8_t data, uint8_t *buf)
+/**
+ * @brief Pick the high time of the 0 and 1 bits, in SPI symbols, that best meets the LED timing
+ *
+ * @return true if an encoding with `symbols` SPI bits per LED bit meets the timing at the given clock
+ */
+static bool led_strip_spi_pick_encoding(const led_strip_spi_timing_t *timing, uint8_t symbols, int clock_khz, uint8_t *ret_t0h, uint8_t *ret_t1h)
+{
+    if (clock_khz <= 0) {
+        return false;
+    }
+    uint32_t symbol_ns = (1000000 + clock_khz / 2) / clock_khz;
+    uint32_t period = symbol_ns * symbols;
+    if (period < timing->period_min || period > timing->period_max) {
+        return false;
+    }
+    uint32_t best_error = UINT32_MAX;
+    for (uint8_t t0h = 1; t0h < symbols; t0h++) {
+        uint32_t t0h_ns = t0h * symbol_ns;
+        if (t0h_ns < timing->t0h_min || t0h_ns > timing->t0h_max) {
+            continue;
+        }
+        // the 1 bit has the longer high time, so its low time is the shortest one
+        for (uint8_t t1h = t0h + 1; t1h < symbols; t1h++) {
+            uint32_t t1h_ns = t1h * symbol_ns;
+            if (t1h_ns < timing->t1h_min || t1h_ns > timing->t1h_max || period - t1h_ns < timing->tl_min) {
+                continue;
+            }
+            uint32_t error = abs((int)t0h_ns - timing->t0h) + abs((int)t1h_ns - timing->t1h);
+            if (error < best_error) {
+                best_error = error;
+                *ret_t0h = t0h;
+                *ret_t1h = t1h;
+            }
+        }
+    }
+    return best_error != UINT32_MAX;
+}
+
+/**
+ * @brief Build the SPI bit pattern of every possible color byte, MSB first
+ *
+ * A LED bit is sent as `symbols` SPI bits, `t0h` or `t1h` of them high and the rest low, e.g. 100 and 110 for 3 symbols.
+ * The byte is scaled by `brightness` first, so the brightness costs nothing when the pixels are encoded.
+ */
+static void led_strip_spi_build_lut(uint8_t *lut, uint8_t symbols, uint8_t t0h, uint8_t t1h, uint16_t brightness)
+{
+    uint64_t bit0 = ((1ULL << t0h) - 1) << (symbols - t0h);
+    uint64_t bit1 = ((1ULL << t1h) - 1) << (symbols - t1h);
+    for (int data = 0; data < 256; data++) {
+        uint8_t scaled = led_strip_scale(data, brightness);
+        uint64_t pattern = 0;
+        for (int bit = 7; bit >= 0; bit--) {
+            pattern = (pattern << symbols) | (scaled & BIT(bit) ? bit1 : bit0);
+        }
+        for (int i = symbols - 1; i >= 0; i--) {
+            *lut++ = (pattern >> (i * 8)) & 0xFF;
+        }
+    }
+}
+
+static inline void __led_strip_spi_bit(const led_strip_spi_obj *spi_strip, uint8_t data, uint8_t *buf)
+{
+    const uint8_t *pattern = &spi_strip->bit_lut[data * spi_strip->bytes_per_color];
+    for (uint8_t i = 0; i < spi_strip->bytes_per_color; i++) {
+        buf[i] = pattern[i];
+    }
+}
+
+// color byte of an encoded LED byte, the symbol right after the high time of a 0 bit is high only in a 1 bit
+static uint8_t led_strip_spi_decode(const led_strip_spi_obj *spi_strip, const uint8_t *buf)
+{
+    uint8_t data = 0;
+    for (int bit = 0; bit < 8; bit++) {
+        uint32_t pos = bit * spi_strip->bytes_per_color + spi_strip->t0h;
+        data = (data << 1) | ((buf[pos / 8] >> (7 - pos % 8)) & 1);
+    }
+    return data;
+}
+
+static void IRAM_ATTR led_strip_spi_trans_done(spi_transaction_t *trans)
+{
+    led_strip_spi_obj *spi_strip = (led_strip_spi_obj *)trans->user;
+    BaseType_t task_woken = pdFALSE;
+    if (spi_strip->stream_active) {
+        // the chunk's DMA buffer is free, the refill task encodes the next chunk into it
+        vTaskNotifyGiveFromISR(spi_strip->stream_task, &task_woken);
+        if (trans != spi_strip->stream_last) {
+            if (task_woken) {
+                portYIELD_FROM_ISR();
+            }
+            return;
+        }
+    }
+    spi_strip->frame_end_us = esp_timer_get_time();
+    if (spi_strip->on_refresh_done) {
+        if (spi_strip->on_refresh_done(&spi_strip->base, spi_strip->user_ctx)) {
+            task_woken = pdTRUE;
+        }
+    }
+    if (task_woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+// wait until no frame is being streamed
+static esp_err_t led_strip_spi_stream_wait(led_strip_spi_obj *spi_strip, TickType_t ticks_to_wait)
+{
+    if (xSemaphoreTake(spi_strip->stream_idle, ticks_to_wait) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    xSemaphoreGive(spi_strip->stream_idle);
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_spi_wait_done(led_strip_spi_obj *spi_strip, TickType_t ticks_to_wait)
+{
+    if (spi_strip->stream_idle) {
+        return led_strip_spi_stream_wait(spi_strip, ticks_to_wait);
+    }
+    if (!spi_strip->trans_pending) {
+        return ESP_OK;
+    }
+    spi_transaction_t *trans = NULL;
+    esp_err_t ret = spi_device_get_trans_result(spi_strip->spi_device, &trans, ticks_to_wait);
+    if (ret == ESP_OK) {
+        spi_strip->trans_pending = false;
+    }
+    return ret;
+}
+
+/**
+ * @brief Get the pixel buffer ready to be modified
+ *
+ * @param whole_frame: every pixel is about to be overwritten, a pending clear doesn't need to be applied
+ */
+static inline esp_err_t led_strip_spi_prepare_write(led_strip_spi_obj *spi_strip, bool whole_frame)
+{
+    // the pixel buffer can't be modified while the DMA is still sending it out
+    if (spi_strip->trans_pending && spi_strip->trans.tx_buffer == spi_strip->pixel_buf) {
+        esp_err_t ret = led_strip_spi_wait_done(spi_strip, portMAX_DELAY);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    if (spi_strip->pixel_buf_black) {
+        if (!whole_frame) {
+            memcpy(spi_strip->pixel_buf, spi_strip->black_buf, spi_strip->frame_size);
+            if (spi_strip->raw_buf) {
+                memset(spi_strip->raw_buf, 0, spi_strip->strip_len * spi_strip->bytes_per_pixel);
+            }
+        }
+        spi_strip->pixel_buf_black = false;
+    }
+    return ESP_OK;
+}
+
+// a cleared strip sends the black frame directly, there's nothing to copy
+static inline uint8_t *led_strip_spi_frame_to_send(led_strip_spi_obj *spi_strip)
 {
-    // Each color of 1 bit is represented by 3 bits of SPI, low_level:100 ,high_level:110
-    // So a color byte occupies 3 bytes of SPI.
-    *(buf + 2) |= data & BIT(0) ? BIT(2) | BIT(1) : BIT(2);
-    *(buf + 2) |= data & BIT(1) ? BIT(5) | BIT(4) : BIT(5);
-    *(buf + 2) |= data & BIT(2) ? BIT(7) : 0x00;
-    *(buf + 1) |= BIT(0);
-    *(buf + 1) |= data & BIT(3) ? BIT(3) | BIT(2) : BIT(3);
-    *(buf + 1) |= data & BIT(4) ? BIT(6) | BIT(5) : BIT(6);
-    *(buf + 0) |= data & BIT(5) ? BIT(1) | BIT(0) : BIT(1);
-    *(buf + 0) |= data & BIT(6) ? BIT(4) | BIT(3) : BIT(4);
-    *(buf + 0) |= data & BIT(7) ? BIT(7) | BIT(6) : BIT(7);
+    return spi_strip->pixel_buf_black ? spi_strip->black_buf : spi_strip->pixel_buf;
+}
+
+static inline void led_strip_spi_mark_dirty(led_strip_spi_obj *spi_strip, uint32_t end)
+{
+    if (end > spi_strip->dirty_len) {
+        spi_strip->dirty_len = end;
+    }
+}
+
+// size of the frame that a refresh sends, in bytes
+static uint32_t led_strip_spi_refresh_size(const led_strip_spi_obj *spi_strip)
+{
+    if (spi_strip->refresh_mode == LED_STRIP_REFRESH_PREFIX) {
+        // nothing modified still sends the first pixel, so that there's a transaction to complete
+        uint32_t len = spi_strip->dirty_len ? spi_strip->dirty_len : 1;
+        return len * spi_strip->bytes_per_pixel * spi_strip->bytes_per_color;
+    }
+    return spi_strip->frame_size;
 }
 
 static esp_err_t led_strip_spi_set_pixel(led_strip_t *strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue)
 {
     led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
     ESP_RETURN_ON_FALSE(index < spi_strip->strip_len, ESP_ERR_INVALID_ARG, TAG, "index out of maximum number of LEDs");
-    // LED_PIXEL_FORMAT_GRB takes 72bits(9bytes)
-    uint32_t start = index * spi_strip->bytes_per_pixel * SPI_BYTES_PER_COLOR_BYTE;
-    memset(spi_strip->pixel_buf + start, 0, spi_strip->bytes_per_pixel * SPI_BYTES_PER_COLOR_BYTE);
-    __led_strip_spi_bit(green, &spi_strip->pixel_buf[start]);
-    __led_strip_spi_bit(red, &spi_strip->pixel_buf[start + SPI_BYTES_PER_COLOR_BYTE]);
-    __led_strip_spi_bit(blue, &spi_strip->pixel_buf[start + SPI_BYTES_PER_COLOR_BYTE * 2]);
+    ESP_RETURN_ON_ERROR(led_strip_spi_prepare_write(spi_strip, false), TAG, "wait for pending frame failed");
+    led_strip_spi_mark_dirty(spi_strip, index + 1);
+    // LED_PIXEL_FORMAT_GRB takes 72bits(9bytes) with 3 SPI bits per LED bit
+    uint32_t start = index * spi_strip->bytes_per_pixel * spi_strip->bytes_per_color;
+    __led_strip_spi_bit(spi_strip, green, &spi_strip->pixel_buf[start]);
+    __led_strip_spi_bit(spi_strip, red, &spi_strip->pixel_buf[start + spi_strip->bytes_per_color]);
+    __led_strip_spi_bit(spi_strip, blue, &spi_strip->pixel_buf[start + spi_strip->bytes_per_color * 2]);
     if (spi_strip->bytes_per_pixel > 3) {
-        __led_strip_spi_bit(0, &spi_strip->pixel_buf[start + SPI_BYTES_PER_COLOR_BYTE * 3]);
+        __led_strip_spi_bit(spi_strip, 0, &spi_strip->pixel_buf[start + spi_strip->bytes_per_color * 3]);
+    }
+    if (spi_strip->raw_buf) {
+        uint8_t *raw = &spi_strip->raw_buf[index * spi_strip->bytes_per_pixel];
+        raw[0] = green;
+        raw[1] = red;
+        raw[2] = blue;
+        if (spi_strip->bytes_per_pixel > 3) {
+            raw[3] = 0;
+        }
     }
     return ESP_OK;
 }
@@ -68,53 +316,490 @@ static esp_err_t led_strip_spi_set_pixel_rgbw(led_strip_t *strip, uint32_t index
     led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
     ESP_RETURN_ON_FALSE(index < spi_strip->strip_len, ESP_ERR_INVALID_ARG, TAG, "index out of maximum number of LEDs");
     ESP_RETURN_ON_FALSE(spi_strip->bytes_per_pixel == 4, ESP_ERR_INVALID_ARG, TAG, "wrong LED pixel format, expected 4 bytes per pixel");
-    // LED_PIXEL_FORMAT_GRBW takes 96bits(12bytes)
-    uint32_t start = index * spi_strip->bytes_per_pixel * SPI_BYTES_PER_COLOR_BYTE;
+    ESP_RETURN_ON_ERROR(led_strip_spi_prepare_write(spi_strip, false), TAG, "wait for pending frame failed");
+    led_strip_spi_mark_dirty(spi_strip, index + 1);
+    // LED_PIXEL_FORMAT_GRBW takes 96bits(12bytes) with 3 SPI bits per LED bit
+    uint32_t start = index * spi_strip->bytes_per_pixel * spi_strip->bytes_per_color;
     // SK6812 component order is GRBW
-    memset(spi_strip->pixel_buf + start, 0, spi_strip->bytes_per_pixel * SPI_BYTES_PER_COLOR_BYTE);
-    __led_strip_spi_bit(green, &spi_strip->pixel_buf[start]);
-    __led_strip_spi_bit(red, &spi_strip->pixel_buf[start + SPI_BYTES_PER_COLOR_BYTE]);
-    __led_strip_spi_bit(blue, &spi_strip->pixel_buf[start + SPI_BYTES_PER_COLOR_BYTE * 2]);
-    __led_strip_spi_bit(white, &spi_strip->pixel_buf[start + SPI_BYTES_PER_COLOR_BYTE * 3]);
+    __led_strip_spi_bit(spi_strip, green, &spi_strip->pixel_buf[start]);
+    __led_strip_spi_bit(spi_strip, red, &spi_strip->pixel_buf[start + spi_strip->bytes_per_color]);
+    __led_strip_spi_bit(spi_strip, blue, &spi_strip->pixel_buf[start + spi_strip->bytes_per_color * 2]);
+    __led_strip_spi_bit(spi_strip, white, &spi_strip->pixel_buf[start + spi_strip->bytes_per_color * 3]);
+    if (spi_strip->raw_buf) {
+        uint8_t *raw = &spi_strip->raw_buf[index * 4];
+        raw[0] = green;
+        raw[1] = red;
+        raw[2] = blue;
+        raw[3] = white;
+    }
 
     return ESP_OK;
 }
 
+static esp_err_t led_strip_spi_set_pixels(led_strip_t *strip, uint32_t start, uint32_t count, const uint8_t *src, led_pixel_format_t format)
+{
+    led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
+    ESP_RETURN_ON_FALSE(format < LED_PIXEL_FORMAT_INVALID, ESP_ERR_INVALID_ARG, TAG, "invalid led_pixel_format");
+    ESP_RETURN_ON_FALSE(start < spi_strip->strip_len && count <= spi_strip->strip_len - start, ESP_ERR_INVALID_ARG, TAG, "pixels out of maximum number of LEDs");
+    uint8_t src_bytes_per_pixel = format == LED_PIXEL_FORMAT_GRBW ? 4 : 3;
+    ESP_RETURN_ON_FALSE(src_bytes_per_pixel <= spi_strip->bytes_per_pixel, ESP_ERR_INVALID_ARG, TAG, "wrong LED pixel format, the strip has no white component");
+    ESP_RETURN_ON_ERROR(led_strip_spi_prepare_write(spi_strip, count == spi_strip->strip_len), TAG, "wait for pending frame failed");
+    led_strip_spi_mark_dirty(spi_strip, start + count);
+    if (spi_strip->raw_buf) {
+        uint8_t *raw = spi_strip->raw_buf + start * spi_strip->bytes_per_pixel;
+        for (uint32_t i = 0; i < count; i++) {
+            memcpy(raw, src + i * src_bytes_per_pixel, src_bytes_per_pixel);
+            if (src_bytes_per_pixel < spi_strip->bytes_per_pixel) {
+                raw[3] = 0;
+            }
+            raw += spi_strip->bytes_per_pixel;
+        }
+    }
+    uint8_t *buf = spi_strip->pixel_buf + start * spi_strip->bytes_per_pixel * spi_strip->bytes_per_color;
+    if (src_bytes_per_pixel == spi_strip->bytes_per_pixel) {
+        // same component order on both sides, expand the whole span byte by byte
+        const uint8_t *end = src + count * src_bytes_per_pixel;
+        while (src < end) {
+            __led_strip_spi_bit(spi_strip, *src++, buf);
+            buf += spi_strip->bytes_per_color;
+        }
+    } else {
+        // GRB data on a GRBW strip, turn off the white component
+        for (uint32_t i = 0; i < count; i++) {
+            __led_strip_spi_bit(spi_strip, *src++, buf);
+            __led_strip_spi_bit(spi_strip, *src++, buf + spi_strip->bytes_per_color);
+            __led_strip_spi_bit(spi_strip, *src++, buf + spi_strip->bytes_per_color * 2);
+            __led_strip_spi_bit(spi_strip, 0, buf + spi_strip->bytes_per_color * 3);
+            buf += spi_strip->bytes_per_color * 4;
+        }
+    }
+    return ESP_OK;
+}
+
+static void led_strip_spi_prepare_trans(led_strip_spi_obj *spi_strip, const uint8_t *buf, uint32_t size)
+{
+    memset(&spi_strip->trans, 0, sizeof(spi_strip->trans));
+    spi_strip->trans.length = size * 8;
+    spi_strip->trans.tx_buffer = buf;
+    spi_strip->trans.rx_buffer = NULL;
+    spi_strip->trans.user = spi_strip;
+}
+
 static esp_err_t led_strip_spi_refresh(led_strip_t *strip)
 {
     led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
-    spi_transaction_t tx_conf;
-    memset(&tx_conf, 0, sizeof(tx_conf));
+    // the frame queued by an asynchronous refresh must be collected before starting a new transaction
+    ESP_RETURN_ON_ERROR(led_strip_spi_wait_done(spi_strip, portMAX_DELAY), TAG, "wait for pending frame failed");
 
-    tx_conf.length = spi_strip->strip_len * spi_strip->bytes_per_pixel * SPI_BITS_PER_COLOR_BYTE;
-    tx_conf.tx_buffer = spi_strip->pixel_buf;
-    tx_conf.rx_buffer = NULL;
-    ESP_RETURN_ON_ERROR(spi_device_transmit(spi_strip->spi_device, &tx_conf), TAG, "transmit pixels by SPI failed");
+    led_strip_spi_prepare_trans(spi_strip, led_strip_spi_frame_to_send(spi_strip), led_strip_spi_refresh_size(spi_strip));
+    led_strip_wait_reset(spi_strip->frame_end_us);
+    ESP_RETURN_ON_ERROR(spi_device_transmit(spi_strip->spi_device, &spi_strip->trans), TAG, "transmit pixels by SPI failed");
+    spi_strip->dirty_len = 0;
 
     return ESP_OK;
 }
 
-static esp_err_t led_strip_spi_clear(led_strip_t *strip)
+static esp_err_t led_strip_spi_refresh_async(led_strip_t *strip)
 {
     led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
-    //Write zero to turn off all leds
-    memset(spi_strip->pixel_buf, 0, spi_strip->strip_len * spi_strip->bytes_per_pixel * SPI_BYTES_PER_COLOR_BYTE);
-    uint8_t *buf = spi_strip->pixel_buf;
-    for (int index = 0; index < spi_strip->strip_len * spi_strip->bytes_per_pixel; index++) {
-        __led_strip_spi_bit(0, buf);
-        buf += SPI_BYTES_PER_COLOR_BYTE;
+    ESP_RETURN_ON_ERROR(led_strip_spi_wait_done(spi_strip, portMAX_DELAY), TAG, "wait for pending frame failed");
+
+    led_strip_spi_prepare_trans(spi_strip, led_strip_spi_frame_to_send(spi_strip), led_strip_spi_refresh_size(spi_strip));
+    led_strip_wait_reset(spi_strip->frame_end_us);
+    ESP_RETURN_ON_ERROR(spi_device_queue_trans(spi_strip->spi_device, &spi_strip->trans, portMAX_DELAY), TAG, "queue pixels by SPI failed");
+    spi_strip->trans_pending = true;
+    spi_strip->dirty_len = 0;
+
+    if (spi_strip->spare_buf && !spi_strip->pixel_buf_black) {
+        // keep encoding into the other buffer, starting from the frame just queued
+        uint8_t *sent_buf = spi_strip->pixel_buf;
+        spi_strip->pixel_buf = spi_strip->spare_buf;
+        spi_strip->spare_buf = sent_buf;
+        memcpy(spi_strip->pixel_buf, sent_buf, spi_strip->frame_size);
     }
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_spi_wait_refresh_done(led_strip_t *strip, int32_t timeout_ms)
+{
+    led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
+    return led_strip_spi_wait_done(spi_strip, timeout_ms < 0 ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms));
+}
 
+static esp_err_t led_strip_spi_register_event_callbacks(led_strip_t *strip, const led_strip_event_callbacks_t *cbs, void *user_ctx)
+{
+    led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
+    // don't swap the callback under the feet of a frame in flight
+    ESP_RETURN_ON_ERROR(led_strip_spi_wait_done(spi_strip, portMAX_DELAY), TAG, "wait for pending frame failed");
+    spi_strip->user_ctx = user_ctx;
+    spi_strip->on_refresh_done = cbs->on_refresh_done;
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_spi_clear(led_strip_t *strip)
+{
+    led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
+    // the black frame is sent as is, the pixel buffer picks it up only when it gets modified
+    spi_strip->pixel_buf_black = true;
+    spi_strip->dirty_len = spi_strip->strip_len;
     return led_strip_spi_refresh(strip);
 }
 
+static esp_err_t led_strip_spi_clear_buffer_only(led_strip_t *strip)
+{
+    led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
+    spi_strip->pixel_buf_black = true;
+    spi_strip->dirty_len = spi_strip->strip_len;
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_spi_set_refresh_mode(led_strip_t *strip, led_strip_refresh_mode_t mode)
+{
+    led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
+    spi_strip->refresh_mode = mode;
+    spi_strip->dirty_len = spi_strip->strip_len;
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_spi_capture_frame(led_strip_t *strip, uint32_t slot)
+{
+    led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
+    uint8_t *frame = spi_strip->frame_cache[slot];
+    if (spi_strip->stream_idle) {
+        // the slot may be the frame being streamed
+        ESP_RETURN_ON_ERROR(led_strip_spi_stream_wait(spi_strip, portMAX_DELAY), TAG, "wait for pending frame failed");
+    }
+    if (!frame) {
+        frame = heap_caps_malloc(spi_strip->frame_size, spi_strip->frame_caps);
+        ESP_RETURN_ON_FALSE(frame, ESP_ERR_NO_MEM, TAG, "no mem for frame cache slot");
+        spi_strip->frame_cache[slot] = frame;
+    } else if (spi_strip->trans_pending && spi_strip->trans.tx_buffer == frame) {
+        ESP_RETURN_ON_ERROR(led_strip_spi_wait_done(spi_strip, portMAX_DELAY), TAG, "wait for pending frame failed");
+    }
+    memcpy(frame, led_strip_spi_frame_to_send(spi_strip), spi_strip->frame_size);
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_spi_refresh_frame(led_strip_t *strip, uint32_t slot)
+{
+    led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
+    ESP_RETURN_ON_FALSE(spi_strip->frame_cache[slot], ESP_ERR_INVALID_STATE, TAG, "no frame captured in the slot");
+    ESP_RETURN_ON_ERROR(led_strip_spi_wait_done(spi_strip, portMAX_DELAY), TAG, "wait for pending frame failed");
+
+    // the frame is already encoded, just hand it to the DMA
+    led_strip_spi_prepare_trans(spi_strip, spi_strip->frame_cache[slot], spi_strip->frame_size);
+    led_strip_wait_reset(spi_strip->frame_end_us);
+    ESP_RETURN_ON_ERROR(spi_device_queue_trans(spi_strip->spi_device, &spi_strip->trans, portMAX_DELAY), TAG, "queue pixels by SPI failed");
+    spi_strip->trans_pending = true;
+    // the strip no longer shows the pixel buffer
+    spi_strip->dirty_len = spi_strip->strip_len;
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_spi_stream_set_pixel(led_strip_t *strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue)
+{
+    led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
+    ESP_RETURN_ON_FALSE(index < spi_strip->strip_len, ESP_ERR_INVALID_ARG, TAG, "index out of maximum number of LEDs");
+    ESP_RETURN_ON_ERROR(led_strip_spi_stream_wait(spi_strip, portMAX_DELAY), TAG, "wait for pending frame failed");
+    uint8_t *buf = spi_strip->pixel_buf + index * spi_strip->bytes_per_pixel;
+    // In the order of GRB, as LED strip like WS2812 sends out pixels in this order
+    buf[0] = green & 0xFF;
+    buf[1] = red & 0xFF;
+    buf[2] = blue & 0xFF;
+    if (spi_strip->bytes_per_pixel > 3) {
+        buf[3] = 0;
+    }
+    led_strip_spi_mark_dirty(spi_strip, index + 1);
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_spi_stream_set_pixel_rgbw(led_strip_t *strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue, uint32_t white)
+{
+    led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
+    ESP_RETURN_ON_FALSE(index < spi_strip->strip_len, ESP_ERR_INVALID_ARG, TAG, "index out of maximum number of LEDs");
+    ESP_RETURN_ON_FALSE(spi_strip->bytes_per_pixel == 4, ESP_ERR_INVALID_ARG, TAG, "wrong LED pixel format, expected 4 bytes per pixel");
+    ESP_RETURN_ON_ERROR(led_strip_spi_stream_wait(spi_strip, portMAX_DELAY), TAG, "wait for pending frame failed");
+    uint8_t *buf = spi_strip->pixel_buf + index * 4;
+    // SK6812 component order is GRBW
+    buf[0] = green & 0xFF;
+    buf[1] = red & 0xFF;
+    buf[2] = blue & 0xFF;
+    buf[3] = white & 0xFF;
+    led_strip_spi_mark_dirty(spi_strip, index + 1);
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_spi_stream_set_pixels(led_strip_t *strip, uint32_t start, uint32_t count, const uint8_t *src, led_pixel_format_t format)
+{
+    led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
+    ESP_RETURN_ON_FALSE(format < LED_PIXEL_FORMAT_INVALID, ESP_ERR_INVALID_ARG, TAG, "invalid led_pixel_format");
+    ESP_RETURN_ON_FALSE(start < spi_strip->strip_len && count <= spi_strip->strip_len - start, ESP_ERR_INVALID_ARG, TAG, "pixels out of maximum number of LEDs");
+    uint8_t src_bytes_per_pixel = format == LED_PIXEL_FORMAT_GRBW ? 4 : 3;
+    ESP_RETURN_ON_FALSE(src_bytes_per_pixel <= spi_strip->bytes_per_pixel, ESP_ERR_INVALID_ARG, TAG, "wrong LED pixel format, the strip has no white component");
+    ESP_RETURN_ON_ERROR(led_strip_spi_stream_wait(spi_strip, portMAX_DELAY), TAG, "wait for pending frame failed");
+    uint8_t *buf = spi_strip->pixel_buf + start * spi_strip->bytes_per_pixel;
+    if (src_bytes_per_pixel == spi_strip->bytes_per_pixel) {
+        // the buffer is kept in the wire order, copy the whole span at once
+        memcpy(buf, src, count * src_bytes_per_pixel);
+    } else {
+        // GRB data on a GRBW strip, turn off the white component
+        for (uint32_t i = 0; i < count; i++) {
+            *buf++ = *src++;
+            *buf++ = *src++;
+            *buf++ = *src++;
+            *buf++ = 0;
+        }
+    }
+    led_strip_spi_mark_dirty(spi_strip, start + count);
+    return ESP_OK;
+}
+
+/**
+ * @brief Encode the next chunks of the frame being streamed into the free DMA buffers and queue them
+ *
+ * The SPI driver starts the next queued chunk from the ISR of the previous one, so the gap between two chunks is only the ISR latency.
+ */
+static esp_err_t led_strip_spi_stream_fill(led_strip_spi_obj *spi_strip)
+{
+    uint32_t chunk_size = LED_STRIP_SPI_STREAM_CHUNK_LEDS * spi_strip->bytes_per_pixel;
+    while (spi_strip->stream_queued < spi_strip->stream_total && spi_strip->stream_in_flight < LED_STRIP_SPI_STREAM_CHUNKS) {
+        uint32_t queued = spi_strip->stream_queued;
+        uint32_t size = spi_strip->stream_total - queued < chunk_size ? spi_strip->stream_total - queued : chunk_size;
+        const uint8_t *pixels = spi_strip->stream_pixels + queued;
+        uint8_t *buf = spi_strip->stream_buf + spi_strip->stream_next * chunk_size * spi_strip->bytes_per_color;
+        if (spi_strip->dither_residual) {
+            uint8_t *residual = spi_strip->dither_residual + queued;
+            for (uint32_t i = 0; i < size; i++) {
+                uint8_t data = led_strip_scale_dither(pixels[i], spi_strip->brightness, &residual[i]);
+                __led_strip_spi_bit(spi_strip, data, buf + i * spi_strip->bytes_per_color);
+            }
+        } else {
+            for (uint32_t i = 0; i < size; i++) {
+                __led_strip_spi_bit(spi_strip, pixels[i], buf + i * spi_strip->bytes_per_color);
+            }
+        }
+        spi_transaction_t *trans = &spi_strip->stream_trans[spi_strip->stream_next];
+        memset(trans, 0, sizeof(spi_transaction_t));
+        trans->length = size * spi_strip->bytes_per_color * 8;
+        trans->tx_buffer = buf;
+        trans->user = spi_strip;
+        if (queued + size == spi_strip->stream_total) {
+            spi_strip->stream_last = trans;
+        }
+        // the transaction queue has room for every chunk, this never waits
+        ESP_RETURN_ON_ERROR(spi_device_queue_trans(spi_strip->spi_device, trans, 0), TAG, "queue pixels by SPI failed");
+        spi_strip->stream_queued += size;
+        spi_strip->stream_in_flight++;
+        spi_strip->stream_next = (spi_strip->stream_next + 1) % LED_STRIP_SPI_STREAM_CHUNKS;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Refill task of a streaming strip, woken by the done ISR of every chunk
+ *
+ * The SPI driver can't queue a transaction from an ISR, so the ISR only hands the freed DMA buffer over to this task.
+ * It collects the chunks sent, encodes the next ones into their buffers and ends the frame once the last one is out.
+ */
+static void led_strip_spi_stream_task(void *arg)
+{
+    led_strip_spi_obj *spi_strip = (led_strip_spi_obj *)arg;
+    for (;;) {
+        // one notification starts the frame, then one comes for each chunk sent
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+        if (!spi_strip->stream_active) {
+            continue;
+        }
+        if (spi_strip->stream_in_flight) {
+            // the driver queues the result once the ISR is done, it may not be there yet on the other core
+            spi_transaction_t *trans = NULL;
+            spi_device_get_trans_result(spi_strip->spi_device, &trans, portMAX_DELAY);
+            spi_strip->stream_in_flight--;
+        }
+        if (spi_strip->stream_err == ESP_OK) {
+            spi_strip->stream_err = led_strip_spi_stream_fill(spi_strip);
+        }
+        // a frame cut short by an error ends once the chunks already queued are collected
+        if (spi_strip->stream_in_flight == 0 &&
+                (spi_strip->stream_queued == spi_strip->stream_total || spi_strip->stream_err != ESP_OK)) {
+            spi_strip->stream_active = false;
+            xSemaphoreGive(spi_strip->stream_idle);
+        }
+    }
+}
+
+/**
+ * @brief Start streaming `len` LEDs of raw pixels, encoding them chunk by chunk just ahead of the DMA
+ *
+ * Returns once the refill task is handed the frame, the pixels must be left untouched until it's out.
+ */
+static esp_err_t led_strip_spi_stream_start(led_strip_spi_obj *spi_strip, const uint8_t *pixels, uint32_t len)
+{
+    // one frame at a time, the refill task gives the token back once the frame is out
+    ESP_RETURN_ON_FALSE(xSemaphoreTake(spi_strip->stream_idle, portMAX_DELAY) == pdTRUE, ESP_FAIL, TAG, "wait for pending frame failed");
+    spi_strip->stream_pixels = pixels;
+    spi_strip->stream_total = len * spi_strip->bytes_per_pixel;
+    spi_strip->stream_queued = 0;
+    spi_strip->stream_next = 0;
+    spi_strip->stream_last = NULL;
+    spi_strip->stream_err = ESP_OK;
+    led_strip_wait_reset(spi_strip->frame_end_us);
+    spi_strip->stream_active = true;
+    // the refill task queues the first chunks too, so the stream state is only ever touched by it
+    xTaskNotifyGive(spi_strip->stream_task);
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_spi_stream_refresh_async(led_strip_t *strip)
+{
+    led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
+    uint32_t len = spi_strip->strip_len;
+    if (spi_strip->refresh_mode == LED_STRIP_REFRESH_PREFIX) {
+        // a refresh always sends something, the first pixel if none was modified
+        len = spi_strip->dirty_len ? spi_strip->dirty_len : 1;
+    }
+    ESP_RETURN_ON_ERROR(led_strip_spi_stream_start(spi_strip, spi_strip->pixel_buf, len), TAG, "stream pixels failed");
+    spi_strip->dirty_len = 0;
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_spi_stream_wait_refresh_done(led_strip_t *strip, int32_t timeout_ms)
+{
+    led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
+    ESP_RETURN_ON_ERROR(led_strip_spi_stream_wait(spi_strip, timeout_ms < 0 ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms)), TAG, "wait for pending frame failed");
+    return spi_strip->stream_err;
+}
+
+static esp_err_t led_strip_spi_stream_refresh(led_strip_t *strip)
+{
+    ESP_RETURN_ON_ERROR(led_strip_spi_stream_refresh_async(strip), TAG, "stream pixels failed");
+    return led_strip_spi_stream_wait_refresh_done(strip, -1);
+}
+
+static esp_err_t led_strip_spi_stream_refresh_frame(led_strip_t *strip, uint32_t slot)
+{
+    led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
+    ESP_RETURN_ON_FALSE(spi_strip->frame_cache[slot], ESP_ERR_INVALID_STATE, TAG, "no frame captured in the slot");
+    // the strip no longer shows the pixel buffer
+    spi_strip->dirty_len = spi_strip->strip_len;
+    return led_strip_spi_stream_start(spi_strip, spi_strip->frame_cache[slot], spi_strip->strip_len);
+}
+
+static esp_err_t led_strip_spi_stream_clear_buffer_only(led_strip_t *strip)
+{
+    led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
+    ESP_RETURN_ON_ERROR(led_strip_spi_stream_wait(spi_strip, portMAX_DELAY), TAG, "wait for pending frame failed");
+    memset(spi_strip->pixel_buf, 0, spi_strip->frame_size);
+    spi_strip->dirty_len = spi_strip->strip_len;
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_spi_stream_clear(led_strip_t *strip)
+{
+    ESP_RETURN_ON_ERROR(led_strip_spi_stream_clear_buffer_only(strip), TAG, "clear pixel buffer failed");
+    return led_strip_spi_stream_refresh(strip);
+}
+
+static esp_err_t led_strip_spi_get_timing(led_strip_t *strip, led_strip_timing_t *ret_timing)
+{
+    led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
+    // the transaction is prepared before waiting for the reset time, it is queued after
+    led_strip_timing_calc(ret_timing, spi_strip->strip_len, spi_strip->bytes_per_pixel, spi_strip->bit_period_ns, LED_STRIP_RESET_US,
+                          0, LED_STRIP_SPI_SETUP_US);
+    return ESP_OK;
+}
+
+/**
+ * @brief Encode the pixel buffer again with a new brightness, outside the streaming mode
+ *
+ * The color bytes are decoded from the pixel buffer the first time, while the table is still unscaled, and kept from then on.
+ * The frames captured in the cache were encoded with the old brightness, they're dropped.
+ */
+static esp_err_t led_strip_spi_reencode(led_strip_spi_obj *spi_strip, uint16_t brightness)
+{
+    uint32_t len = spi_strip->strip_len * spi_strip->bytes_per_pixel;
+    if (!spi_strip->raw_buf && brightness == LED_STRIP_BRIGHTNESS_MAX) {
+        return ESP_OK;
+    }
+    // neither the pixel buffer nor a cached frame can change under the DMA
+    ESP_RETURN_ON_ERROR(led_strip_spi_wait_done(spi_strip, portMAX_DELAY), TAG, "wait for pending frame failed");
+    if (!spi_strip->raw_buf) {
+        spi_strip->raw_buf = calloc(1, len);
+        ESP_RETURN_ON_FALSE(spi_strip->raw_buf, ESP_ERR_NO_MEM, TAG, "no mem for the color bytes");
+        if (!spi_strip->pixel_buf_black) {
+            for (uint32_t i = 0; i < len; i++) {
+                spi_strip->raw_buf[i] = led_strip_spi_decode(spi_strip, spi_strip->pixel_buf + i * spi_strip->bytes_per_color);
+            }
+        }
+    }
+    spi_strip->brightness = brightness;
+    led_strip_spi_build_lut(spi_strip->bit_lut, spi_strip->bytes_per_color, spi_strip->t0h, spi_strip->t1h, brightness);
+    if (!spi_strip->pixel_buf_black) {
+        for (uint32_t i = 0; i < len; i++) {
+            __led_strip_spi_bit(spi_strip, spi_strip->raw_buf[i], spi_strip->pixel_buf + i * spi_strip->bytes_per_color);
+        }
+    }
+    spi_strip->dirty_len = spi_strip->strip_len;
+    for (int i = 0; i < CONFIG_LED_STRIP_FRAME_CACHE_SLOTS; i++) {
+        free(spi_strip->frame_cache[i]);
+        spi_strip->frame_cache[i] = NULL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_spi_set_brightness(led_strip_t *strip, uint16_t brightness, bool dither)
+{
+    led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
+    // only the streaming mode encodes the frame again for every refresh
+    ESP_RETURN_ON_FALSE(!dither || spi_strip->stream_buf, ESP_ERR_NOT_SUPPORTED, TAG, "dithering needs the streaming mode");
+    if (!spi_strip->stream_buf) {
+        return led_strip_spi_reencode(spi_strip, brightness);
+    }
+    if (spi_strip->stream_idle) {
+        // the frame being streamed is encoded with the table and the dithering state
+        ESP_RETURN_ON_ERROR(led_strip_spi_stream_wait(spi_strip, portMAX_DELAY), TAG, "wait for pending frame failed");
+    }
+    if (dither && !spi_strip->dither_residual) {
+        spi_strip->dither_residual = calloc(1, spi_strip->frame_size);
+        ESP_RETURN_ON_FALSE(spi_strip->dither_residual, ESP_ERR_NO_MEM, TAG, "no mem for dithering state");
+    } else if (!dither) {
+        free(spi_strip->dither_residual);
+        spi_strip->dither_residual = NULL;
+    }
+    spi_strip->brightness = brightness;
+    // dithering scales every byte on its own, the table is left unscaled then
+    led_strip_spi_build_lut(spi_strip->bit_lut, spi_strip->bytes_per_color, spi_strip->t0h, spi_strip->t1h,
+                            dither ? LED_STRIP_BRIGHTNESS_MAX : brightness);
+    return ESP_OK;
+}
+
+static void led_strip_spi_free_frames(led_strip_spi_obj *spi_strip)
+{
+    if (spi_strip->stream_task) {
+        vTaskDelete(spi_strip->stream_task);
+    }
+    if (spi_strip->stream_idle) {
+        vSemaphoreDelete(spi_strip->stream_idle);
+    }
+    for (int i = 0; i < CONFIG_LED_STRIP_FRAME_CACHE_SLOTS; i++) {
+        free(spi_strip->frame_cache[i]);
+    }
+    free(spi_strip->frame_buf);
+    free(spi_strip->stream_buf);
+    free(spi_strip->dither_residual);
+    free(spi_strip->raw_buf);
+}
+
 static esp_err_t led_strip_spi_del(led_strip_t *strip)
 {
     led_strip_spi_obj *spi_strip = __containerof(strip, led_strip_spi_obj, base);
 
+    ESP_RETURN_ON_ERROR(led_strip_spi_wait_done(spi_strip, portMAX_DELAY), TAG, "wait for pending frame failed");
     ESP_RETURN_ON_ERROR(spi_bus_remove_device(spi_strip->spi_device), TAG, "delete spi device failed");
     ESP_RETURN_ON_ERROR(spi_bus_free(spi_strip->spi_host), TAG, "free spi bus failed");
 
+    led_strip_spi_free_frames(spi_strip);
+    free(spi_strip->bit_lut);
     free(spi_strip);
     return ESP_OK;
 }
@@ -133,13 +818,12 @@ esp_err_t led_strip_new_spi_device(const led_strip_config_t *led_config, const l
     } else {
         assert(false);
     }
-    uint32_t mem_caps = MALLOC_CAP_DEFAULT;
-    if (spi_config->flags.with_dma) {
-        // DMA buffer must be placed in internal SRAM
-        mem_caps |= MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA;
-    }
-    spi_strip = heap_caps_calloc(1, sizeof(led_strip_spi_obj) + led_config->max_leds * bytes_per_pixel * SPI_BYTES_PER_COLOR_BYTE, mem_caps);
-
+    ESP_GOTO_ON_FALSE(led_config->led_model < LED_MODEL_INVALID, ESP_ERR_INVALID_ARG, err, TAG, "invalid led model");
+    const led_strip_spi_timing_t *timing = &s_led_timing[led_config->led_model];
+    bool streaming = spi_config->flags.streaming;
+    ESP_GOTO_ON_FALSE(!streaming || spi_config->flags.with_dma, ESP_ERR_INVALID_ARG, err, TAG, "streaming mode requires DMA");
+    ESP_GOTO_ON_FALSE(!streaming || !spi_config->flags.double_buffer, ESP_ERR_INVALID_ARG, err, TAG, "streaming mode can't be double buffered");
+    spi_strip = calloc(1, sizeof(led_strip_spi_obj));
     ESP_GOTO_ON_FALSE(spi_strip, ESP_ERR_NO_MEM, err, TAG, "no mem for spi strip");
 
     spi_strip->spi_host = spi_config->spi_bus;
@@ -156,8 +840,12 @@ esp_err_t led_strip_new_spi_device(const led_strip_config_t *led_config, const l
         .sclk_io_num = -1,
         .quadwp_io_num = -1,
         .quadhd_io_num = -1,
-        .max_transfer_sz = led_config->max_leds * bytes_per_pixel * SPI_BYTES_PER_COLOR_BYTE,
+        .max_transfer_sz = led_config->max_leds * bytes_per_pixel * SPI_MAX_SYMBOLS_PER_BIT,
     };
+    if (streaming) {
+        // a transaction never carries more than a chunk
+        spi_bus_cfg.max_transfer_sz = LED_STRIP_SPI_STREAM_CHUNK_LEDS * bytes_per_pixel * SPI_MAX_SYMBOLS_PER_BIT;
+    }
     ESP_GOTO_ON_ERROR(spi_bus_initialize(spi_strip->spi_host, &spi_bus_cfg, spi_config->flags.with_dma ? SPI_DMA_CH_AUTO : SPI_DMA_DISABLED), err, TAG, "create SPI bus failed");
 
     if (led_config->flags.invert_out == true) {
@@ -169,32 +857,123 @@ esp_err_t led_strip_new_spi_device(const led_strip_config_t *led_config, const l
         .command_bits = 0,
         .address_bits = 0,
         .dummy_bits = 0,
-        .clock_speed_hz = LED_STRIP_SPI_DEFAULT_RESOLUTION,
         .mode = 0,
         //set -1 when CS is not used
         .spics_io_num = -1,
         .queue_size = LED_STRIP_SPI_DEFAULT_TRANS_QUEUE_SIZE,
+        .post_cb = led_strip_spi_trans_done,
     };
 
-    ESP_GOTO_ON_ERROR(spi_bus_add_device(spi_strip->spi_host, &spi_dev_cfg, &spi_strip->spi_device), err, TAG, "Failed to add spi device");
-    //ensure the reset time is enough
-    esp_rom_delay_us(10);
+    // Try the densest encoding first, each one asks for the clock that gives the nominal bit period.
+    // The clock source may not be able to generate it exactly, so the encoding is checked again with the actual clock.
+    uint8_t symbols = SPI_MIN_SYMBOLS_PER_BIT;
+    uint8_t t0h = 0;
+    uint8_t t1h = 0;
     int clock_resolution_khz = 0;
-    spi_device_get_actual_freq(spi_strip->spi_device, &clock_resolution_khz);
-    // TODO: ideally we should decide the SPI_BYTES_PER_COLOR_BYTE by the real clock resolution
-    // But now, let's fixed the resolution, the downside is, we don't support a clock source whose frequency is not multiple of LED_STRIP_SPI_DEFAULT_RESOLUTION
-    // clock_resolution between 2.2MHz to 2.8MHz is supported
-    ESP_GOTO_ON_FALSE((clock_resolution_khz < LED_STRIP_SPI_DEFAULT_RESOLUTION / 1000 + 300) && (clock_resolution_khz > LED_STRIP_SPI_DEFAULT_RESOLUTION / 1000 - 300), ESP_ERR_NOT_SUPPORTED, err,
-                      TAG, "unsupported clock resolution:%dKHz", clock_resolution_khz);
+    for (; symbols <= SPI_MAX_SYMBOLS_PER_BIT; symbols++) {
+        spi_dev_cfg.clock_speed_hz = symbols * 1000000000ULL / timing->period;
+        if (!led_strip_spi_pick_encoding(timing, symbols, spi_dev_cfg.clock_speed_hz / 1000, &t0h, &t1h)) {
+            continue;
+        }
+        ESP_GOTO_ON_ERROR(spi_bus_add_device(spi_strip->spi_host, &spi_dev_cfg, &spi_strip->spi_device), err, TAG, "Failed to add spi device");
+        spi_device_get_actual_freq(spi_strip->spi_device, &clock_resolution_khz);
+        if (led_strip_spi_pick_encoding(timing, symbols, clock_resolution_khz, &t0h, &t1h)) {
+            break;
+        }
+        spi_bus_remove_device(spi_strip->spi_device);
+        spi_strip->spi_device = NULL;
+    }
+    ESP_GOTO_ON_FALSE(spi_strip->spi_device, ESP_ERR_NOT_SUPPORTED, err, TAG, "unsupported clock resolution:%dKHz", clock_resolution_khz);
+    ESP_LOGD(TAG, "%d SPI bits per LED bit (T0H %d, T1H %d) at %dKHz", symbols, t0h, t1h, clock_resolution_khz);
+    spi_strip->bit_period_ns = symbols * 1000000 / clock_resolution_khz;
+    // the line may have been high before the device was added, the first frame waits for a whole reset time
+    spi_strip->frame_end_us = esp_timer_get_time();
+
+    uint32_t lut_caps = MALLOC_CAP_DEFAULT;
+#if CONFIG_LED_STRIP_SPI_LUT_IN_DRAM
+    lut_caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+#endif
+    spi_strip->bit_lut = heap_caps_malloc(256 * symbols, lut_caps);
+    ESP_GOTO_ON_FALSE(spi_strip->bit_lut, ESP_ERR_NO_MEM, err, TAG, "no mem for bit expansion table");
+    led_strip_spi_build_lut(spi_strip->bit_lut, symbols, t0h, t1h, LED_STRIP_BRIGHTNESS_MAX);
+    spi_strip->t0h = t0h;
+    spi_strip->t1h = t1h;
+    spi_strip->brightness = LED_STRIP_BRIGHTNESS_MAX;
 
+    uint32_t mem_caps = MALLOC_CAP_DEFAULT;
+    if (spi_config->flags.with_dma) {
+        // DMA buffer must be placed in internal SRAM
+        mem_caps |= MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA;
+    }
     spi_strip->bytes_per_pixel = bytes_per_pixel;
+    spi_strip->bytes_per_color = symbols;
     spi_strip->strip_len = led_config->max_leds;
-    spi_strip->base.set_pixel = led_strip_spi_set_pixel;
-    spi_strip->base.set_pixel_rgbw = led_strip_spi_set_pixel_rgbw;
-    spi_strip->base.refresh = led_strip_spi_refresh;
-    spi_strip->base.clear = led_strip_spi_clear;
+    spi_strip->dirty_len = spi_strip->strip_len;
+    if (streaming) {
+        // only the chunks in flight need DMA capable memory, the pixels can go to PSRAM
+        spi_strip->stream_buf = heap_caps_calloc(LED_STRIP_SPI_STREAM_CHUNKS, LED_STRIP_SPI_STREAM_CHUNK_LEDS * bytes_per_pixel * symbols, mem_caps);
+        ESP_GOTO_ON_FALSE(spi_strip->stream_buf, ESP_ERR_NO_MEM, err, TAG, "no mem for spi strip chunks");
+        spi_strip->frame_size = led_config->max_leds * bytes_per_pixel;
+        spi_strip->frame_caps = MALLOC_CAP_DEFAULT;
+        spi_strip->frame_buf = heap_caps_calloc_prefer(1, spi_strip->frame_size, 2, MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+        ESP_GOTO_ON_FALSE(spi_strip->frame_buf, ESP_ERR_NO_MEM, err, TAG, "no mem for spi strip pixels");
+        spi_strip->pixel_buf = spi_strip->frame_buf;
+        spi_strip->stream_idle = xSemaphoreCreateBinary();
+        ESP_GOTO_ON_FALSE(spi_strip->stream_idle, ESP_ERR_NO_MEM, err, TAG, "no mem for stream semaphore");
+        xSemaphoreGive(spi_strip->stream_idle);
+        ESP_GOTO_ON_FALSE(xTaskCreate(led_strip_spi_stream_task, "led_strip_spi", LED_STRIP_SPI_STREAM_TASK_STACK, spi_strip,
+                                      CONFIG_LED_STRIP_SPI_STREAM_TASK_PRIORITY, &spi_strip->stream_task) == pdPASS,
+                          ESP_ERR_NO_MEM, err, TAG, "create stream task failed");
+
+        spi_strip->base.set_pixel = led_strip_spi_stream_set_pixel;
+        spi_strip->base.set_pixel_rgbw = led_strip_spi_stream_set_pixel_rgbw;
+        spi_strip->base.set_pixels = led_strip_spi_stream_set_pixels;
+        spi_strip->base.refresh = led_strip_spi_stream_refresh;
+        spi_strip->base.refresh_async = led_strip_spi_stream_refresh_async;
+        spi_strip->base.wait_refresh_done = led_strip_spi_stream_wait_refresh_done;
+        spi_strip->base.clear = led_strip_spi_stream_clear;
+        spi_strip->base.clear_buffer_only = led_strip_spi_stream_clear_buffer_only;
+        spi_strip->base.refresh_frame = led_strip_spi_stream_refresh_frame;
+    } else {
+        uint32_t frame_size = led_config->max_leds * bytes_per_pixel * symbols;
+        // one more frame holds the encoded black frame
+        uint8_t frame_num = spi_config->flags.double_buffer ? 3 : 2;
+        spi_strip->frame_buf = heap_caps_calloc(frame_num, frame_size, mem_caps);
+        ESP_GOTO_ON_FALSE(spi_strip->frame_buf, ESP_ERR_NO_MEM, err, TAG, "no mem for spi strip pixels");
+        spi_strip->black_buf = spi_strip->frame_buf + (frame_num - 1) * frame_size;
+        for (uint32_t i = 0; i < frame_size; i += symbols) {
+            memcpy(spi_strip->black_buf + i, spi_strip->bit_lut, symbols);
+        }
+        spi_strip->frame_size = frame_size;
+        spi_strip->frame_caps = mem_caps;
+        spi_strip->pixel_buf = spi_strip->frame_buf;
+        // start with all the LEDs off
+        spi_strip->pixel_buf_black = true;
+        if (spi_config->flags.double_buffer) {
+            spi_strip->spare_buf = spi_strip->frame_buf + frame_size;
+        }
+
+        spi_strip->base.set_pixel = led_strip_spi_set_pixel;
+        spi_strip->base.set_pixel_rgbw = led_strip_spi_set_pixel_rgbw;
+        spi_strip->base.set_pixels = led_strip_spi_set_pixels;
+        spi_strip->base.refresh = led_strip_spi_refresh;
+        spi_strip->base.refresh_async = led_strip_spi_refresh_async;
+        spi_strip->base.wait_refresh_done = led_strip_spi_wait_refresh_done;
+        spi_strip->base.clear = led_strip_spi_clear;
+        spi_strip->base.clear_buffer_only = led_strip_spi_clear_buffer_only;
+        spi_strip->base.refresh_frame = led_strip_spi_refresh_frame;
+    }
+    spi_strip->base.register_event_callbacks = led_strip_spi_register_event_callbacks;
+    spi_strip->base.capture_frame = led_strip_spi_capture_frame;
+    spi_strip->base.set_refresh_mode = led_strip_spi_set_refresh_mode;
+    spi_strip->base.get_timing = led_strip_spi_get_timing;
+    spi_strip->base.set_brightness = led_strip_spi_set_brightness;
     spi_strip->base.del = led_strip_spi_del;
 
+    led_strip_timing_t strip_timing;
+    led_strip_spi_get_timing(&spi_strip->base, &strip_timing);
+    ESP_LOGI(TAG, "%"PRIu32" LEDs: %"PRIu32"us on the wire + %"PRIu32"us reset + %"PRIu32"us setup, up to %"PRIu32" fps",
+             spi_strip->strip_len, strip_timing.wire_time_us, strip_timing.reset_us, strip_timing.setup_us, strip_timing.max_fps);
     *ret_strip = &spi_strip->base;
     return ESP_OK;
 err:
@@ -205,6 +984,8 @@ err:
         if (spi_strip->spi_host) {
             spi_bus_free(spi_strip->spi_host);
         }
+        led_strip_spi_free_frames(spi_strip);
+        free(spi_strip->bit_lut);
         free(spi_strip);
     }
     return ret;